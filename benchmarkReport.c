@@ -0,0 +1,444 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include "benchmarkReport.h"
+#include "imageFormat.h"
+
+//-------------------------------------------------------------------------
+
+#define DEVICE_TREE_MODEL "/proc/device-tree/model"
+
+//-------------------------------------------------------------------------
+// Read the board model (e.g. "Raspberry Pi 3 Model B Rev 1.2"), so that
+// results from different boards can be told apart. Anything that would
+// need escaping in JSON is dropped.
+
+static void
+readModel(
+    char *model,
+    size_t size)
+{
+    strncpy(model, "unknown", size);
+
+    FILE *fp = fopen(DEVICE_TREE_MODEL, "r");
+
+    if (fp == NULL)
+    {
+        return;
+    }
+
+    char buffer[128];
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, fp);
+    fclose(fp);
+
+    size_t j = 0;
+    size_t i = 0;
+    for (i = 0 ; (i < length) && (j < size - 1) ; ++i)
+    {
+        if (isprint((unsigned char)buffer[i])
+            && (buffer[i] != '"')
+            && (buffer[i] != '\\'))
+        {
+            model[j++] = buffer[i];
+        }
+    }
+
+    if (j > 0)
+    {
+        model[j] = '\0';
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static double
+timevalSeconds(
+    const struct timeval *tv)
+{
+    return tv->tv_sec + (tv->tv_usec / 1e6);
+}
+
+//-------------------------------------------------------------------------
+
+static double
+benchmarkFps(
+    const PIPELINE_T *pipeline)
+{
+    if (pipeline->benchmark.elapsed <= 0)
+    {
+        return 0.0;
+    }
+
+    return (double)pipeline->stats.framesCaptured
+         * NANOSECONDS_PER_SECOND
+         / pipeline->benchmark.elapsed;
+}
+
+//-------------------------------------------------------------------------
+
+static uint32_t
+snapshotBytes(
+    const PIPELINE_T *pipeline)
+{
+    return pipeline->width
+         * pipeline->height
+         * imageFormatBytesPerPixel(pipeline->config.format);
+}
+
+//-------------------------------------------------------------------------
+// The mean number of bytes written to a framebuffer destination for each
+// frame presented.
+
+static uint64_t
+framebufferBytesPerFrame(
+    const PIPELINE_STATS_T *stats)
+{
+    if (stats->framesPresented == 0)
+    {
+        return 0;
+    }
+
+    return stats->framebufferBytes / stats->framesPresented;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+printLatencyText(
+    FILE *fp,
+    const char *name,
+    const LATENCY_HISTOGRAM_T *histogram)
+{
+    fprintf(fp,
+            "    %-10s %10lld %10lld %10lld %10lld\n",
+            name,
+            latencyHistogramPercentile(histogram, 50.0)
+                / NANOSECONDS_PER_MICROSECOND,
+            latencyHistogramPercentile(histogram, 90.0)
+                / NANOSECONDS_PER_MICROSECOND,
+            latencyHistogramPercentile(histogram, 99.0)
+                / NANOSECONDS_PER_MICROSECOND,
+            histogram->max / NANOSECONDS_PER_MICROSECOND);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+printPipelineText(
+    FILE *fp,
+    uint32_t index,
+    const PIPELINE_T *pipeline)
+{
+    const PIPELINE_CONFIG_T *config = &(pipeline->config);
+    const PIPELINE_BENCHMARK_T *benchmark = &(pipeline->benchmark);
+
+    PIPELINE_STATS_T copy;
+    pipelineStats(pipeline, &copy);
+    const PIPELINE_STATS_T *stats = &copy;
+
+    double seconds = (double)benchmark->elapsed / NANOSECONDS_PER_SECOND;
+    double fps = benchmarkFps(pipeline);
+    double user = timevalSeconds(&(benchmark->userTime));
+    double system = timevalSeconds(&(benchmark->systemTime));
+
+    fprintf(fp,
+            "pipeline %d: source [%d] %dx%d, snapshot %dx%d %s"
+            " (%d bytes), %d destination(s), %d buffer(s),"
+            " %d worker(s)\n",
+            index,
+            config->sourceDisplayNumber,
+            pipeline->sourceInfo.width,
+            pipeline->sourceInfo.height,
+            pipeline->width,
+            pipeline->height,
+            imageFormatName(config->format),
+            snapshotBytes(pipeline),
+            config->destinationCount,
+            config->buffers,
+            config->workers);
+    fprintf(fp,
+            "  frames      %"PRIu64" captured, %"PRIu64" presented,"
+            " %"PRIu64" skipped, %"PRIu64" failed\n",
+            stats->framesCaptured,
+            stats->framesPresented,
+            stats->framesSkipped,
+            stats->failures);
+    fprintf(fp,
+            "  throughput  %.1f fps in %.3f s, %.1f MB/s snapshot\n",
+            fps,
+            seconds,
+            fps * snapshotBytes(pipeline) / 1e6);
+
+    if (config->framebuffer != NULL)
+    {
+        fprintf(fp,
+                "  framebuffer %s, %"PRIu64" bytes written per frame\n",
+                config->framebuffer,
+                framebufferBytesPerFrame(stats));
+    }
+
+    fprintf(fp,
+            "  cpu         user %.3f s, system %.3f s (%.1f%% of a core)\n",
+            user,
+            system,
+            (seconds > 0.0) ? 100.0 * (user + system) / seconds : 0.0);
+    fprintf(fp,
+            "  latency (us)        p50        p90        p99        max\n");
+    printLatencyText(fp, "snapshot", &(stats->snapshotLatency));
+    printLatencyText(fp, "update", &(stats->updateLatency));
+}
+
+//-------------------------------------------------------------------------
+
+static void
+printLatencyJson(
+    FILE *fp,
+    const char *name,
+    const LATENCY_HISTOGRAM_T *histogram,
+    const char *separator)
+{
+    fprintf(fp,
+            "\"%s\":{\"p50_ns\":%lld,\"p90_ns\":%lld,"
+            "\"p99_ns\":%lld,\"max_ns\":%lld}%s",
+            name,
+            (long long)latencyHistogramPercentile(histogram, 50.0),
+            (long long)latencyHistogramPercentile(histogram, 90.0),
+            (long long)latencyHistogramPercentile(histogram, 99.0),
+            (long long)histogram->max,
+            separator);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+printPipelineJson(
+    FILE *fp,
+    uint32_t index,
+    const PIPELINE_T *pipeline)
+{
+    const PIPELINE_CONFIG_T *config = &(pipeline->config);
+    const PIPELINE_BENCHMARK_T *benchmark = &(pipeline->benchmark);
+
+    PIPELINE_STATS_T copy;
+    pipelineStats(pipeline, &copy);
+    const PIPELINE_STATS_T *stats = &copy;
+
+    fprintf(fp,
+            "{\"index\":%d,\"source\":{\"display\":%d,\"width\":%d,"
+            "\"height\":%d},",
+            index,
+            config->sourceDisplayNumber,
+            pipeline->sourceInfo.width,
+            pipeline->sourceInfo.height);
+    fprintf(fp,
+            "\"snapshot\":{\"width\":%d,\"height\":%d,\"format\":\"%s\","
+            "\"bytes\":%d},\"destinations\":%d,\"buffers\":%d,"
+            "\"workers\":%d,",
+            pipeline->width,
+            pipeline->height,
+            imageFormatName(config->format),
+            snapshotBytes(pipeline),
+            config->destinationCount,
+            config->buffers,
+            config->workers);
+
+    if (config->framebuffer != NULL)
+    {
+        fprintf(fp,
+                "\"framebuffer\":{\"bytes\":%"PRIu64","
+                "\"bytes_per_frame\":%"PRIu64"},",
+                stats->framebufferBytes,
+                framebufferBytesPerFrame(stats));
+    }
+
+    fprintf(fp,
+            "\"frames\":{\"captured\":%"PRIu64",\"presented\":%"PRIu64","
+            "\"skipped\":%"PRIu64",\"failed\":%"PRIu64"},",
+            stats->framesCaptured,
+            stats->framesPresented,
+            stats->framesSkipped,
+            stats->failures);
+    fprintf(fp,
+            "\"elapsed_s\":%.6f,\"fps\":%.3f,"
+            "\"cpu\":{\"user_s\":%.6f,\"system_s\":%.6f},\"latency\":{",
+            (double)benchmark->elapsed / NANOSECONDS_PER_SECOND,
+            benchmarkFps(pipeline),
+            timevalSeconds(&(benchmark->userTime)),
+            timevalSeconds(&(benchmark->systemTime)));
+    printLatencyJson(fp, "snapshot", &(stats->snapshotLatency), ",");
+    printLatencyJson(fp, "update", &(stats->updateLatency), "}}");
+}
+
+//-------------------------------------------------------------------------
+
+void
+printBenchmarkReport(
+    FILE *fp,
+    const PIPELINE_T *pipelines,
+    uint32_t pipelineCount,
+    bool json)
+{
+    char model[128];
+    readModel(model, sizeof(model));
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double user = timevalSeconds(&(usage.ru_utime));
+    double system = timevalSeconds(&(usage.ru_stime));
+
+    //---------------------------------------------------------------------
+
+    if (json)
+    {
+        fprintf(fp, "{\"model\":\"%s\",\"pipelines\":[", model);
+
+        uint32_t i = 0;
+        for (i = 0 ; i < pipelineCount ; ++i)
+        {
+            if (i > 0)
+            {
+                fprintf(fp, ",");
+            }
+
+            printPipelineJson(fp, i, &(pipelines[i]));
+        }
+
+        fprintf(fp,
+                "],\"cpu\":{\"user_s\":%.6f,\"system_s\":%.6f}}\n",
+                user,
+                system);
+    }
+    else
+    {
+        fprintf(fp, "model: %s\n", model);
+
+        uint32_t i = 0;
+        for (i = 0 ; i < pipelineCount ; ++i)
+        {
+            printPipelineText(fp, i, &(pipelines[i]));
+        }
+
+        fprintf(fp,
+                "process cpu: user %.3f s, system %.3f s\n",
+                user,
+                system);
+    }
+}
+
+//-------------------------------------------------------------------------
+// Print a line for each pipeline of one run of a --benchmark-workers
+// sweep: its frame rate, the speed-up over the first run, and the CPU
+// time used by the pipeline's thread (the workers are not included). The
+// first run prints the heading and becomes the baseline. With JSON, each
+// line is an object of its own.
+
+void
+printBenchmarkScaling(
+    FILE *fp,
+    const PIPELINE_T *pipelines,
+    uint32_t pipelineCount,
+    BENCHMARK_BASELINE_T *baseline,
+    bool json)
+{
+    if (pipelineCount > BENCHMARK_MAX_PIPELINES)
+    {
+        pipelineCount = BENCHMARK_MAX_PIPELINES;
+    }
+
+    if (baseline->pipelineCount == 0)
+    {
+        baseline->pipelineCount = pipelineCount;
+
+        uint32_t i = 0;
+        for (i = 0 ; i < pipelineCount ; ++i)
+        {
+            baseline->fps[i] = benchmarkFps(&(pipelines[i]));
+        }
+
+        if (json == false)
+        {
+            char model[128];
+            readModel(model, sizeof(model));
+
+            fprintf(fp, "model: %s\n", model);
+            fprintf(fp,
+                    "workers  pipeline        fps   speed-up"
+                    "   thread cpu\n");
+        }
+    }
+
+    uint32_t i = 0;
+    for (i = 0 ; i < pipelineCount ; ++i)
+    {
+        const PIPELINE_T *pipeline = &(pipelines[i]);
+        const PIPELINE_BENCHMARK_T *benchmark = &(pipeline->benchmark);
+
+        double seconds = (double)benchmark->elapsed / NANOSECONDS_PER_SECOND;
+        double fps = benchmarkFps(pipeline);
+        double cpu = timevalSeconds(&(benchmark->userTime))
+                   + timevalSeconds(&(benchmark->systemTime));
+
+        double speedup = (baseline->fps[i] > 0.0)
+                       ? fps / baseline->fps[i]
+                       : 0.0;
+        double load = (seconds > 0.0) ? 100.0 * cpu / seconds : 0.0;
+
+        if (json)
+        {
+            fprintf(fp,
+                    "{\"workers\":%d,\"pipeline\":%d,\"fps\":%.3f,"
+                    "\"speedup\":%.3f,\"thread_cpu_percent\":%.1f}\n",
+                    pipeline->config.workers,
+                    i,
+                    fps,
+                    speedup,
+                    load);
+        }
+        else
+        {
+            fprintf(fp,
+                    "%7d  %8d  %9.1f  %8.2fx  %10.1f%%\n",
+                    pipeline->config.workers,
+                    i,
+                    fps,
+                    speedup,
+                    load);
+        }
+    }
+
+    fflush(fp);
+}
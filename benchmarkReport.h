@@ -0,0 +1,76 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef BENCHMARK_REPORT_H
+#define BENCHMARK_REPORT_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pipeline.h"
+
+//-------------------------------------------------------------------------
+// Print the results of a --benchmark run: the throughput, snapshot and
+// update latencies, CPU time, and the sizes and format of each pipeline,
+// either as text or as a single JSON object.
+
+#define BENCHMARK_MAX_PIPELINES 8
+
+//-------------------------------------------------------------------------
+// With --benchmark-workers, the benchmark is run once for each number of
+// workers, starting with one. The frame rate of each pipeline in the first
+// run is the baseline the speed-up of the later runs is measured against.
+
+typedef struct
+{
+    uint32_t pipelineCount;
+    double fps[BENCHMARK_MAX_PIPELINES];
+} BENCHMARK_BASELINE_T;
+
+//-------------------------------------------------------------------------
+
+void
+printBenchmarkReport(
+    FILE *fp,
+    const PIPELINE_T *pipelines,
+    uint32_t pipelineCount,
+    bool json);
+
+void
+printBenchmarkScaling(
+    FILE *fp,
+    const PIPELINE_T *pipelines,
+    uint32_t pipelineCount,
+    BENCHMARK_BASELINE_T *baseline,
+    bool json);
+
+//-------------------------------------------------------------------------
+
+#endif
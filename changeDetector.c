@@ -0,0 +1,256 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "changeDetector.h"
+#include "displayBackend.h"
+#include "imageFormat.h"
+
+//-------------------------------------------------------------------------
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+//-------------------------------------------------------------------------
+
+// The rows of the band starting at row first.
+
+static uint32_t
+bandRows(
+    const CHANGE_DETECTOR_T *detector,
+    uint32_t first)
+{
+    uint32_t rows = detector->height - first;
+
+    return (rows < CHANGE_DETECTOR_BAND_ROWS)
+         ? rows
+         : CHANGE_DETECTOR_BAND_ROWS;
+}
+
+//-------------------------------------------------------------------------
+// Read back the sampled bands into their rows of the buffer.
+
+static bool
+readBands(
+    CHANGE_DETECTOR_T *detector,
+    DISPMANX_RESOURCE_HANDLE_T resource)
+{
+    uint32_t spacing = detector->stride * CHANGE_DETECTOR_BAND_ROWS;
+
+    uint32_t first = 0;
+    for (first = 0 ; first < detector->height ; first += spacing)
+    {
+        VC_RECT_T rect;
+        setRect(&rect, 0, first, detector->width, bandRows(detector, first));
+
+        if (displayBackend()->resourceReadData(resource,
+                                               &rect,
+                                               detector->buffer
+                                               + (first * detector->pitch),
+                                               detector->pitch) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+static uint64_t
+hashBands(
+    const CHANGE_DETECTOR_T *detector)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    uint32_t step = detector->stride * detector->bytesPerPixel;
+    uint32_t rowBytes = detector->width * detector->bytesPerPixel;
+    uint32_t spacing = detector->stride * CHANGE_DETECTOR_BAND_ROWS;
+
+    uint32_t first = 0;
+    for (first = 0 ; first < detector->height ; first += spacing)
+    {
+        uint32_t end = first + bandRows(detector, first);
+
+        uint32_t y = 0;
+        for (y = first ; y < end ; ++y)
+        {
+            const uint8_t *row = detector->buffer + (y * detector->pitch);
+
+            uint32_t x = 0;
+            for (x = 0 ; x < rowBytes ; x += step)
+            {
+                uint32_t pixel = 0;
+                memcpy(&pixel, row + x, detector->bytesPerPixel);
+
+                hash = (hash ^ pixel) * FNV_PRIME;
+            }
+        }
+    }
+
+    return hash;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+initChangeDetector(
+    CHANGE_DETECTOR_T *detector,
+    VC_IMAGE_TYPE_T type,
+    uint32_t width,
+    uint32_t height,
+    uint32_t stride)
+{
+    detector->width = width;
+    detector->height = height;
+    detector->bytesPerPixel = imageFormatBytesPerPixel(type);
+    detector->pitch = imageFormatPitch(type, width);
+    detector->stride = (stride > 0) ? stride : 1;
+    detector->hash = 0;
+    detector->valid = false;
+
+    detector->buffer = malloc(detector->pitch * height);
+
+    if (detector->buffer == NULL)
+    {
+        return false;
+    }
+
+    if ((detector->stride == 1)
+        && (initFrameDiff(&(detector->diff),
+                          type,
+                          width,
+                          height,
+                          FRAME_DIFF_DEFAULT_TILE_SIZE) == false))
+    {
+        free(detector->buffer);
+        detector->buffer = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Returns true if the resource differs from the last snapshot, or if it
+// could not be read back.
+
+bool
+changeDetectorChanged(
+    CHANGE_DETECTOR_T *detector,
+    DISPMANX_RESOURCE_HANDLE_T resource,
+    WORKER_POOL_T *pool)
+{
+    if (detector->stride > 1)
+    {
+        if (readBands(detector, resource) == false)
+        {
+            detector->valid = false;
+            return true;
+        }
+
+        uint64_t hash = hashBands(detector);
+
+        if (detector->valid && (hash == detector->hash))
+        {
+            return false;
+        }
+
+        detector->hash = hash;
+        detector->valid = true;
+
+        return true;
+    }
+
+    VC_RECT_T rect;
+    setRect(&rect, 0, 0, detector->width, detector->height);
+
+    if (displayBackend()->resourceReadData(resource,
+                                           &rect,
+                                           detector->buffer,
+                                           detector->pitch) != 0)
+    {
+        detector->valid = false;
+        return true;
+    }
+
+    if (detector->valid == false)
+    {
+        frameDiffReset(&(detector->diff));
+    }
+
+    bool changed = (frameDiffUpdate(&(detector->diff),
+                                    detector->buffer,
+                                    detector->pitch,
+                                    pool) > 0);
+
+    detector->hash = detector->diff.digest;
+    detector->valid = true;
+
+    return changed;
+}
+
+//-------------------------------------------------------------------------
+// The last snapshot, if the whole of it was read back, or NULL.
+
+const uint8_t *
+changeDetectorSnapshot(
+    const CHANGE_DETECTOR_T *detector)
+{
+    return (detector->valid && (detector->stride == 1))
+         ? detector->buffer
+         : NULL;
+}
+
+//-------------------------------------------------------------------------
+// Forget the last hash, so that the next snapshot is always presented.
+
+void
+changeDetectorReset(
+    CHANGE_DETECTOR_T *detector)
+{
+    detector->valid = false;
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyChangeDetector(
+    CHANGE_DETECTOR_T *detector)
+{
+    free(detector->buffer);
+    detector->buffer = NULL;
+
+    if (detector->stride == 1)
+    {
+        destroyFrameDiff(&(detector->diff));
+    }
+}
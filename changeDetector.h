@@ -0,0 +1,95 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef CHANGE_DETECTOR_H
+#define CHANGE_DETECTOR_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "displayTypes.h"
+
+#include "frameDiff.h"
+
+//-------------------------------------------------------------------------
+// Reads back a snapshot resource and hashes it, to decide whether the
+// snapshot differs from the last one that was presented. With a stride of
+// one the whole snapshot is read back and every pixel is compared, a tile
+// at a time. Otherwise only one band of CHANGE_DETECTOR_BAND_ROWS rows in
+// every stride bands is read back, so that about one stride'th of the
+// snapshot is copied, and every stride'th pixel of those rows is hashed.
+// Each band is a separate read back, so the bands are kept tall enough
+// for the number of them to stay small.
+
+#define CHANGE_DETECTOR_BAND_ROWS 16
+
+typedef struct
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerPixel;
+    uint32_t pitch;
+    uint32_t stride;
+    uint8_t *buffer;
+    FRAME_DIFF_T diff;
+    uint64_t hash;
+    bool valid;
+} CHANGE_DETECTOR_T;
+
+//-------------------------------------------------------------------------
+
+bool
+initChangeDetector(
+    CHANGE_DETECTOR_T *detector,
+    VC_IMAGE_TYPE_T type,
+    uint32_t width,
+    uint32_t height,
+    uint32_t stride);
+
+bool
+changeDetectorChanged(
+    CHANGE_DETECTOR_T *detector,
+    DISPMANX_RESOURCE_HANDLE_T resource,
+    WORKER_POOL_T *pool);
+
+const uint8_t *
+changeDetectorSnapshot(
+    const CHANGE_DETECTOR_T *detector);
+
+void
+changeDetectorReset(
+    CHANGE_DETECTOR_T *detector);
+
+void
+destroyChangeDetector(
+    CHANGE_DETECTOR_T *detector);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,113 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+
+#if defined(__arm__) || defined(__aarch64__)
+#include <sys/auxv.h>
+#endif
+
+#include "cpuFeatures.h"
+
+//-------------------------------------------------------------------------
+
+#if defined(__arm__) && !defined(HWCAP_NEON)
+#define HWCAP_NEON (1 << 12)
+#endif
+
+#if defined(__arm__) && !defined(HWCAP2_CRC32)
+#define HWCAP2_CRC32 (1 << 4)
+#endif
+
+#if defined(__aarch64__) && !defined(HWCAP_CRC32)
+#define HWCAP_CRC32 (1 << 7)
+#endif
+
+//-------------------------------------------------------------------------
+
+bool
+cpuHasNeon(void)
+{
+#if defined(__aarch64__)
+    return true;
+#elif defined(__arm__)
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+    return false;
+#endif
+}
+
+//-------------------------------------------------------------------------
+
+bool
+cpuHasSse2(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_cpu_supports("sse2");
+#else
+    return false;
+#endif
+}
+
+//-------------------------------------------------------------------------
+
+bool
+cpuHasAvx2(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+//-------------------------------------------------------------------------
+
+bool
+cpuHasSse42(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return false;
+#endif
+}
+
+//-------------------------------------------------------------------------
+// The ARMv8 CRC32 instructions (which are optional in ARMv8.0).
+
+bool
+cpuHasCrc32(void)
+{
+#if defined(__aarch64__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#elif defined(__arm__)
+    return (getauxval(AT_HWCAP2) & HWCAP2_CRC32) != 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,58 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+
+//-------------------------------------------------------------------------
+// Run time checks for the SIMD and CRC instructions used by the pixel and
+// tile hashing kernels, so
+// that one binary can use them where they are available. Each returns
+// false on processors of the other architecture.
+
+bool
+cpuHasNeon(void);
+
+bool
+cpuHasSse2(void);
+
+bool
+cpuHasAvx2(void);
+
+bool
+cpuHasSse42(void);
+
+bool
+cpuHasCrc32(void);
+
+//-------------------------------------------------------------------------
+
+#endif
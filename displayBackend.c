@@ -0,0 +1,145 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <strings.h>
+
+#include "displayBackend.h"
+#include "softwareBackend.h"
+
+#ifdef HAVE_DISPMANX
+#include "dispmanxBackend.h"
+#endif
+
+//-------------------------------------------------------------------------
+
+static const DISPLAY_BACKEND_T *backends[] =
+{
+#ifdef HAVE_DISPMANX
+    &dispmanxBackend,
+#endif
+    &softwareBackend
+};
+
+#define BACKEND_COUNT (sizeof(backends) / sizeof(backends[0]))
+
+static const DISPLAY_BACKEND_T *backend = NULL;
+
+//-------------------------------------------------------------------------
+// Select and initialise the named backend, or the first one available if
+// name is NULL.
+
+bool
+initDisplayBackend(
+    const char *name)
+{
+    const DISPLAY_BACKEND_T *selected = NULL;
+
+    if (name == NULL)
+    {
+        selected = backends[0];
+    }
+    else
+    {
+        size_t i = 0;
+        for (i = 0 ; i < BACKEND_COUNT ; ++i)
+        {
+            if (strcasecmp(name, backends[i]->name) == 0)
+            {
+                selected = backends[i];
+                break;
+            }
+        }
+    }
+
+    if ((selected == NULL) || (selected->init() == false))
+    {
+        return false;
+    }
+
+    backend = selected;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+const DISPLAY_BACKEND_T *
+displayBackend(void)
+{
+    return backend;
+}
+
+//-------------------------------------------------------------------------
+
+const char *
+displayBackendNames(void)
+{
+#ifdef HAVE_DISPMANX
+    return "dispmanx|software";
+#else
+    return "software";
+#endif
+}
+
+//-------------------------------------------------------------------------
+
+const char *
+defaultDisplayBackendName(void)
+{
+    return backends[0]->name;
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyDisplayBackend(void)
+{
+    if (backend != NULL)
+    {
+        backend->destroy();
+        backend = NULL;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+setRect(
+    VC_RECT_T *rect,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height)
+{
+    rect->x = x;
+    rect->y = y;
+    rect->width = width;
+    rect->height = height;
+}
@@ -0,0 +1,132 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef DISPLAY_BACKEND_H
+#define DISPLAY_BACKEND_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "displayTypes.h"
+
+//-------------------------------------------------------------------------
+// The display operations used by the pipelines. The DispmanX backend
+// passes them straight to the VideoCore. The software backend keeps
+// displays and resources in ordinary memory, so the pipelines can be run
+// and profiled on a machine without a GPU. Both use the DispmanX handle
+// and rectangle types (see displayTypes.h), and return 0 for success as
+// DispmanX does.
+//
+// There is one backend per process, chosen before any displays are
+// opened.
+
+typedef void (*DISPLAY_CHANGE_CALLBACK_T)(void);
+
+typedef struct
+{
+    const char *name;
+
+    bool (*init)(void);
+    void (*destroy)(void);
+
+    DISPMANX_DISPLAY_HANDLE_T (*displayOpen)(uint32_t device);
+    int (*displayClose)(DISPMANX_DISPLAY_HANDLE_T display);
+    int (*displayGetInfo)(DISPMANX_DISPLAY_HANDLE_T display,
+                          DISPMANX_MODEINFO_T *info);
+
+    DISPMANX_RESOURCE_HANDLE_T (*resourceCreate)(VC_IMAGE_TYPE_T type,
+                                                 uint32_t width,
+                                                 uint32_t height);
+    int (*resourceDelete)(DISPMANX_RESOURCE_HANDLE_T resource);
+    int (*resourceReadData)(DISPMANX_RESOURCE_HANDLE_T resource,
+                            const VC_RECT_T *rect,
+                            void *buffer,
+                            uint32_t pitch);
+
+    int (*snapshot)(DISPMANX_DISPLAY_HANDLE_T display,
+                    DISPMANX_RESOURCE_HANDLE_T resource,
+                    DISPMANX_TRANSFORM_T transform);
+
+    DISPMANX_UPDATE_HANDLE_T (*updateStart)(void);
+    int (*updateSubmit)(DISPMANX_UPDATE_HANDLE_T update,
+                        DISPMANX_CALLBACK_FUNC_T callback,
+                        void *arg);
+    int (*updateSubmitSync)(DISPMANX_UPDATE_HANDLE_T update);
+
+    DISPMANX_ELEMENT_HANDLE_T (*elementAdd)(DISPMANX_UPDATE_HANDLE_T update,
+                                            DISPMANX_DISPLAY_HANDLE_T display,
+                                            int32_t layer,
+                                            const VC_RECT_T *destRect,
+                                            DISPMANX_RESOURCE_HANDLE_T src,
+                                            const VC_RECT_T *srcRect,
+                                            VC_DISPMANX_ALPHA_T *alpha,
+                                            DISPMANX_TRANSFORM_T transform);
+    int (*elementChangeSource)(DISPMANX_UPDATE_HANDLE_T update,
+                               DISPMANX_ELEMENT_HANDLE_T element,
+                               DISPMANX_RESOURCE_HANDLE_T resource);
+    int (*elementRemove)(DISPMANX_UPDATE_HANDLE_T update,
+                         DISPMANX_ELEMENT_HANDLE_T element);
+
+    int (*vsyncCallback)(DISPMANX_DISPLAY_HANDLE_T display,
+                         DISPMANX_CALLBACK_FUNC_T callback,
+                         void *arg);
+
+    void (*watchDisplays)(DISPLAY_CHANGE_CALLBACK_T callback);
+    void (*unwatchDisplays)(DISPLAY_CHANGE_CALLBACK_T callback);
+} DISPLAY_BACKEND_T;
+
+//-------------------------------------------------------------------------
+
+bool
+initDisplayBackend(
+    const char *name);
+
+const DISPLAY_BACKEND_T *
+displayBackend(void);
+
+const char *
+displayBackendNames(void);
+
+const char *
+defaultDisplayBackendName(void);
+
+void
+destroyDisplayBackend(void);
+
+void
+setRect(
+    VC_RECT_T *rect,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,112 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef DISPLAY_TYPES_H
+#define DISPLAY_TYPES_H
+
+//-------------------------------------------------------------------------
+// The handle, rectangle, transform and image types shared by the display
+// backends. With the DispmanX backend these come from the Raspberry Pi
+// userland headers. Without it the same names are defined here, with the
+// same values, so the rest of the program builds and runs against the
+// software backend on a machine that has no /opt/vc.
+
+#ifdef HAVE_DISPMANX
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-but-set-variable"
+#include "bcm_host.h"
+#pragma GCC diagnostic pop
+
+#else
+
+#include <stdint.h>
+
+//-------------------------------------------------------------------------
+
+typedef uint32_t DISPMANX_DISPLAY_HANDLE_T;
+typedef uint32_t DISPMANX_RESOURCE_HANDLE_T;
+typedef uint32_t DISPMANX_ELEMENT_HANDLE_T;
+typedef uint32_t DISPMANX_UPDATE_HANDLE_T;
+
+typedef enum
+{
+    DISPMANX_NO_ROTATE = 0,
+    DISPMANX_ROTATE_90 = 1,
+    DISPMANX_ROTATE_180 = 2,
+    DISPMANX_ROTATE_270 = 3,
+
+    DISPMANX_FLIP_HRIZ = 1 << 16,
+    DISPMANX_FLIP_VERT = 1 << 17
+} DISPMANX_TRANSFORM_T;
+
+typedef enum
+{
+    DISPMANX_FLAGS_ALPHA_FROM_SOURCE = 0,
+    DISPMANX_FLAGS_ALPHA_FIXED_ALL_PIXELS = 1
+} DISPMANX_FLAGS_ALPHA_T;
+
+typedef struct
+{
+    DISPMANX_FLAGS_ALPHA_T flags;
+    uint32_t opacity;
+    DISPMANX_RESOURCE_HANDLE_T mask;
+} VC_DISPMANX_ALPHA_T;
+
+typedef struct
+{
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+} VC_RECT_T;
+
+typedef enum
+{
+    VC_IMAGE_RGB565 = 1,
+    VC_IMAGE_RGB888 = 5,
+    VC_IMAGE_RGBA32 = 15,
+    VC_IMAGE_RGBX32 = 39
+} VC_IMAGE_TYPE_T;
+
+typedef struct
+{
+    int32_t width;
+    int32_t height;
+    DISPMANX_TRANSFORM_T transform;
+    int input_format;
+    uint32_t display_num;
+} DISPMANX_MODEINFO_T;
+
+typedef void (*DISPMANX_CALLBACK_FUNC_T)(DISPMANX_UPDATE_HANDLE_T update,
+                                         void *arg);
+
+#endif
+
+//-------------------------------------------------------------------------
+
+#endif
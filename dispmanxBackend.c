@@ -0,0 +1,272 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dispmanxBackend.h"
+
+//-------------------------------------------------------------------------
+
+static DISPLAY_CHANGE_CALLBACK_T displayChangeCallback = NULL;
+
+//-------------------------------------------------------------------------
+
+static bool
+dispmanxInit(void)
+{
+    bcm_host_init();
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+dispmanxDestroy(void)
+{
+    bcm_host_deinit();
+}
+
+//-------------------------------------------------------------------------
+
+static DISPMANX_DISPLAY_HANDLE_T
+dispmanxDisplayOpen(
+    uint32_t device)
+{
+    return vc_dispmanx_display_open(device);
+}
+
+//-------------------------------------------------------------------------
+
+static int
+dispmanxDisplayClose(
+    DISPMANX_DISPLAY_HANDLE_T display)
+{
+    return vc_dispmanx_display_close(display);
+}
+
+//-------------------------------------------------------------------------
+
+static int
+dispmanxDisplayGetInfo(
+    DISPMANX_DISPLAY_HANDLE_T display,
+    DISPMANX_MODEINFO_T *info)
+{
+    return vc_dispmanx_display_get_info(display, info);
+}
+
+//-------------------------------------------------------------------------
+
+static DISPMANX_RESOURCE_HANDLE_T
+dispmanxResourceCreate(
+    VC_IMAGE_TYPE_T type,
+    uint32_t width,
+    uint32_t height)
+{
+    uint32_t image_ptr;
+
+    return vc_dispmanx_resource_create(type, width, height, &image_ptr);
+}
+
+//-------------------------------------------------------------------------
+
+static int
+dispmanxResourceDelete(
+    DISPMANX_RESOURCE_HANDLE_T resource)
+{
+    return vc_dispmanx_resource_delete(resource);
+}
+
+//-------------------------------------------------------------------------
+
+static int
+dispmanxResourceReadData(
+    DISPMANX_RESOURCE_HANDLE_T resource,
+    const VC_RECT_T *rect,
+    void *buffer,
+    uint32_t pitch)
+{
+    return vc_dispmanx_resource_read_data(resource, rect, buffer, pitch);
+}
+
+//-------------------------------------------------------------------------
+
+static int
+dispmanxSnapshot(
+    DISPMANX_DISPLAY_HANDLE_T display,
+    DISPMANX_RESOURCE_HANDLE_T resource,
+    DISPMANX_TRANSFORM_T transform)
+{
+    return vc_dispmanx_snapshot(display, resource, transform);
+}
+
+//-------------------------------------------------------------------------
+
+static DISPMANX_UPDATE_HANDLE_T
+dispmanxUpdateStart(void)
+{
+    return vc_dispmanx_update_start(0);
+}
+
+//-------------------------------------------------------------------------
+
+static int
+dispmanxUpdateSubmit(
+    DISPMANX_UPDATE_HANDLE_T update,
+    DISPMANX_CALLBACK_FUNC_T callback,
+    void *arg)
+{
+    return vc_dispmanx_update_submit(update, callback, arg);
+}
+
+//-------------------------------------------------------------------------
+
+static int
+dispmanxUpdateSubmitSync(
+    DISPMANX_UPDATE_HANDLE_T update)
+{
+    return vc_dispmanx_update_submit_sync(update);
+}
+
+//-------------------------------------------------------------------------
+
+static DISPMANX_ELEMENT_HANDLE_T
+dispmanxElementAdd(
+    DISPMANX_UPDATE_HANDLE_T update,
+    DISPMANX_DISPLAY_HANDLE_T display,
+    int32_t layer,
+    const VC_RECT_T *destRect,
+    DISPMANX_RESOURCE_HANDLE_T src,
+    const VC_RECT_T *srcRect,
+    VC_DISPMANX_ALPHA_T *alpha,
+    DISPMANX_TRANSFORM_T transform)
+{
+    return vc_dispmanx_element_add(update,
+                                   display,
+                                   layer,
+                                   destRect,
+                                   src,
+                                   srcRect,
+                                   DISPMANX_PROTECTION_NONE,
+                                   alpha,
+                                   NULL,
+                                   transform);
+}
+
+//-------------------------------------------------------------------------
+
+static int
+dispmanxElementChangeSource(
+    DISPMANX_UPDATE_HANDLE_T update,
+    DISPMANX_ELEMENT_HANDLE_T element,
+    DISPMANX_RESOURCE_HANDLE_T resource)
+{
+    return vc_dispmanx_element_change_source(update, element, resource);
+}
+
+//-------------------------------------------------------------------------
+
+static int
+dispmanxElementRemove(
+    DISPMANX_UPDATE_HANDLE_T update,
+    DISPMANX_ELEMENT_HANDLE_T element)
+{
+    return vc_dispmanx_element_remove(update, element);
+}
+
+//-------------------------------------------------------------------------
+
+static int
+dispmanxVsyncCallback(
+    DISPMANX_DISPLAY_HANDLE_T display,
+    DISPMANX_CALLBACK_FUNC_T callback,
+    void *arg)
+{
+    return vc_dispmanx_vsync_callback(display, callback, arg);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+tvServiceCallback(
+    void *callback_data,
+    uint32_t reason,
+    uint32_t param1,
+    uint32_t param2)
+{
+    if (displayChangeCallback != NULL)
+    {
+        displayChangeCallback();
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+dispmanxWatchDisplays(
+    DISPLAY_CHANGE_CALLBACK_T callback)
+{
+    displayChangeCallback = callback;
+    vc_tv_register_callback(tvServiceCallback, NULL);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+dispmanxUnwatchDisplays(
+    DISPLAY_CHANGE_CALLBACK_T callback)
+{
+    vc_tv_unregister_callback(tvServiceCallback);
+    displayChangeCallback = NULL;
+}
+
+//-------------------------------------------------------------------------
+
+const DISPLAY_BACKEND_T dispmanxBackend =
+{
+    .name = "dispmanx",
+    .init = dispmanxInit,
+    .destroy = dispmanxDestroy,
+    .displayOpen = dispmanxDisplayOpen,
+    .displayClose = dispmanxDisplayClose,
+    .displayGetInfo = dispmanxDisplayGetInfo,
+    .resourceCreate = dispmanxResourceCreate,
+    .resourceDelete = dispmanxResourceDelete,
+    .resourceReadData = dispmanxResourceReadData,
+    .snapshot = dispmanxSnapshot,
+    .updateStart = dispmanxUpdateStart,
+    .updateSubmit = dispmanxUpdateSubmit,
+    .updateSubmitSync = dispmanxUpdateSubmitSync,
+    .elementAdd = dispmanxElementAdd,
+    .elementChangeSource = dispmanxElementChangeSource,
+    .elementRemove = dispmanxElementRemove,
+    .vsyncCallback = dispmanxVsyncCallback,
+    .watchDisplays = dispmanxWatchDisplays,
+    .unwatchDisplays = dispmanxUnwatchDisplays
+};
@@ -0,0 +1,535 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define FRAME_DIFF_SSE42
+#elif defined(__arm__) || defined(__aarch64__)
+#define FRAME_DIFF_ARM_CRC32
+#endif
+
+#include "cpuFeatures.h"
+#include "frameDiff.h"
+#include "frameDiffKernels.h"
+#include "imageFormat.h"
+
+//-------------------------------------------------------------------------
+
+#define CRC32C_POLYNOMIAL 0x82F63B78
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+//-------------------------------------------------------------------------
+
+// crcTables[0] is the usual byte at a time table; crcTables[k] gives the
+// CRC of a byte followed by k zero bytes, for eight bytes at a time.
+
+static uint32_t crcTables[8][256];
+
+static pthread_once_t hashRowOnce = PTHREAD_ONCE_INIT;
+static HASH_ROW_T hashRow = NULL;
+static const char *hashRowName = NULL;
+
+//-------------------------------------------------------------------------
+
+static uint32_t
+crcUpdateScalar(
+    uint32_t crc,
+    const uint8_t *data,
+    uint32_t length)
+{
+    uint32_t i = 0;
+    for (i = 0 ; i < length ; ++i)
+    {
+        crc = crcTables[0][(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+hashRowScalar(
+    uint32_t *crcs,
+    const uint8_t *row,
+    uint32_t fullTiles,
+    uint32_t tileBytes,
+    uint32_t lastBytes)
+{
+    uint32_t t = 0;
+    for (t = 0 ; t < fullTiles ; ++t)
+    {
+        crcs[t] = crcUpdateScalar(crcs[t], row + (t * tileBytes), tileBytes);
+    }
+
+    if (lastBytes > 0)
+    {
+        crcs[t] = crcUpdateScalar(crcs[t], row + (t * tileBytes), lastBytes);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static uint64_t
+load64(
+    const uint8_t *data)
+{
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+
+    return value;
+}
+
+//-------------------------------------------------------------------------
+// Table CRC eight bytes at a time, for processors without CRC
+// instructions. Neither SSE2 nor ARMv7 NEON has a carry-less multiply or
+// a table lookup wide enough to do better. The eight bytes are loaded
+// as one little endian word.
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define FRAME_DIFF_SLICE_BY_8
+#endif
+
+#ifdef FRAME_DIFF_SLICE_BY_8
+
+static uint32_t
+crcUpdateSliceBy8(
+    uint32_t crc,
+    const uint8_t *data,
+    uint32_t length)
+{
+    uint32_t i = 0;
+    for (i = 0 ; (i + 8) <= length ; i += 8)
+    {
+        uint64_t value = load64(data + i) ^ crc;
+
+        crc = crcTables[7][value & 0xFF]
+            ^ crcTables[6][(value >> 8) & 0xFF]
+            ^ crcTables[5][(value >> 16) & 0xFF]
+            ^ crcTables[4][(value >> 24) & 0xFF]
+            ^ crcTables[3][(value >> 32) & 0xFF]
+            ^ crcTables[2][(value >> 40) & 0xFF]
+            ^ crcTables[1][(value >> 48) & 0xFF]
+            ^ crcTables[0][value >> 56];
+    }
+
+    return crcUpdateScalar(crc, data + i, length - i);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+hashRowSliceBy8(
+    uint32_t *crcs,
+    const uint8_t *row,
+    uint32_t fullTiles,
+    uint32_t tileBytes,
+    uint32_t lastBytes)
+{
+    uint32_t t = 0;
+    for (t = 0 ; t < fullTiles ; ++t)
+    {
+        crcs[t] = crcUpdateSliceBy8(crcs[t],
+                                    row + (t * tileBytes),
+                                    tileBytes);
+    }
+
+    if (lastBytes > 0)
+    {
+        crcs[t] = crcUpdateSliceBy8(crcs[t],
+                                    row + (t * tileBytes),
+                                    lastBytes);
+    }
+}
+
+#endif
+
+//-------------------------------------------------------------------------
+
+#ifdef FRAME_DIFF_SSE42
+
+__attribute__((target("sse4.2")))
+static uint32_t
+crcUpdateSse42(
+    uint32_t crc,
+    const uint8_t *data,
+    uint32_t length)
+{
+    uint64_t crc64 = crc;
+
+    uint32_t i = 0;
+    for (i = 0 ; (i + 8) <= length ; i += 8)
+    {
+        crc64 = _mm_crc32_u64(crc64, load64(data + i));
+    }
+
+    crc = crc64;
+
+    for ( ; i < length ; ++i)
+    {
+        crc = _mm_crc32_u8(crc, data[i]);
+    }
+
+    return crc;
+}
+
+//-------------------------------------------------------------------------
+
+__attribute__((target("sse4.2")))
+static void
+hashRowSse42(
+    uint32_t *crcs,
+    const uint8_t *row,
+    uint32_t fullTiles,
+    uint32_t tileBytes,
+    uint32_t lastBytes)
+{
+    uint32_t t = 0;
+
+    if ((tileBytes % 8) == 0)
+    {
+        uint32_t grouped = fullTiles - (fullTiles % INTERLEAVED_TILES);
+
+        for (t = 0 ; t < grouped ; t += INTERLEAVED_TILES)
+        {
+            const uint8_t *tile = row + (t * tileBytes);
+
+            uint64_t crc0 = crcs[t];
+            uint64_t crc1 = crcs[t + 1];
+            uint64_t crc2 = crcs[t + 2];
+            uint64_t crc3 = crcs[t + 3];
+
+            uint32_t i = 0;
+            for (i = 0 ; i < tileBytes ; i += 8)
+            {
+                crc0 = _mm_crc32_u64(crc0, load64(tile + i));
+                crc1 = _mm_crc32_u64(crc1, load64(tile + tileBytes + i));
+                crc2 = _mm_crc32_u64(crc2,
+                                     load64(tile + (2 * tileBytes) + i));
+                crc3 = _mm_crc32_u64(crc3,
+                                     load64(tile + (3 * tileBytes) + i));
+            }
+
+            crcs[t] = crc0;
+            crcs[t + 1] = crc1;
+            crcs[t + 2] = crc2;
+            crcs[t + 3] = crc3;
+        }
+    }
+
+    for ( ; t < fullTiles ; ++t)
+    {
+        crcs[t] = crcUpdateSse42(crcs[t], row + (t * tileBytes), tileBytes);
+    }
+
+    if (lastBytes > 0)
+    {
+        crcs[t] = crcUpdateSse42(crcs[t], row + (t * tileBytes), lastBytes);
+    }
+}
+
+#endif
+
+//-------------------------------------------------------------------------
+
+static const FRAME_DIFF_KERNEL_T kernels[] =
+{
+#ifdef FRAME_DIFF_SSE42
+    { "sse4.2", hashRowSse42, cpuHasSse42 },
+#endif
+#ifdef FRAME_DIFF_ARM_CRC32
+    { "armv8 crc32", hashRowArm, cpuHasCrc32 },
+#endif
+#ifdef FRAME_DIFF_SLICE_BY_8
+    { "slice-by-8", hashRowSliceBy8, NULL },
+#endif
+    { "table", hashRowScalar, NULL }
+};
+
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+//-------------------------------------------------------------------------
+
+static void
+selectHashRow(void)
+{
+    uint32_t i = 0;
+    for (i = 0 ; i < 256 ; ++i)
+    {
+        uint32_t crc = i;
+
+        uint32_t bit = 0;
+        for (bit = 0 ; bit < 8 ; ++bit)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : (crc >> 1);
+        }
+
+        crcTables[0][i] = crc;
+    }
+
+    for (i = 0 ; i < 256 ; ++i)
+    {
+        uint32_t k = 0;
+        for (k = 1 ; k < 8 ; ++k)
+        {
+            uint32_t crc = crcTables[k - 1][i];
+
+            crcTables[k][i] = crcTables[0][crc & 0xFF] ^ (crc >> 8);
+        }
+    }
+
+    // the kernels are in order of preference, ending with the byte at a
+    // time table that is always available
+
+    i = 0;
+    while ((kernels[i].available != NULL)
+           && (kernels[i].available() == false))
+    {
+        ++i;
+    }
+
+    hashRow = kernels[i].hashRow;
+    hashRowName = kernels[i].name;
+}
+
+//-------------------------------------------------------------------------
+// Every kernel built into the program, whether or not the processor can
+// run it (available is NULL for the table kernels, which always can).
+
+const FRAME_DIFF_KERNEL_T *
+frameDiffKernels(
+    uint32_t *count)
+{
+    pthread_once(&hashRowOnce, selectHashRow);
+
+    *count = KERNEL_COUNT;
+
+    return kernels;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+initFrameDiff(
+    FRAME_DIFF_T *diff,
+    VC_IMAGE_TYPE_T type,
+    uint32_t width,
+    uint32_t height,
+    uint32_t tileSize)
+{
+    pthread_once(&hashRowOnce, selectHashRow);
+
+    memset(diff, 0, sizeof(*diff));
+
+    diff->width = width;
+    diff->height = height;
+    diff->bytesPerPixel = imageFormatBytesPerPixel(type);
+    diff->tileSize = (tileSize > 0) ? tileSize : FRAME_DIFF_DEFAULT_TILE_SIZE;
+    diff->tilesAcross = (width + diff->tileSize - 1) / diff->tileSize;
+    diff->tilesDown = (height + diff->tileSize - 1) / diff->tileSize;
+    diff->tileCount = diff->tilesAcross * diff->tilesDown;
+
+    diff->hashes = calloc(diff->tileCount, sizeof(uint32_t));
+    diff->previous = calloc(diff->tileCount, sizeof(uint32_t));
+    diff->dirty = calloc((diff->tileCount + 31) / 32, sizeof(uint32_t));
+
+    if ((diff->hashes == NULL)
+        || (diff->previous == NULL)
+        || (diff->dirty == NULL))
+    {
+        destroyFrameDiff(diff);
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    FRAME_DIFF_T *diff;
+    const uint8_t *pixels;
+    uint32_t pitch;
+} FRAME_DIFF_JOB_T;
+
+//-------------------------------------------------------------------------
+// Hash one stripe of rows of tiles.
+
+static void
+hashFrameDiffStripe(
+    void *arg,
+    uint32_t stripe,
+    uint32_t stripes)
+{
+    FRAME_DIFF_JOB_T *job = arg;
+    FRAME_DIFF_T *diff = job->diff;
+
+    uint32_t fullTiles = diff->width / diff->tileSize;
+    uint32_t tileBytes = diff->tileSize * diff->bytesPerPixel;
+    uint32_t lastBytes = (diff->width % diff->tileSize) * diff->bytesPerPixel;
+
+    uint32_t firstTileY = 0;
+    uint32_t endTileY = 0;
+
+    workerPoolStripe(stripe,
+                     stripes,
+                     diff->tilesDown,
+                     1,
+                     &firstTileY,
+                     &endTileY);
+
+    uint32_t tileY = 0;
+    for (tileY = firstTileY ; tileY < endTileY ; ++tileY)
+    {
+        uint32_t *crcs = diff->hashes + (tileY * diff->tilesAcross);
+
+        uint32_t i = 0;
+        for (i = 0 ; i < diff->tilesAcross ; ++i)
+        {
+            crcs[i] = CRC32C_INITIAL;
+        }
+
+        uint32_t y = tileY * diff->tileSize;
+        uint32_t end = y + diff->tileSize;
+
+        if (end > diff->height)
+        {
+            end = diff->height;
+        }
+
+        for ( ; y < end ; ++y)
+        {
+            hashRow(crcs,
+                    job->pixels + (y * job->pitch),
+                    fullTiles,
+                    tileBytes,
+                    lastBytes);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+// Hash the tiles of a frame, in stripes on the pool if there is one, and
+// mark those that have changed since the last frame. Every tile is dirty
+// if there is no last frame. Returns the number of dirty tiles.
+
+uint32_t
+frameDiffUpdate(
+    FRAME_DIFF_T *diff,
+    const uint8_t *pixels,
+    uint32_t pitch,
+    WORKER_POOL_T *pool)
+{
+    uint32_t *swap = diff->previous;
+    diff->previous = diff->hashes;
+    diff->hashes = swap;
+
+    FRAME_DIFF_JOB_T job = { diff, pixels, pitch };
+
+    workerPoolRun(pool, hashFrameDiffStripe, &job);
+
+    //---------------------------------------------------------------------
+
+    memset(diff->dirty, 0, ((diff->tileCount + 31) / 32) * sizeof(uint32_t));
+    diff->dirtyCount = 0;
+    diff->digest = FNV_OFFSET_BASIS;
+
+    uint32_t i = 0;
+    for (i = 0 ; i < diff->tileCount ; ++i)
+    {
+        if ((diff->valid == false) || (diff->hashes[i] != diff->previous[i]))
+        {
+            diff->dirty[i / 32] |= 1U << (i % 32);
+            ++(diff->dirtyCount);
+        }
+
+        diff->digest = (diff->digest ^ diff->hashes[i]) * FNV_PRIME;
+    }
+
+    diff->valid = true;
+
+    return diff->dirtyCount;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+frameDiffTileDirty(
+    const FRAME_DIFF_T *diff,
+    uint32_t tileX,
+    uint32_t tileY)
+{
+    uint32_t i = (tileY * diff->tilesAcross) + tileX;
+
+    return (diff->dirty[i / 32] & (1U << (i % 32))) != 0;
+}
+
+//-------------------------------------------------------------------------
+// Forget the last frame, so that every tile of the next one is dirty.
+
+void
+frameDiffReset(
+    FRAME_DIFF_T *diff)
+{
+    diff->valid = false;
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyFrameDiff(
+    FRAME_DIFF_T *diff)
+{
+    free(diff->hashes);
+    diff->hashes = NULL;
+
+    free(diff->previous);
+    diff->previous = NULL;
+
+    free(diff->dirty);
+    diff->dirty = NULL;
+}
+
+//-------------------------------------------------------------------------
+// The name of the CRC implementation used to hash tiles.
+
+const char *
+frameDiffImplementation(void)
+{
+    pthread_once(&hashRowOnce, selectHashRow);
+
+    return hashRowName;
+}
@@ -0,0 +1,106 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef FRAME_DIFF_H
+#define FRAME_DIFF_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "displayTypes.h"
+
+#include "workerPool.h"
+
+//-------------------------------------------------------------------------
+
+#define FRAME_DIFF_DEFAULT_TILE_SIZE 32
+
+//-------------------------------------------------------------------------
+// Splits frames, as read back from a snapshot resource, into square tiles
+// and hashes every byte of each tile with CRC32C. Tiles whose hash differs
+// from the last frame are marked in a bitmap (one bit per tile, in rows
+// of tilesAcross), and the tile hashes are combined into a digest of the
+// whole frame. The CRC uses the SSE4.2 or ARMv8 CRC32 instructions when
+// the processor has them, chosen at run time, and tables eight bytes at a
+// time otherwise; all give the same hashes.
+
+typedef struct
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerPixel;
+    uint32_t tileSize;
+    uint32_t tilesAcross;
+    uint32_t tilesDown;
+    uint32_t tileCount;
+    uint32_t *hashes;
+    uint32_t *previous;
+    uint32_t *dirty;
+    uint32_t dirtyCount;
+    uint64_t digest;
+    bool valid;
+} FRAME_DIFF_T;
+
+//-------------------------------------------------------------------------
+
+bool
+initFrameDiff(
+    FRAME_DIFF_T *diff,
+    VC_IMAGE_TYPE_T type,
+    uint32_t width,
+    uint32_t height,
+    uint32_t tileSize);
+
+uint32_t
+frameDiffUpdate(
+    FRAME_DIFF_T *diff,
+    const uint8_t *pixels,
+    uint32_t pitch,
+    WORKER_POOL_T *pool);
+
+bool
+frameDiffTileDirty(
+    const FRAME_DIFF_T *diff,
+    uint32_t tileX,
+    uint32_t tileY);
+
+void
+frameDiffReset(
+    FRAME_DIFF_T *diff);
+
+void
+destroyFrameDiff(
+    FRAME_DIFF_T *diff);
+
+const char *
+frameDiffImplementation(void);
+
+//-------------------------------------------------------------------------
+
+#endif
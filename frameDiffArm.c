@@ -0,0 +1,131 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+// The ARMv8 CRC32 kernel is in a file of its own so that it can be built
+// for ARMv8 with the CRC extension (-march=armv8-a+crc) while the rest of
+// the program still runs on older processors; it is only called once
+// cpuHasCrc32() says it can be.
+
+#if defined(__arm__) || defined(__aarch64__)
+
+#if !defined(__ARM_FEATURE_CRC32)
+#error "frameDiffArm.c must be compiled with the CRC extension (+crc)"
+#endif
+
+#include <arm_acle.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "frameDiffKernels.h"
+
+//-------------------------------------------------------------------------
+
+static uint64_t
+load64(
+    const uint8_t *data)
+{
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+
+    return value;
+}
+
+//-------------------------------------------------------------------------
+
+static uint32_t
+crcUpdateArm(
+    uint32_t crc,
+    const uint8_t *data,
+    uint32_t length)
+{
+    uint32_t i = 0;
+    for (i = 0 ; (i + 8) <= length ; i += 8)
+    {
+        crc = __crc32cd(crc, load64(data + i));
+    }
+
+    for ( ; i < length ; ++i)
+    {
+        crc = __crc32cb(crc, data[i]);
+    }
+
+    return crc;
+}
+
+//-------------------------------------------------------------------------
+
+void
+hashRowArm(
+    uint32_t *crcs,
+    const uint8_t *row,
+    uint32_t fullTiles,
+    uint32_t tileBytes,
+    uint32_t lastBytes)
+{
+    uint32_t t = 0;
+
+    if ((tileBytes % 8) == 0)
+    {
+        uint32_t grouped = fullTiles - (fullTiles % INTERLEAVED_TILES);
+
+        for (t = 0 ; t < grouped ; t += INTERLEAVED_TILES)
+        {
+            const uint8_t *tile = row + (t * tileBytes);
+
+            uint32_t crc0 = crcs[t];
+            uint32_t crc1 = crcs[t + 1];
+            uint32_t crc2 = crcs[t + 2];
+            uint32_t crc3 = crcs[t + 3];
+
+            uint32_t i = 0;
+            for (i = 0 ; i < tileBytes ; i += 8)
+            {
+                crc0 = __crc32cd(crc0, load64(tile + i));
+                crc1 = __crc32cd(crc1, load64(tile + tileBytes + i));
+                crc2 = __crc32cd(crc2, load64(tile + (2 * tileBytes) + i));
+                crc3 = __crc32cd(crc3, load64(tile + (3 * tileBytes) + i));
+            }
+
+            crcs[t] = crc0;
+            crcs[t + 1] = crc1;
+            crcs[t + 2] = crc2;
+            crcs[t + 3] = crc3;
+        }
+    }
+
+    for ( ; t < fullTiles ; ++t)
+    {
+        crcs[t] = crcUpdateArm(crcs[t], row + (t * tileBytes), tileBytes);
+    }
+
+    if (lastBytes > 0)
+    {
+        crcs[t] = crcUpdateArm(crcs[t], row + (t * tileBytes), lastBytes);
+    }
+}
+
+#endif
@@ -0,0 +1,86 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef FRAME_DIFF_KERNELS_H
+#define FRAME_DIFF_KERNELS_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------------------
+// The tile hashing kernels behind frameDiffUpdate(), for the kernels
+// built in separate files and for testing them against each other.
+
+#define CRC32C_INITIAL 0xFFFFFFFF
+
+// Tiles hashed side by side by the hardware CRC kernels. Each CRC
+// instruction depends on the result of the one before it in the same
+// tile, so working on several tiles at once keeps the pipeline full.
+
+#define INTERLEAVED_TILES 4
+
+// Adds one row of each tile to the tiles' CRCs. The row has fullTiles
+// tiles of tileBytes bytes, followed by a partial tile of lastBytes bytes
+// if lastBytes is not zero.
+
+typedef void (*HASH_ROW_T)(
+    uint32_t *crcs,
+    const uint8_t *row,
+    uint32_t fullTiles,
+    uint32_t tileBytes,
+    uint32_t lastBytes);
+
+typedef struct
+{
+    const char *name;
+    HASH_ROW_T hashRow;
+    bool (*available)(void);
+} FRAME_DIFF_KERNEL_T;
+
+//-------------------------------------------------------------------------
+
+const FRAME_DIFF_KERNEL_T *
+frameDiffKernels(
+    uint32_t *count);
+
+#if defined(__arm__) || defined(__aarch64__)
+
+void
+hashRowArm(
+    uint32_t *crcs,
+    const uint8_t *row,
+    uint32_t fullTiles,
+    uint32_t tileBytes,
+    uint32_t lastBytes);
+
+#endif
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,569 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frameDiff.h"
+#include "frameDiffKernels.h"
+#include "frameScheduler.h"
+#include "imageFormat.h"
+
+//-------------------------------------------------------------------------
+// Checks that every tile hashing kernel the processor can run gives
+// exactly the CRCs of the byte at a time table, for rows of whole tiles
+// followed by partial ones, in each pixel format and with tile rows that
+// are and are not a multiple of eight bytes. Then checks whole frames,
+// with padding at the end of each row, against a CRC32C computed a bit
+// at a time, and that changes show up in only the right tile. With
+// --benchmark, times each kernel hashing whole frames instead.
+
+#define DEFAULT_WIDTH 1920
+#define DEFAULT_HEIGHT 1080
+
+#define CRC32C_POLYNOMIAL 0x82F63B78
+
+#define TEST_ROWS 3
+#define TEST_MAX_TILES 11
+#define TEST_PITCH_PADDING 24
+
+static const VC_IMAGE_TYPE_T testTypes[] =
+{
+    VC_IMAGE_RGB565,
+    VC_IMAGE_RGB888,
+    VC_IMAGE_RGBX32
+};
+
+static const uint32_t testTileSizes[] = { 1, 3, 8, 16, 32, 33, 64 };
+
+#define COUNT_OF(array) (sizeof(array) / sizeof(array[0]))
+
+//-------------------------------------------------------------------------
+
+void
+printUsage(
+    FILE *fp,
+    const char *name)
+{
+    fprintf(fp, "\n");
+    fprintf(fp, "Usage: %s <options>\n", name);
+    fprintf(fp, "\n");
+    fprintf(fp, "    --benchmark <frames> - time hashing this many");
+    fprintf(fp, " frames with each kernel instead of testing\n");
+    fprintf(fp, "    --width <pixels> - width of benchmark frames");
+    fprintf(fp, " (default %d)\n", DEFAULT_WIDTH);
+    fprintf(fp, "    --height <pixels> - height of benchmark frames");
+    fprintf(fp, " (default %d)\n", DEFAULT_HEIGHT);
+    fprintf(fp, "    --help - print usage and exit\n");
+    fprintf(fp, "\n");
+}
+
+//-------------------------------------------------------------------------
+// Pseudo random bytes, the same on every run.
+
+static void
+fillBytes(
+    uint8_t *bytes,
+    size_t size)
+{
+    uint32_t state = 0x87654321;
+
+    size_t i = 0;
+    for (i = 0 ; i < size ; ++i)
+    {
+        state = (state * 1103515245) + 12345;
+        bytes[i] = state >> 16;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static uint32_t
+crcBitwise(
+    uint32_t crc,
+    const uint8_t *data,
+    uint32_t length)
+{
+    uint32_t i = 0;
+    for (i = 0 ; i < length ; ++i)
+    {
+        crc ^= data[i];
+
+        uint32_t bit = 0;
+        for (bit = 0 ; bit < 8 ; ++bit)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : (crc >> 1);
+        }
+    }
+
+    return crc;
+}
+
+//-------------------------------------------------------------------------
+// Hash TEST_ROWS rows of every combination of whole and partial tiles
+// with the kernel and with the table, starting from the same CRCs.
+
+static bool
+testKernel(
+    const FRAME_DIFF_KERNEL_T *kernel,
+    const FRAME_DIFF_KERNEL_T *table,
+    const uint8_t *bytes)
+{
+    uint32_t failures = 0;
+    uint32_t cases = 0;
+
+    size_t f = 0;
+    for (f = 0 ; f < COUNT_OF(testTypes) ; ++f)
+    {
+        uint32_t bytesPerPixel = imageFormatBytesPerPixel(testTypes[f]);
+
+        size_t s = 0;
+        for (s = 0 ; s < COUNT_OF(testTileSizes) ; ++s)
+        {
+            uint32_t tileSize = testTileSizes[s];
+            uint32_t tileBytes = tileSize * bytesPerPixel;
+
+            uint32_t fullTiles = 0;
+            for (fullTiles = 0 ; fullTiles < TEST_MAX_TILES ; ++fullTiles)
+            {
+                uint32_t last = 0;
+                for (last = 0 ; last < tileSize ; ++last)
+                {
+                    uint32_t lastBytes = last * bytesPerPixel;
+                    uint32_t rowBytes = (fullTiles * tileBytes) + lastBytes;
+
+                    uint32_t expected[TEST_MAX_TILES + 1];
+                    uint32_t actual[TEST_MAX_TILES + 1];
+
+                    uint32_t t = 0;
+                    for (t = 0 ; t <= TEST_MAX_TILES ; ++t)
+                    {
+                        expected[t] = CRC32C_INITIAL - t;
+                        actual[t] = CRC32C_INITIAL - t;
+                    }
+
+                    // each row starts a byte further on, so that the
+                    // rows are not all aligned for the word loads
+
+                    uint32_t y = 0;
+                    for (y = 0 ; y < TEST_ROWS ; ++y)
+                    {
+                        const uint8_t *row = bytes + (y * (rowBytes + 1));
+
+                        table->hashRow(expected,
+                                       row,
+                                       fullTiles,
+                                       tileBytes,
+                                       lastBytes);
+                        kernel->hashRow(actual,
+                                        row,
+                                        fullTiles,
+                                        tileBytes,
+                                        lastBytes);
+                    }
+
+                    ++cases;
+
+                    if ((memcmp(expected, actual, sizeof(actual)) != 0)
+                        && (failures++ < 10))
+                    {
+                        printf("%s: FAILED, %s tile size %"PRIu32", %"
+                               PRIu32" whole tiles and %"PRIu32" pixels\n",
+                               kernel->name,
+                               imageFormatName(testTypes[f]),
+                               tileSize,
+                               fullTiles,
+                               last);
+                    }
+                }
+            }
+        }
+    }
+
+    printf("%s: %"PRIu32" of %"PRIu32" rows of tiles match the table\n",
+           kernel->name,
+           cases - failures,
+           cases);
+
+    return failures == 0;
+}
+
+//-------------------------------------------------------------------------
+
+static uint32_t
+tileCrc(
+    const uint8_t *pixels,
+    uint32_t pitch,
+    uint32_t bytesPerPixel,
+    uint32_t width,
+    uint32_t height,
+    uint32_t tileSize,
+    uint32_t tileX,
+    uint32_t tileY)
+{
+    uint32_t x = tileX * tileSize;
+    uint32_t columns = (x + tileSize <= width) ? tileSize : width - x;
+    uint32_t crc = CRC32C_INITIAL;
+
+    uint32_t y = tileY * tileSize;
+    for ( ; (y < (tileY + 1) * tileSize) && (y < height) ; ++y)
+    {
+        crc = crcBitwise(crc,
+                         pixels + (y * pitch) + (x * bytesPerPixel),
+                         columns * bytesPerPixel);
+    }
+
+    return crc;
+}
+
+//-------------------------------------------------------------------------
+// Hash a frame with partial tiles at the right and bottom and padding at
+// the end of each row. Every tile must match the bit at a time CRC; a
+// change to the padding must leave every tile clean, and a change to the
+// last pixel must dirty only the last tile.
+
+static bool
+testFrame(
+    VC_IMAGE_TYPE_T type)
+{
+    const char *name = imageFormatName(type);
+    uint32_t tileSize = FRAME_DIFF_DEFAULT_TILE_SIZE;
+    uint32_t width = (3 * tileSize) + 7;
+    uint32_t height = (2 * tileSize) + 5;
+    uint32_t bytesPerPixel = imageFormatBytesPerPixel(type);
+    uint32_t pitch = imageFormatPitch(type, width) + TEST_PITCH_PADDING;
+
+    uint8_t *pixels = malloc(pitch * height);
+    FRAME_DIFF_T diff;
+
+    if ((pixels == NULL)
+        || (initFrameDiff(&diff, type, width, height, tileSize) == false))
+    {
+        printf("out of memory\n");
+        free(pixels);
+        return false;
+    }
+
+    fillBytes(pixels, pitch * height);
+
+    bool passed = true;
+
+    frameDiffUpdate(&diff, pixels, pitch, NULL);
+
+    uint32_t tileY = 0;
+    for (tileY = 0 ; tileY < diff.tilesDown ; ++tileY)
+    {
+        uint32_t tileX = 0;
+        for (tileX = 0 ; tileX < diff.tilesAcross ; ++tileX)
+        {
+            uint32_t expected = tileCrc(pixels,
+                                        pitch,
+                                        bytesPerPixel,
+                                        width,
+                                        height,
+                                        tileSize,
+                                        tileX,
+                                        tileY);
+            uint32_t actual = diff.hashes[(tileY * diff.tilesAcross)
+                                          + tileX];
+
+            if (expected != actual)
+            {
+                printf("frame %s (%s): FAILED, tile %"PRIu32",%"PRIu32
+                       " hash %08"PRIx32" instead of %08"PRIx32"\n",
+                       name,
+                       frameDiffImplementation(),
+                       tileX,
+                       tileY,
+                       actual,
+                       expected);
+                passed = false;
+            }
+        }
+    }
+
+    uint32_t y = 0;
+    for (y = 0 ; y < height ; ++y)
+    {
+        pixels[(y * pitch) + (width * bytesPerPixel)] ^= 0xFF;
+        pixels[(y * pitch) + pitch - 1] ^= 0xFF;
+    }
+
+    if (frameDiffUpdate(&diff, pixels, pitch, NULL) != 0)
+    {
+        printf("frame %s: FAILED, padding marked %"PRIu32" tiles dirty\n",
+               name,
+               diff.dirtyCount);
+        passed = false;
+    }
+
+    pixels[((height - 1) * pitch) + ((width - 1) * bytesPerPixel)] ^= 0x01;
+
+    if ((frameDiffUpdate(&diff, pixels, pitch, NULL) != 1)
+        || (frameDiffTileDirty(&diff,
+                               diff.tilesAcross - 1,
+                               diff.tilesDown - 1) == false))
+    {
+        printf("frame %s: FAILED, last pixel marked %"PRIu32
+               " tiles dirty\n",
+               name,
+               diff.dirtyCount);
+        passed = false;
+    }
+
+    if (passed)
+    {
+        printf("frame %s (%s): %"PRIu32" tiles match\n",
+               name,
+               frameDiffImplementation(),
+               diff.tileCount);
+    }
+
+    destroyFrameDiff(&diff);
+    free(pixels);
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+runTests(void)
+{
+    size_t size = TEST_ROWS * ((TEST_MAX_TILES + 1) * 64 * 4 + 1);
+    uint8_t *bytes = malloc(size);
+
+    if (bytes == NULL)
+    {
+        printf("out of memory\n");
+        return false;
+    }
+
+    fillBytes(bytes, size);
+
+    uint32_t count = 0;
+    const FRAME_DIFF_KERNEL_T *kernels = frameDiffKernels(&count);
+    const FRAME_DIFF_KERNEL_T *table = &(kernels[count - 1]);
+    bool passed = true;
+
+    uint32_t i = 0;
+    for (i = 0 ; i + 1 < count ; ++i)
+    {
+        if ((kernels[i].available != NULL)
+            && (kernels[i].available() == false))
+        {
+            printf("%s: skipped, not supported by this processor\n",
+                   kernels[i].name);
+            continue;
+        }
+
+        if (testKernel(&(kernels[i]), table, bytes) == false)
+        {
+            passed = false;
+        }
+    }
+
+    free(bytes);
+
+    size_t f = 0;
+    for (f = 0 ; f < COUNT_OF(testTypes) ; ++f)
+    {
+        if (testFrame(testTypes[f]) == false)
+        {
+            passed = false;
+        }
+    }
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+// Hash whole RGBX32 frames in tiles of the default size on one thread.
+
+static bool
+runBenchmark(
+    int frames,
+    uint32_t width,
+    uint32_t height)
+{
+    uint32_t tileSize = FRAME_DIFF_DEFAULT_TILE_SIZE;
+    uint32_t pitch = imageFormatPitch(VC_IMAGE_RGBX32, width);
+    uint32_t tilesAcross = (width + tileSize - 1) / tileSize;
+
+    uint8_t *pixels = malloc((size_t)pitch * height);
+    uint32_t *crcs = malloc(tilesAcross * sizeof(uint32_t));
+
+    if ((pixels == NULL) || (crcs == NULL))
+    {
+        printf("out of memory\n");
+        free(pixels);
+        free(crcs);
+        return false;
+    }
+
+    fillBytes(pixels, (size_t)pitch * height);
+
+    uint32_t count = 0;
+    const FRAME_DIFF_KERNEL_T *kernels = frameDiffKernels(&count);
+
+    uint32_t i = 0;
+    for (i = 0 ; i < count ; ++i)
+    {
+        const FRAME_DIFF_KERNEL_T *kernel = &(kernels[i]);
+
+        if ((kernel->available != NULL) && (kernel->available() == false))
+        {
+            continue;
+        }
+
+        int64_t start = monotonicNanoseconds();
+
+        int frame = 0;
+        for (frame = 0 ; frame < frames ; ++frame)
+        {
+            uint32_t y = 0;
+            for (y = 0 ; y < height ; ++y)
+            {
+                if ((y % tileSize) == 0)
+                {
+                    memset(crcs, 0xFF, tilesAcross * sizeof(uint32_t));
+                }
+
+                kernel->hashRow(crcs,
+                                pixels + (y * pitch),
+                                width / tileSize,
+                                tileSize * 4,
+                                (width % tileSize) * 4);
+            }
+        }
+
+        int64_t elapsed = monotonicNanoseconds() - start;
+        double seconds = (elapsed > 0) ? elapsed / 1e9 : 1e-9;
+        double bytes = (double)width * height * 4 * frames;
+
+        printf("%-12s %"PRIu32"x%"PRIu32" %d frames: %.3f ms/frame,"
+               " %.2f GB/s\n",
+               kernel->name,
+               width,
+               height,
+               frames,
+               (seconds * 1e3) / frames,
+               bytes / seconds / 1e9);
+    }
+
+    free(pixels);
+    free(crcs);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+int
+main(
+    int argc,
+    char *argv[])
+{
+    const char *program = basename(argv[0]);
+
+    int frames = 0;
+    int width = DEFAULT_WIDTH;
+    int height = DEFAULT_HEIGHT;
+
+    //---------------------------------------------------------------------
+
+    static const char *sopts = "b:hH:W:";
+    static struct option lopts[] =
+    {
+        { "benchmark", required_argument, NULL, 'b' },
+        { "height", required_argument, NULL, 'H' },
+        { "help", no_argument, NULL, 'h' },
+        { "width", required_argument, NULL, 'W' },
+        { NULL, no_argument, NULL, 0 }
+    };
+
+    int opt = 0;
+
+    while ((opt = getopt_long(argc, argv, sopts, lopts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+
+            frames = atoi(optarg);
+            break;
+
+        case 'h':
+
+            printUsage(stdout, program);
+            exit(EXIT_SUCCESS);
+
+            break;
+
+        case 'H':
+
+            height = atoi(optarg);
+            break;
+
+        case 'W':
+
+            width = atoi(optarg);
+            break;
+
+        default:
+
+            printUsage(stderr, program);
+            exit(EXIT_FAILURE);
+
+            break;
+        }
+    }
+
+    if ((frames < 0) || (width <= 0) || (height <= 0))
+    {
+        fprintf(stderr, "%s: invalid options\n", program);
+        printUsage(stderr, program);
+        exit(EXIT_FAILURE);
+    }
+
+    //---------------------------------------------------------------------
+
+    printf("tile hashing: %s\n", frameDiffImplementation());
+
+    bool passed = (frames > 0)
+                ? runBenchmark(frames, width, height)
+                : runTests();
+
+    return (passed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
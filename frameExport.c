@@ -0,0 +1,293 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "frameExport.h"
+
+//-------------------------------------------------------------------------
+
+static size_t
+roundUpToPage(
+    size_t size)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    return (size + page - 1) & ~(page - 1);
+}
+
+//-------------------------------------------------------------------------
+// Whether a segment of this name is still being written by a live
+// process, e.g. another raspi2raspi exporting the same pipeline number.
+// A segment that is closed, or whose process has gone, was left behind by
+// a process that did not exit cleanly.
+
+static bool
+frameExportInUse(
+    const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    struct stat st;
+    bool inUse = false;
+
+    if ((fstat(fd, &st) == 0)
+        && (st.st_size >= (off_t)sizeof(FRAME_EXPORT_HEADER_T)))
+    {
+        const FRAME_EXPORT_HEADER_T *header
+            = mmap(NULL, sizeof(*header), PROT_READ, MAP_SHARED, fd, 0);
+
+        if (header != MAP_FAILED)
+        {
+            pid_t pid = header->pid;
+
+            inUse = (header->magic == FRAME_EXPORT_MAGIC)
+                 && (header->closed == 0)
+                 && (pid > 0)
+                 && (pid != getpid())
+                 && ((kill(pid, 0) == 0) || (errno == EPERM));
+
+            munmap((void *)header, sizeof(*header));
+        }
+    }
+
+    close(fd);
+
+    return inUse;
+}
+
+//-------------------------------------------------------------------------
+// Create (or replace) the shared memory segment for a pipeline's frames
+// and map it. Returns false, with errno set, on failure.
+
+bool
+createFrameExport(
+    FRAME_EXPORT_T *frameExport,
+    uint32_t index,
+    uint32_t format,
+    const char *formatName,
+    uint32_t width,
+    uint32_t height,
+    uint32_t bytesPerPixel,
+    uint32_t pitch,
+    uint32_t slotCount)
+{
+    memset(frameExport, 0, sizeof(*frameExport));
+
+    if ((slotCount < 2) || (slotCount > FRAME_EXPORT_MAX_SLOTS))
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    snprintf(frameExport->name,
+             sizeof(frameExport->name),
+             FRAME_EXPORT_NAME_FORMAT,
+             index);
+
+    // Each frame starts on a page of its own, so that a reader can hand it
+    // to the kernel (e.g. vmsplice) or a GPU without copying it.
+
+    size_t headerSize = roundUpToPage(sizeof(FRAME_EXPORT_HEADER_T));
+    size_t slotSize = roundUpToPage((size_t)pitch * height);
+    size_t size = headerSize + (slotCount * slotSize);
+
+    if (frameExportInUse(frameExport->name))
+    {
+        errno = EBUSY;
+        return false;
+    }
+
+    shm_unlink(frameExport->name);
+
+    int fd = shm_open(frameExport->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    if (ftruncate(fd, size) == -1)
+    {
+        int error = errno;
+        close(fd);
+        shm_unlink(frameExport->name);
+        errno = error;
+        return false;
+    }
+
+    FRAME_EXPORT_HEADER_T *header = mmap(NULL,
+                                         size,
+                                         PROT_READ | PROT_WRITE,
+                                         MAP_SHARED,
+                                         fd,
+                                         0);
+
+    int error = errno;
+    close(fd);
+
+    if (header == MAP_FAILED)
+    {
+        shm_unlink(frameExport->name);
+        errno = error;
+        return false;
+    }
+
+    header->version = FRAME_EXPORT_VERSION;
+    header->headerSize = sizeof(FRAME_EXPORT_HEADER_T);
+    header->pid = getpid();
+    header->size = size;
+    header->format = format;
+    snprintf(header->formatName,
+             sizeof(header->formatName),
+             "%s",
+             formatName);
+    header->width = width;
+    header->height = height;
+    header->bytesPerPixel = bytesPerPixel;
+    header->pitch = pitch;
+    header->frameSize = pitch * height;
+    header->slotCount = slotCount;
+
+    uint32_t i = 0;
+    for (i = 0 ; i < slotCount ; ++i)
+    {
+        header->slots[i].offset = headerSize + (i * slotSize);
+    }
+
+    // Readers ignore the segment until the magic number appears, so it is
+    // written last.
+
+    __sync_synchronize();
+    header->magic = FRAME_EXPORT_MAGIC;
+
+    frameExport->header = header;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// The slot to write the next frame (of pitch * height bytes) into before
+// calling frameExportEndWrite.
+
+uint8_t *
+frameExportBeginWrite(
+    FRAME_EXPORT_T *frameExport)
+{
+    FRAME_EXPORT_HEADER_T *header = frameExport->header;
+    uint64_t frame = frameExport->frame + 1;
+
+    FRAME_EXPORT_SLOT_T *slot = &(header->slots[frame % header->slotCount]);
+    volatile uint32_t *sequence = &(slot->sequence);
+
+    *sequence = *sequence + 1;
+    __sync_synchronize();
+
+    return (uint8_t *)header + slot->offset;
+}
+
+//-------------------------------------------------------------------------
+
+void
+frameExportEndWrite(
+    FRAME_EXPORT_T *frameExport,
+    int64_t timestamp)
+{
+    FRAME_EXPORT_HEADER_T *header = frameExport->header;
+    uint64_t frame = frameExport->frame + 1;
+
+    FRAME_EXPORT_SLOT_T *slot = &(header->slots[frame % header->slotCount]);
+    volatile uint32_t *sequence = &(slot->sequence);
+
+    slot->frame = frame;
+    slot->timestamp = timestamp;
+
+    __sync_synchronize();
+    *sequence = *sequence + 1;
+
+    frameExport->frame = frame;
+    __atomic_store_n(&(header->latest), frame, __ATOMIC_RELEASE);
+}
+
+//-------------------------------------------------------------------------
+// Give up on a frame after frameExportBeginWrite. The slot's pixels may
+// already be partly overwritten, so it is marked as holding no frame
+// before its sequence is made even again; readers only take a slot whose
+// frame is the one they asked for, which is never 0.
+
+void
+frameExportCancelWrite(
+    FRAME_EXPORT_T *frameExport)
+{
+    FRAME_EXPORT_HEADER_T *header = frameExport->header;
+    uint64_t frame = frameExport->frame + 1;
+
+    FRAME_EXPORT_SLOT_T *slot = &(header->slots[frame % header->slotCount]);
+    volatile uint32_t *sequence = &(slot->sequence);
+
+    slot->frame = 0;
+
+    __sync_synchronize();
+    *sequence = *sequence + 1;
+}
+
+//-------------------------------------------------------------------------
+// Tell readers that the segment is finished with, and remove it. Readers
+// that still have it mapped keep the memory until they unmap it.
+
+void
+destroyFrameExport(
+    FRAME_EXPORT_T *frameExport)
+{
+    FRAME_EXPORT_HEADER_T *header = frameExport->header;
+
+    if (header == NULL)
+    {
+        return;
+    }
+
+    __atomic_store_n(&(header->closed), 1, __ATOMIC_RELEASE);
+
+    shm_unlink(frameExport->name);
+    munmap(header, header->size);
+
+    frameExport->header = NULL;
+}
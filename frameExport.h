@@ -0,0 +1,133 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef FRAME_EXPORT_H
+#define FRAME_EXPORT_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------------------
+// Captured frames published by raspi2raspi in a POSIX shared memory
+// segment (/dev/shm/raspi2raspi-<pipeline>), so that other processes on
+// the same machine can use them without taking snapshots of their own.
+// The segment is a header followed by a ring of page aligned frame slots.
+// Each slot is protected by a sequence lock, like the statistics segment:
+// its sequence is odd while the frame is being written, and a reader that
+// sees the sequence change while it uses the frame must discard it. latest
+// is the number of the newest complete frame (0 before the first one),
+// which is in slot latest % slotCount; a slot's frame is 0 while it holds
+// no complete frame. When the pipeline is reconfigured or stops, closed
+// is set and the segment is unlinked; readers should then open it again.
+// The version must be changed if the layout changes.
+
+#define FRAME_EXPORT_MAGIC 0x46523252
+#define FRAME_EXPORT_VERSION 1
+#define FRAME_EXPORT_MAX_SLOTS 8
+#define FRAME_EXPORT_DEFAULT_SLOTS 3
+#define FRAME_EXPORT_NAME_FORMAT "/raspi2raspi-%u"
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    uint32_t sequence;
+    uint32_t reserved;
+    uint64_t frame;
+    int64_t timestamp;
+    uint64_t offset;
+} FRAME_EXPORT_SLOT_T;
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    int32_t pid;
+    uint64_t size;
+    uint32_t closed;
+    uint32_t format;
+    char formatName[16];
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerPixel;
+    uint32_t pitch;
+    uint32_t frameSize;
+    uint32_t slotCount;
+    uint64_t latest;
+    FRAME_EXPORT_SLOT_T slots[FRAME_EXPORT_MAX_SLOTS];
+} FRAME_EXPORT_HEADER_T;
+
+//-------------------------------------------------------------------------
+// The writer's side, used by raspi2raspi. Readers use frameExportReader.h.
+
+typedef struct
+{
+    char name[32];
+    FRAME_EXPORT_HEADER_T *header;
+    uint64_t frame;
+} FRAME_EXPORT_T;
+
+//-------------------------------------------------------------------------
+
+bool
+createFrameExport(
+    FRAME_EXPORT_T *frameExport,
+    uint32_t index,
+    uint32_t format,
+    const char *formatName,
+    uint32_t width,
+    uint32_t height,
+    uint32_t bytesPerPixel,
+    uint32_t pitch,
+    uint32_t slotCount);
+
+uint8_t *
+frameExportBeginWrite(
+    FRAME_EXPORT_T *frameExport);
+
+void
+frameExportEndWrite(
+    FRAME_EXPORT_T *frameExport,
+    int64_t timestamp);
+
+void
+frameExportCancelWrite(
+    FRAME_EXPORT_T *frameExport);
+
+void
+destroyFrameExport(
+    FRAME_EXPORT_T *frameExport);
+
+//-------------------------------------------------------------------------
+
+#endif
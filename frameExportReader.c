@@ -0,0 +1,270 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "frameExportReader.h"
+
+//-------------------------------------------------------------------------
+
+#define FRAME_EXPORT_READ_ATTEMPTS 1000
+#define FRAME_EXPORT_POLL_NANOSECONDS 1000000
+
+//-------------------------------------------------------------------------
+// Map the frames exported by a pipeline. Returns false, with errno set, if
+// the pipeline is not exporting frames (ENOENT), or the segment is not
+// (or not yet) a frame export of this version (EINVAL).
+
+bool
+openFrameExportReader(
+    FRAME_EXPORT_READER_T *reader,
+    uint32_t index)
+{
+    memset(reader, 0, sizeof(*reader));
+
+    char name[32];
+    snprintf(name, sizeof(name), FRAME_EXPORT_NAME_FORMAT, index);
+
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    struct stat info;
+
+    if (fstat(fd, &info) == -1)
+    {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+
+    if (info.st_size < (off_t)sizeof(FRAME_EXPORT_HEADER_T))
+    {
+        close(fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    const FRAME_EXPORT_HEADER_T *header = mmap(NULL,
+                                               info.st_size,
+                                               PROT_READ,
+                                               MAP_SHARED,
+                                               fd,
+                                               0);
+
+    int error = errno;
+    close(fd);
+
+    if (header == MAP_FAILED)
+    {
+        errno = error;
+        return false;
+    }
+
+    reader->header = header;
+    reader->size = info.st_size;
+
+    if ((__atomic_load_n(&(header->magic), __ATOMIC_ACQUIRE)
+         != FRAME_EXPORT_MAGIC)
+        || (header->version != FRAME_EXPORT_VERSION)
+        || (header->headerSize != sizeof(FRAME_EXPORT_HEADER_T))
+        || (header->size > reader->size)
+        || (header->slotCount < 2)
+        || (header->slotCount > FRAME_EXPORT_MAX_SLOTS))
+    {
+        closeFrameExportReader(reader);
+        errno = EINVAL;
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+void
+closeFrameExportReader(
+    FRAME_EXPORT_READER_T *reader)
+{
+    if (reader->header != NULL)
+    {
+        munmap((void *)reader->header, reader->size);
+        reader->header = NULL;
+    }
+}
+
+//-------------------------------------------------------------------------
+// True once raspi2raspi has stopped exporting frames to this segment,
+// because the pipeline was reconfigured or has stopped.
+
+bool
+frameExportReaderClosed(
+    const FRAME_EXPORT_READER_T *reader)
+{
+    return __atomic_load_n(&(reader->header->closed), __ATOMIC_ACQUIRE) != 0;
+}
+
+//-------------------------------------------------------------------------
+// Wait for a frame newer than after. Returns false if none arrived within
+// timeout nanoseconds (forever if negative), or the segment was closed.
+
+bool
+frameExportReaderWait(
+    const FRAME_EXPORT_READER_T *reader,
+    uint64_t after,
+    int64_t timeout)
+{
+    const struct timespec poll = { 0, FRAME_EXPORT_POLL_NANOSECONDS };
+    int64_t waited = 0;
+
+    while (__atomic_load_n(&(reader->header->latest), __ATOMIC_ACQUIRE)
+           <= after)
+    {
+        if (frameExportReaderClosed(reader)
+            || ((timeout >= 0) && (waited >= timeout)))
+        {
+            return false;
+        }
+
+        nanosleep(&poll, NULL);
+        waited += FRAME_EXPORT_POLL_NANOSECONDS;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Find the newest complete frame. frame->pixels points into the shared
+// memory; check frameExportReaderValid after using them. Returns false if
+// there is no frame yet, or the writer kept overtaking the reader.
+
+bool
+frameExportReaderLatest(
+    const FRAME_EXPORT_READER_T *reader,
+    FRAME_EXPORT_FRAME_T *frame)
+{
+    const FRAME_EXPORT_HEADER_T *header = reader->header;
+
+    int attempt = 0;
+    for (attempt = 0 ; attempt < FRAME_EXPORT_READ_ATTEMPTS ; ++attempt)
+    {
+        uint64_t latest = __atomic_load_n(&(header->latest),
+                                          __ATOMIC_ACQUIRE);
+
+        if (latest == 0)
+        {
+            return false;
+        }
+
+        uint32_t index = latest % header->slotCount;
+        const FRAME_EXPORT_SLOT_T *slot = &(header->slots[index]);
+        const volatile uint32_t *sequence = &(slot->sequence);
+
+        uint32_t before = *sequence;
+        __sync_synchronize();
+
+        if (((before & 1) == 0) && (slot->frame == latest))
+        {
+            frame->pixels = (const uint8_t *)header + slot->offset;
+            frame->frame = latest;
+            frame->timestamp = slot->timestamp;
+            frame->slot = index;
+            frame->sequence = before;
+
+            __sync_synchronize();
+
+            if (*sequence == before)
+            {
+                return true;
+            }
+        }
+
+        sched_yield();
+    }
+
+    return false;
+}
+
+//-------------------------------------------------------------------------
+// True if the frame was not overwritten while the reader was using it.
+
+bool
+frameExportReaderValid(
+    const FRAME_EXPORT_READER_T *reader,
+    const FRAME_EXPORT_FRAME_T *frame)
+{
+    const volatile uint32_t *sequence
+        = &(reader->header->slots[frame->slot].sequence);
+
+    __sync_synchronize();
+
+    return *sequence == frame->sequence;
+}
+
+//-------------------------------------------------------------------------
+// Take a consistent copy of the newest frame (frameSize bytes) for readers
+// that need to keep it. Returns false as frameExportReaderLatest does.
+
+bool
+frameExportReaderCopy(
+    const FRAME_EXPORT_READER_T *reader,
+    FRAME_EXPORT_FRAME_T *frame,
+    void *buffer)
+{
+    int attempt = 0;
+    for (attempt = 0 ; attempt < FRAME_EXPORT_READ_ATTEMPTS ; ++attempt)
+    {
+        if (frameExportReaderLatest(reader, frame) == false)
+        {
+            return false;
+        }
+
+        memcpy(buffer, frame->pixels, reader->header->frameSize);
+
+        if (frameExportReaderValid(reader, frame))
+        {
+            frame->pixels = buffer;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,125 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef FRAME_EXPORT_READER_H
+#define FRAME_EXPORT_READER_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frameExport.h"
+
+//-------------------------------------------------------------------------
+// Reads the frames raspi2raspi publishes with --export, without copying
+// them and without blocking raspi2raspi. Only frameExport.h,
+// frameExportReader.h and frameExportReader.c are needed to use it.
+//
+//     FRAME_EXPORT_READER_T reader;
+//     FRAME_EXPORT_FRAME_T frame;
+//     uint64_t last = 0;
+//
+//     openFrameExportReader(&reader, 0);
+//
+//     while (frameExportReaderWait(&reader, last, timeout))
+//     {
+//         if (frameExportReaderLatest(&reader, &frame))
+//         {
+//             last = frame.frame;
+//
+//             ... use frame.pixels ...
+//
+//             if (frameExportReaderValid(&reader, &frame) == false)
+//             {
+//                 ... frame was overwritten while in use, discard ...
+//             }
+//         }
+//     }
+//
+// A frame stays valid until raspi2raspi has written slotCount - 1 more
+// frames. When frameExportReaderClosed returns true, close the reader and
+// open it again to follow the pipeline's new geometry.
+
+typedef struct
+{
+    const FRAME_EXPORT_HEADER_T *header;
+    size_t size;
+} FRAME_EXPORT_READER_T;
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    const uint8_t *pixels;
+    uint64_t frame;
+    int64_t timestamp;
+    uint32_t slot;
+    uint32_t sequence;
+} FRAME_EXPORT_FRAME_T;
+
+//-------------------------------------------------------------------------
+
+bool
+openFrameExportReader(
+    FRAME_EXPORT_READER_T *reader,
+    uint32_t index);
+
+void
+closeFrameExportReader(
+    FRAME_EXPORT_READER_T *reader);
+
+bool
+frameExportReaderClosed(
+    const FRAME_EXPORT_READER_T *reader);
+
+bool
+frameExportReaderWait(
+    const FRAME_EXPORT_READER_T *reader,
+    uint64_t after,
+    int64_t timeout);
+
+bool
+frameExportReaderLatest(
+    const FRAME_EXPORT_READER_T *reader,
+    FRAME_EXPORT_FRAME_T *frame);
+
+bool
+frameExportReaderValid(
+    const FRAME_EXPORT_READER_T *reader,
+    const FRAME_EXPORT_FRAME_T *frame);
+
+bool
+frameExportReaderCopy(
+    const FRAME_EXPORT_READER_T *reader,
+    FRAME_EXPORT_FRAME_T *frame,
+    void *buffer);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,691 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "frameExport.h"
+#include "frameExportReader.h"
+#include "frameScheduler.h"
+
+//-------------------------------------------------------------------------
+// Checks the frame export's sequence locks. The first tests write frames
+// in this process: the slots must wrap around with the expected frame
+// numbers and sequences, a cancelled frame must never be readable, and a
+// reader racing a writer (which cancels some frames part way through)
+// must only ever get whole frames. With --raspi2raspi, the program is
+// then run exporting frames from the software backend, and a reader
+// checks the frame numbers and the backend's pattern in every frame it
+// reads, and that the segment is closed when raspi2raspi exits.
+
+#define DEFAULT_FRAMES 20000
+#define DEFAULT_PIPELINE_FRAMES 60
+
+// A pipeline number that raspi2raspi does not use, for the tests that
+// write frames in this process.
+
+#define TEST_INDEX 99
+#define TEST_SLOTS 3
+#define TEST_WIDTH 64
+#define TEST_HEIGHT 16
+#define TEST_BYTES_PER_PIXEL 4
+#define TEST_PITCH (TEST_WIDTH * TEST_BYTES_PER_PIXEL)
+#define TEST_FRAME_SIZE (TEST_PITCH * TEST_HEIGHT)
+#define TEST_CANCEL_EVERY 5
+
+#define PIPELINE_OPEN_TIMEOUT_NANOSECONDS (5 * NANOSECONDS_PER_SECOND)
+#define PIPELINE_FRAME_TIMEOUT_NANOSECONDS (2 * NANOSECONDS_PER_SECOND)
+
+//-------------------------------------------------------------------------
+
+void
+printUsage(
+    FILE *fp,
+    const char *name)
+{
+    fprintf(fp, "\n");
+    fprintf(fp, "Usage: %s <options>\n", name);
+    fprintf(fp, "\n");
+    fprintf(fp, "    --frames <number> - frames written while a reader");
+    fprintf(fp, " races the writer (default %d)\n", DEFAULT_FRAMES);
+    fprintf(fp, "    --raspi2raspi <path> - also read the frames this");
+    fprintf(fp, " program exports from the software backend\n");
+    fprintf(fp, "    --help - print usage and exit\n");
+    fprintf(fp, "\n");
+}
+
+//-------------------------------------------------------------------------
+// Every word of a test frame holds its frame number.
+
+static void
+fillFrame(
+    uint8_t *pixels,
+    uint64_t frame)
+{
+    size_t i = 0;
+    for (i = 0 ; i < TEST_FRAME_SIZE ; i += sizeof(frame))
+    {
+        memcpy(pixels + i, &frame, sizeof(frame));
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+frameIsWhole(
+    const uint8_t *pixels,
+    uint64_t frame)
+{
+    size_t i = 0;
+    for (i = 0 ; i < TEST_FRAME_SIZE ; i += sizeof(frame))
+    {
+        uint64_t value;
+        memcpy(&value, pixels + i, sizeof(value));
+
+        if (value != frame)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+createTestExport(
+    FRAME_EXPORT_T *frameExport)
+{
+    if (createFrameExport(frameExport,
+                          TEST_INDEX,
+                          0,
+                          "test",
+                          TEST_WIDTH,
+                          TEST_HEIGHT,
+                          TEST_BYTES_PER_PIXEL,
+                          TEST_PITCH,
+                          TEST_SLOTS) == false)
+    {
+        printf("creating frame export failed: %s\n", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Write frames one at a time, checking the slots after each, then cancel
+// one part way through.
+
+static bool
+testSlots(void)
+{
+    FRAME_EXPORT_T frameExport;
+    FRAME_EXPORT_READER_T reader;
+    FRAME_EXPORT_FRAME_T frame;
+
+    if (createTestExport(&frameExport) == false)
+    {
+        return false;
+    }
+
+    if (openFrameExportReader(&reader, TEST_INDEX) == false)
+    {
+        printf("slots: FAILED, opening reader: %s\n", strerror(errno));
+        destroyFrameExport(&frameExport);
+        return false;
+    }
+
+    const FRAME_EXPORT_HEADER_T *header = reader.header;
+    uint32_t writes[TEST_SLOTS] = { 0 };
+    bool passed = true;
+
+    if (frameExportReaderLatest(&reader, &frame))
+    {
+        printf("slots: FAILED, a frame before any was written\n");
+        passed = false;
+    }
+
+    uint64_t n = 0;
+    for (n = 1 ; n <= (4 * TEST_SLOTS) + 1 ; ++n)
+    {
+        uint32_t index = n % TEST_SLOTS;
+
+        fillFrame(frameExportBeginWrite(&frameExport), n);
+
+        if ((header->slots[index].sequence & 1) == 0)
+        {
+            printf("slots: FAILED, slot %"PRIu32" not odd while writing\n",
+                   index);
+            passed = false;
+        }
+
+        frameExportEndWrite(&frameExport, (int64_t)n * 1000);
+        ++writes[index];
+
+        if ((header->latest != n)
+            || (header->slots[index].frame != n)
+            || (header->slots[index].sequence != 2 * writes[index]))
+        {
+            printf("slots: FAILED, frame %"PRIu64" in slot %"PRIu32
+                   " has frame %"PRIu64" sequence %"PRIu32", latest %"
+                   PRIu64"\n",
+                   n,
+                   index,
+                   header->slots[index].frame,
+                   header->slots[index].sequence,
+                   header->latest);
+            passed = false;
+        }
+
+        uint8_t copy[TEST_FRAME_SIZE];
+
+        if ((frameExportReaderCopy(&reader, &frame, copy) == false)
+            || (frame.frame != n)
+            || (frame.timestamp != (int64_t)n * 1000)
+            || (frameIsWhole(copy, n) == false))
+        {
+            printf("slots: FAILED, reading frame %"PRIu64"\n", n);
+            passed = false;
+        }
+    }
+
+    //---------------------------------------------------------------------
+
+    uint64_t latest = n - 1;
+    uint32_t index = n % TEST_SLOTS;
+
+    memset(frameExportBeginWrite(&frameExport), 0xFF, TEST_FRAME_SIZE / 2);
+    frameExportCancelWrite(&frameExport);
+    writes[index] += 1;
+
+    if ((header->slots[index].frame != 0)
+        || (header->slots[index].sequence != 2 * writes[index])
+        || (header->latest != latest))
+    {
+        printf("slots: FAILED, cancelled slot %"PRIu32" has frame %"PRIu64
+               " sequence %"PRIu32", latest %"PRIu64"\n",
+               index,
+               header->slots[index].frame,
+               header->slots[index].sequence,
+               header->latest);
+        passed = false;
+    }
+
+    if ((frameExportReaderLatest(&reader, &frame) == false)
+        || (frame.frame != latest))
+    {
+        printf("slots: FAILED, latest frame lost by a cancel\n");
+        passed = false;
+    }
+
+    // the cancelled frame's number is used by the next frame
+
+    fillFrame(frameExportBeginWrite(&frameExport), n);
+    frameExportEndWrite(&frameExport, 0);
+
+    if ((header->latest != n) || (header->slots[index].frame != n))
+    {
+        printf("slots: FAILED, frame after a cancel\n");
+        passed = false;
+    }
+
+    destroyFrameExport(&frameExport);
+
+    if (frameExportReaderClosed(&reader) == false)
+    {
+        printf("slots: FAILED, not closed when destroyed\n");
+        passed = false;
+    }
+
+    closeFrameExportReader(&reader);
+
+    if (passed)
+    {
+        printf("slots: %"PRIu64" frames and a cancel in %d slots\n",
+               n,
+               TEST_SLOTS);
+    }
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    FRAME_EXPORT_T *frameExport;
+    uint64_t frames;
+    uint64_t cancelled;
+} WRITER_T;
+
+//-------------------------------------------------------------------------
+
+static void *
+writerThread(
+    void *arg)
+{
+    WRITER_T *writer = arg;
+
+    uint64_t n = 0;
+    for (n = 1 ; n <= writer->frames ; ++n)
+    {
+        if ((n % TEST_CANCEL_EVERY) == 0)
+        {
+            // scribble over half of a slot whose old frame readers may
+            // still be asking for
+
+            uint8_t *pixels = frameExportBeginWrite(writer->frameExport);
+            memset(pixels, 0xFF, TEST_FRAME_SIZE / 2);
+            frameExportCancelWrite(writer->frameExport);
+            ++(writer->cancelled);
+        }
+
+        fillFrame(frameExportBeginWrite(writer->frameExport), n);
+        frameExportEndWrite(writer->frameExport, (int64_t)n);
+    }
+
+    return NULL;
+}
+
+//-------------------------------------------------------------------------
+// A reader copying frames as fast as it can while a writer overtakes it.
+
+static bool
+testRace(
+    uint64_t frames)
+{
+    FRAME_EXPORT_T frameExport;
+    FRAME_EXPORT_READER_T reader;
+
+    if (createTestExport(&frameExport) == false)
+    {
+        return false;
+    }
+
+    if (openFrameExportReader(&reader, TEST_INDEX) == false)
+    {
+        printf("race: FAILED, opening reader: %s\n", strerror(errno));
+        destroyFrameExport(&frameExport);
+        return false;
+    }
+
+    WRITER_T writer = { &frameExport, frames, 0 };
+    pthread_t thread;
+
+    if (pthread_create(&thread, NULL, writerThread, &writer) != 0)
+    {
+        printf("race: FAILED, starting writer\n");
+        closeFrameExportReader(&reader);
+        destroyFrameExport(&frameExport);
+        return false;
+    }
+
+    uint64_t copies = 0;
+    uint64_t torn = 0;
+    uint64_t backwards = 0;
+    uint64_t last = 0;
+
+    while (last < frames)
+    {
+        FRAME_EXPORT_FRAME_T frame;
+        uint8_t copy[TEST_FRAME_SIZE];
+
+        if (frameExportReaderCopy(&reader, &frame, copy) == false)
+        {
+            continue;
+        }
+
+        ++copies;
+
+        if ((frameIsWhole(copy, frame.frame) == false)
+            || (frame.timestamp != (int64_t)frame.frame))
+        {
+            ++torn;
+        }
+
+        if (frame.frame < last)
+        {
+            ++backwards;
+        }
+
+        last = frame.frame;
+    }
+
+    pthread_join(thread, NULL);
+
+    closeFrameExportReader(&reader);
+    destroyFrameExport(&frameExport);
+
+    printf("race: %"PRIu64" frames (%"PRIu64" cancelled), %"PRIu64
+           " copies, %"PRIu64" torn, %"PRIu64" out of order\n",
+           frames,
+           writer.cancelled,
+           copies,
+           torn,
+           backwards);
+
+    if ((torn > 0) || (backwards > 0))
+    {
+        printf("race: FAILED\n");
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// The software backend fills row y of snapshot s with ((s * 31) + y) &
+// 0xFF, and every captured frame is exported, so frame n is snapshot
+// n - 1.
+
+static bool
+checkPipelineFrame(
+    const FRAME_EXPORT_HEADER_T *header,
+    const uint8_t *pixels,
+    uint64_t frame)
+{
+    uint32_t rowBytes = header->width * header->bytesPerPixel;
+
+    uint32_t y = 0;
+    for (y = 0 ; y < header->height ; ++y)
+    {
+        const uint8_t *row = pixels + (y * header->pitch);
+        uint8_t expected = (((frame - 1) * 31) + y) & 0xFF;
+
+        uint32_t x = 0;
+        for (x = 0 ; x < rowBytes ; ++x)
+        {
+            if (row[x] != expected)
+            {
+                printf("pipeline: FAILED, frame %"PRIu64" row %"PRIu32
+                       " byte %"PRIu32" is %d instead of %d\n",
+                       frame,
+                       y,
+                       x,
+                       row[x],
+                       expected);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+readPipelineFrames(
+    FRAME_EXPORT_READER_T *reader,
+    int frames)
+{
+    const FRAME_EXPORT_HEADER_T *header = reader->header;
+    uint8_t *copy = malloc(header->frameSize);
+
+    if (copy == NULL)
+    {
+        printf("out of memory\n");
+        return false;
+    }
+
+    uint64_t last = 0;
+    uint64_t first = 0;
+    bool passed = true;
+
+    int count = 0;
+    while (passed && (count < frames))
+    {
+        FRAME_EXPORT_FRAME_T frame;
+
+        if (frameExportReaderWait(reader,
+                                  last,
+                                  PIPELINE_FRAME_TIMEOUT_NANOSECONDS)
+            == false)
+        {
+            printf("pipeline: FAILED, no frame after %"PRIu64"\n", last);
+            passed = false;
+        }
+        else if (frameExportReaderCopy(reader, &frame, copy))
+        {
+            if (frame.frame <= last)
+            {
+                printf("pipeline: FAILED, frame %"PRIu64" after %"PRIu64
+                       "\n",
+                       frame.frame,
+                       last);
+                passed = false;
+            }
+            else if (checkPipelineFrame(header, copy, frame.frame) == false)
+            {
+                passed = false;
+            }
+
+            first = (first == 0) ? frame.frame : first;
+            last = frame.frame;
+            ++count;
+        }
+    }
+
+    if (passed)
+    {
+        printf("pipeline: %d frames of %"PRIu32"x%"PRIu32" %s read,"
+               " frames %"PRIu64" to %"PRIu64" in %"PRIu32" slots\n",
+               count,
+               header->width,
+               header->height,
+               header->formatName,
+               first,
+               last,
+               header->slotCount);
+    }
+
+    free(copy);
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+// Run raspi2raspi exporting pipeline 0 from the software backend, read
+// frames from it, then stop it.
+
+static bool
+testPipeline(
+    const char *path,
+    int frames)
+{
+    pid_t pid = fork();
+
+    if (pid == -1)
+    {
+        printf("pipeline: FAILED, fork: %s\n", strerror(errno));
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        execl(path,
+              path,
+              "--backend",
+              "software",
+              "--fps",
+              "60",
+              "--export",
+              "--export-slots",
+              "3",
+              (char *)NULL);
+
+        fprintf(stderr, "running %s failed: %s\n", path, strerror(errno));
+        _exit(EXIT_FAILURE);
+    }
+
+    //---------------------------------------------------------------------
+
+    FRAME_EXPORT_READER_T reader;
+    int64_t deadline = monotonicNanoseconds()
+                     + PIPELINE_OPEN_TIMEOUT_NANOSECONDS;
+    bool opened = false;
+
+    while ((opened == false) && (monotonicNanoseconds() < deadline))
+    {
+        opened = openFrameExportReader(&reader, 0);
+
+        if (opened == false)
+        {
+            monotonicSleepUntil(monotonicNanoseconds()
+                                + (10 * NANOSECONDS_PER_MILLISECOND));
+        }
+    }
+
+    bool passed = opened;
+
+    if (opened == false)
+    {
+        printf("pipeline: FAILED, no frame export appeared\n");
+    }
+    else
+    {
+        passed = readPipelineFrames(&reader, frames);
+    }
+
+    kill(pid, SIGTERM);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    if ((WIFEXITED(status) == false) || (WEXITSTATUS(status) != 0))
+    {
+        printf("pipeline: FAILED, raspi2raspi exit status %d\n", status);
+        passed = false;
+    }
+
+    if (opened)
+    {
+        if (frameExportReaderClosed(&reader) == false)
+        {
+            printf("pipeline: FAILED, not closed when raspi2raspi exited\n");
+            passed = false;
+        }
+
+        closeFrameExportReader(&reader);
+    }
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+
+int
+main(
+    int argc,
+    char *argv[])
+{
+    const char *program = basename(argv[0]);
+    const char *raspi2raspi = NULL;
+
+    int frames = DEFAULT_FRAMES;
+
+    //---------------------------------------------------------------------
+
+    static const char *sopts = "f:hr:";
+    static struct option lopts[] =
+    {
+        { "frames", required_argument, NULL, 'f' },
+        { "help", no_argument, NULL, 'h' },
+        { "raspi2raspi", required_argument, NULL, 'r' },
+        { NULL, no_argument, NULL, 0 }
+    };
+
+    int opt = 0;
+
+    while ((opt = getopt_long(argc, argv, sopts, lopts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+
+            frames = atoi(optarg);
+            break;
+
+        case 'h':
+
+            printUsage(stdout, program);
+            exit(EXIT_SUCCESS);
+
+            break;
+
+        case 'r':
+
+            raspi2raspi = optarg;
+            break;
+
+        default:
+
+            printUsage(stderr, program);
+            exit(EXIT_FAILURE);
+
+            break;
+        }
+    }
+
+    if (frames < 1)
+    {
+        fprintf(stderr, "%s: invalid options\n", program);
+        printUsage(stderr, program);
+        exit(EXIT_FAILURE);
+    }
+
+    //---------------------------------------------------------------------
+
+    bool passed = testSlots();
+
+    if (testRace(frames) == false)
+    {
+        passed = false;
+    }
+
+    if ((raspi2raspi != NULL)
+        && (testPipeline(raspi2raspi, DEFAULT_PIPELINE_FRAMES) == false))
+    {
+        passed = false;
+    }
+
+    return (passed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
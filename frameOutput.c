@@ -0,0 +1,223 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "frameOutput.h"
+#include "frameScheduler.h"
+
+//-------------------------------------------------------------------------
+
+#define FRAME_OUTPUT_DRAIN_POLL_NANOSECONDS NANOSECONDS_PER_MILLISECOND
+
+//-------------------------------------------------------------------------
+
+static void *
+frameOutputThread(
+    void *arg)
+{
+    FRAME_OUTPUT_T *output = arg;
+    volatile uint32_t *sequence = &(output->sequence);
+    const uint8_t *frame = NULL;
+
+    while ((frame = frameRingPop(&(output->ring))) != NULL)
+    {
+        int64_t start = monotonicNanoseconds();
+        size_t bytes = output->write(output->context, frame);
+        int64_t end = monotonicNanoseconds();
+
+        *sequence = *sequence + 1;
+        __sync_synchronize();
+
+        ++(output->stats.frames);
+        output->stats.bytes += bytes;
+        latencyHistogramAdd(&(output->stats.writeLatency), end - start);
+
+        __sync_synchronize();
+        *sequence = *sequence + 1;
+
+        __atomic_add_fetch(&(output->written), 1, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+initFrameOutput(
+    FRAME_OUTPUT_T *output,
+    const char *name,
+    uint32_t capacity,
+    uint32_t held,
+    FRAME_RING_POLICY_T policy,
+    size_t frameSize,
+    FRAME_OUTPUT_WRITE_T write,
+    void *context)
+{
+    memset(output, 0, sizeof(*output));
+
+    output->name = name;
+    output->write = write;
+    output->context = context;
+
+    initLatencyHistogram(&(output->stats.writeLatency));
+
+    if (initFrameRing(&(output->ring),
+                      capacity,
+                      held,
+                      frameSize,
+                      policy) == false)
+    {
+        return false;
+    }
+
+    if (pthread_create(&(output->thread),
+                       NULL,
+                       frameOutputThread,
+                       output) != 0)
+    {
+        destroyFrameRing(&(output->ring));
+        return false;
+    }
+
+    output->running = true;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// The buffer to fill with the next frame (of the frameSize given to
+// initFrameOutput) before calling frameOutputSubmit.
+
+uint8_t *
+frameOutputBuffer(
+    FRAME_OUTPUT_T *output)
+{
+    return frameRingWriteBuffer(&(output->ring));
+}
+
+//-------------------------------------------------------------------------
+
+bool
+frameOutputSubmit(
+    FRAME_OUTPUT_T *output)
+{
+    return frameRingPush(&(output->ring));
+}
+
+//-------------------------------------------------------------------------
+// Copy the output's statistics, retrying if its thread updates them
+// during the copy.
+
+void
+frameOutputStats(
+    const FRAME_OUTPUT_T *output,
+    FRAME_OUTPUT_STATS_T *stats)
+{
+    const volatile uint32_t *sequence = &(output->sequence);
+
+    while (true)
+    {
+        uint32_t before = *sequence;
+        __sync_synchronize();
+
+        if ((before & 1) == 0)
+        {
+            memcpy(stats, &(output->stats), sizeof(*stats));
+            __sync_synchronize();
+
+            if (*sequence == before)
+            {
+                return;
+            }
+        }
+
+        sched_yield();
+    }
+}
+
+//-------------------------------------------------------------------------
+// Wait until every frame submitted so far has been written (or dropped),
+// so that the producer can change state the output's thread uses while
+// it is idle. Only called by the producer, which is then not submitting
+// frames, so the number of frames still to be written can only fall.
+
+void
+frameOutputDrain(
+    FRAME_OUTPUT_T *output)
+{
+    if (output->running == false)
+    {
+        return;
+    }
+
+    FRAME_RING_STATS_T ring;
+    frameRingStats(&(output->ring), &ring);
+
+    uint64_t queued = ring.pushed - ring.dropped;
+
+    while (__atomic_load_n(&(output->written), __ATOMIC_ACQUIRE) < queued)
+    {
+        monotonicSleepUntil(monotonicNanoseconds()
+                            + FRAME_OUTPUT_DRAIN_POLL_NANOSECONDS);
+    }
+}
+
+//-------------------------------------------------------------------------
+// Wait for the frames already queued to be written, then stop the
+// output's thread.
+
+void
+stopFrameOutput(
+    FRAME_OUTPUT_T *output)
+{
+    if (output->running == false)
+    {
+        return;
+    }
+
+    frameRingClose(&(output->ring));
+    pthread_join(output->thread, NULL);
+
+    output->running = false;
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyFrameOutput(
+    FRAME_OUTPUT_T *output)
+{
+    stopFrameOutput(output);
+    destroyFrameRing(&(output->ring));
+}
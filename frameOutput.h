@@ -0,0 +1,118 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef FRAME_OUTPUT_H
+#define FRAME_OUTPUT_H
+
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frameRing.h"
+#include "latencyHistogram.h"
+
+//-------------------------------------------------------------------------
+// A sink for captured frames that runs on its own thread, fed through a
+// frame ring, so that a slow sink lags (and drops frames, or holds up the
+// capture if it must not miss any) without adding its latency to every
+// capture. write is called on the output's thread for each frame, in the
+// order they were captured, and returns the number of bytes it wrote.
+// A frame is left untouched until held more frames have been written
+// after it (see frameRing.h).
+//
+// The output keeps its own statistics, written only by its thread. They
+// are protected by a sequence lock, so frameOutputStats can copy them from
+// any thread without waiting for a write to finish.
+
+typedef size_t (*FRAME_OUTPUT_WRITE_T)(
+    void *context,
+    const uint8_t *frame);
+
+typedef struct
+{
+    uint64_t frames;
+    uint64_t bytes;
+    LATENCY_HISTOGRAM_T writeLatency;
+} FRAME_OUTPUT_STATS_T;
+
+typedef struct
+{
+    const char *name;
+    FRAME_RING_T ring;
+    FRAME_OUTPUT_WRITE_T write;
+    void *context;
+    pthread_t thread;
+    bool running;
+    uint32_t sequence;
+    FRAME_OUTPUT_STATS_T stats;
+    uint64_t written;
+} FRAME_OUTPUT_T;
+
+//-------------------------------------------------------------------------
+
+bool
+initFrameOutput(
+    FRAME_OUTPUT_T *output,
+    const char *name,
+    uint32_t capacity,
+    uint32_t held,
+    FRAME_RING_POLICY_T policy,
+    size_t frameSize,
+    FRAME_OUTPUT_WRITE_T write,
+    void *context);
+
+uint8_t *
+frameOutputBuffer(
+    FRAME_OUTPUT_T *output);
+
+bool
+frameOutputSubmit(
+    FRAME_OUTPUT_T *output);
+
+void
+frameOutputStats(
+    const FRAME_OUTPUT_T *output,
+    FRAME_OUTPUT_STATS_T *stats);
+
+void
+frameOutputDrain(
+    FRAME_OUTPUT_T *output);
+
+void
+stopFrameOutput(
+    FRAME_OUTPUT_T *output);
+
+void
+destroyFrameOutput(
+    FRAME_OUTPUT_T *output);
+
+//-------------------------------------------------------------------------
+
+#endif
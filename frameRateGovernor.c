@@ -0,0 +1,140 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "frameRateGovernor.h"
+
+//-------------------------------------------------------------------------
+
+#define GOVERNOR_HISTORY_FRAMES 32
+
+// Fraction of the distance to the target rate covered on each static frame.
+#define GOVERNOR_DECAY 0.25
+
+// Rate changes smaller than this fraction of the current rate are ignored,
+// so that the scheduler is not rephased for insignificant adjustments.
+#define GOVERNOR_HYSTERESIS 0.1
+
+//-------------------------------------------------------------------------
+
+static uint32_t
+countBits(
+    uint32_t bits)
+{
+    uint32_t count = 0;
+
+    while (bits)
+    {
+        bits &= bits - 1;
+        ++count;
+    }
+
+    return count;
+}
+
+//-------------------------------------------------------------------------
+
+void
+initFrameRateGovernor(
+    FRAME_RATE_GOVERNOR_T *governor,
+    double minFps,
+    double maxFps,
+    int64_t hold)
+{
+    governor->minFps = minFps;
+    governor->maxFps = (maxFps > minFps) ? maxFps : minFps;
+    governor->fps = governor->maxFps;
+    governor->level = governor->maxFps;
+    governor->hold = hold;
+    governor->lastChange = 0;
+    governor->history = 0;
+    governor->historyLength = 0;
+}
+
+//-------------------------------------------------------------------------
+// Record whether the latest frame changed. Returns true if the frame rate
+// should be changed to governor->fps.
+
+bool
+frameRateGovernorUpdate(
+    FRAME_RATE_GOVERNOR_T *governor,
+    bool changed,
+    int64_t now)
+{
+    governor->history = (governor->history << 1) | (changed ? 1 : 0);
+
+    if (governor->historyLength < GOVERNOR_HISTORY_FRAMES)
+    {
+        ++(governor->historyLength);
+    }
+
+    if (changed)
+    {
+        governor->lastChange = now;
+        governor->level = governor->maxFps;
+
+        if (governor->fps != governor->maxFps)
+        {
+            governor->fps = governor->maxFps;
+            return true;
+        }
+
+        return false;
+    }
+
+    if (((now - governor->lastChange) < governor->hold)
+        || (governor->fps == governor->minFps))
+    {
+        return false;
+    }
+
+    //---------------------------------------------------------------------
+
+    double ratio = (double)countBits(governor->history)
+                 / governor->historyLength;
+    double target = governor->minFps
+                  + (ratio * (governor->maxFps - governor->minFps));
+
+    governor->level -= (governor->level - target) * GOVERNOR_DECAY;
+
+    if ((governor->level - governor->minFps)
+        < (governor->minFps * GOVERNOR_HYSTERESIS))
+    {
+        governor->level = governor->minFps;
+    }
+    else if ((governor->fps - governor->level)
+             < (governor->fps * GOVERNOR_HYSTERESIS))
+    {
+        return false;
+    }
+
+    governor->fps = governor->level;
+
+    return true;
+}
@@ -0,0 +1,74 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef FRAME_RATE_GOVERNOR_H
+#define FRAME_RATE_GOVERNOR_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------------------
+// Chooses a frame rate between minFps and maxFps from how often recent
+// frames have changed. Any change sends the rate straight to maxFps. Once
+// the content has been static for the hold time, the rate decays towards
+// a target proportional to the fraction of changed frames in the recent
+// history, and so eventually to minFps. fps is the rate in use, level is
+// the decaying rate it follows once they differ by more than the
+// hysteresis.
+
+typedef struct
+{
+    double minFps;
+    double maxFps;
+    double fps;
+    double level;
+    int64_t hold;
+    int64_t lastChange;
+    uint32_t history;
+    uint32_t historyLength;
+} FRAME_RATE_GOVERNOR_T;
+
+//-------------------------------------------------------------------------
+
+void
+initFrameRateGovernor(
+    FRAME_RATE_GOVERNOR_T *governor,
+    double minFps,
+    double maxFps,
+    int64_t hold);
+
+bool
+frameRateGovernorUpdate(
+    FRAME_RATE_GOVERNOR_T *governor,
+    bool changed,
+    int64_t now);
+
+//-------------------------------------------------------------------------
+
+#endif
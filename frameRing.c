@@ -0,0 +1,426 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "frameRing.h"
+
+//-------------------------------------------------------------------------
+
+static const char *frameRingPolicyNames[] =
+{
+    "drop-oldest",
+    "block"
+};
+
+#define FRAME_RING_POLICY_COUNT \
+    (sizeof(frameRingPolicyNames) / sizeof(frameRingPolicyNames[0]))
+
+//-------------------------------------------------------------------------
+
+static void
+notifyFrameRing(
+    FRAME_RING_T *ring)
+{
+    pthread_mutex_lock(&(ring->mutex));
+    pthread_cond_broadcast(&(ring->cond));
+    pthread_mutex_unlock(&(ring->mutex));
+}
+
+//-------------------------------------------------------------------------
+
+static uint32_t
+frameRingFreeSize(
+    const FRAME_RING_T *ring)
+{
+    return ring->capacity + ring->held + 2;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+initFrameRing(
+    FRAME_RING_T *ring,
+    uint32_t capacity,
+    uint32_t held,
+    size_t frameSize,
+    FRAME_RING_POLICY_T policy)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    if ((capacity < 1) || (capacity > FRAME_RING_MAX_CAPACITY))
+    {
+        return false;
+    }
+
+    if (held > FRAME_RING_MAX_HELD)
+    {
+        return false;
+    }
+
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+
+    ring->capacity = capacity;
+    ring->held = held;
+    ring->policy = policy;
+    ring->frameSize = (frameSize + pageSize - 1) & ~(pageSize - 1);
+
+    uint32_t buffers = frameRingFreeSize(ring);
+
+    if (posix_memalign((void **)&(ring->memory),
+                       pageSize,
+                       ring->frameSize * buffers) != 0)
+    {
+        ring->memory = NULL;
+        return false;
+    }
+
+    // the producer starts with the first buffer, the rest are free
+
+    ring->writing = ring->memory;
+
+    uint32_t i = 0;
+    for (i = 1 ; i < buffers ; ++i)
+    {
+        ring->free[ring->freeHead++] = ring->memory + (i * ring->frameSize);
+    }
+
+    pthread_mutex_init(&(ring->mutex), NULL);
+    pthread_cond_init(&(ring->cond), NULL);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// The buffer the producer should fill with the next frame.
+
+uint8_t *
+frameRingWriteBuffer(
+    FRAME_RING_T *ring)
+{
+    return ring->writing;
+}
+
+//-------------------------------------------------------------------------
+// Queue the frame in the write buffer. If the queue is full, either the
+// oldest queued frame is dropped or this waits for the consumer to take
+// one. Returns false if the ring has been closed. Only called by the
+// producer.
+
+bool
+frameRingPush(
+    FRAME_RING_T *ring)
+{
+    uint32_t head = ring->head;
+    uint8_t *spare = NULL;
+
+    while (true)
+    {
+        uint32_t tail = __atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE);
+
+        if ((head - tail) < ring->capacity)
+        {
+            break;
+        }
+
+        if (ring->policy == FRAME_RING_DROP_OLDEST)
+        {
+            uint8_t *oldest = __atomic_load_n(
+                                  &(ring->queue[tail % ring->capacity]),
+                                  __ATOMIC_RELAXED);
+
+            // fails if the consumer has just taken the oldest frame, in
+            // which case there is now room
+
+            if (__atomic_compare_exchange_n(&(ring->tail),
+                                            &tail,
+                                            tail + 1,
+                                            false,
+                                            __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE))
+            {
+                spare = oldest;
+                __atomic_add_fetch(&(ring->dropped), 1, __ATOMIC_RELAXED);
+                break;
+            }
+        }
+        else
+        {
+            pthread_mutex_lock(&(ring->mutex));
+
+            while ((ring->closed == false)
+                   && ((head - __atomic_load_n(&(ring->tail),
+                                               __ATOMIC_ACQUIRE))
+                       >= ring->capacity))
+            {
+                pthread_cond_wait(&(ring->cond), &(ring->mutex));
+            }
+
+            bool closed = ring->closed;
+
+            pthread_mutex_unlock(&(ring->mutex));
+
+            if (closed)
+            {
+                return false;
+            }
+        }
+    }
+
+    __atomic_store_n(&(ring->queue[head % ring->capacity]),
+                     ring->writing,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&(ring->head), head + 1, __ATOMIC_RELEASE);
+
+    __atomic_add_fetch(&(ring->pushed), 1, __ATOMIC_RELAXED);
+
+    uint32_t occupancy = frameRingOccupancy(ring);
+
+    if (occupancy > ring->maxOccupancy)
+    {
+        __atomic_store_n(&(ring->maxOccupancy), occupancy, __ATOMIC_RELAXED);
+    }
+
+    notifyFrameRing(ring);
+
+    //---------------------------------------------------------------------
+    // Take the next write buffer: the dropped frame's, or a free one.
+    // There is always a free buffer, as there are two more buffers than
+    // the queue and the consumer's held frames can hold.
+
+    if (spare != NULL)
+    {
+        ring->writing = spare;
+    }
+    else
+    {
+        uint32_t freeTail = ring->freeTail;
+
+        ring->writing = ring->free[freeTail % frameRingFreeSize(ring)];
+        __atomic_store_n(&(ring->freeTail), freeTail + 1, __ATOMIC_RELEASE);
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Wait for the oldest queued frame and take it, giving back the frame
+// taken last time, or if frames are held, the oldest held frame once
+// there are more than held of them. Returns NULL once the ring has been
+// closed and is empty. Only called by the consumer.
+
+uint8_t *
+frameRingPop(
+    FRAME_RING_T *ring)
+{
+    if (ring->reading != NULL)
+    {
+        uint8_t *release = ring->reading;
+
+        if (ring->held > 0)
+        {
+            if (ring->heldCount < ring->held)
+            {
+                ring->heldFrames[ring->heldCount++] = release;
+                release = NULL;
+            }
+            else
+            {
+                release = ring->heldFrames[0];
+
+                memmove(ring->heldFrames,
+                        ring->heldFrames + 1,
+                        (ring->held - 1) * sizeof(ring->heldFrames[0]));
+
+                ring->heldFrames[ring->held - 1] = ring->reading;
+            }
+        }
+
+        if (release != NULL)
+        {
+            uint32_t freeHead = ring->freeHead;
+
+            ring->free[freeHead % frameRingFreeSize(ring)] = release;
+            __atomic_store_n(&(ring->freeHead),
+                             freeHead + 1,
+                             __ATOMIC_RELEASE);
+        }
+
+        ring->reading = NULL;
+    }
+
+    while (true)
+    {
+        uint32_t tail = __atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE);
+        uint32_t head = __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE);
+
+        if (tail == head)
+        {
+            pthread_mutex_lock(&(ring->mutex));
+
+            while ((ring->closed == false)
+                   && (__atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE)
+                       == __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE)))
+            {
+                pthread_cond_wait(&(ring->cond), &(ring->mutex));
+            }
+
+            bool finished = ring->closed
+                         && (frameRingOccupancy(ring) == 0);
+
+            pthread_mutex_unlock(&(ring->mutex));
+
+            if (finished)
+            {
+                return NULL;
+            }
+
+            continue;
+        }
+
+        uint8_t *frame = __atomic_load_n(&(ring->queue[tail % ring->capacity]),
+                                         __ATOMIC_RELAXED);
+
+        // fails if the producer has just dropped this frame
+
+        if (__atomic_compare_exchange_n(&(ring->tail),
+                                        &tail,
+                                        tail + 1,
+                                        false,
+                                        __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE))
+        {
+            ring->reading = frame;
+            __atomic_add_fetch(&(ring->popped), 1, __ATOMIC_RELAXED);
+
+            if (ring->policy == FRAME_RING_BLOCK)
+            {
+                notifyFrameRing(ring);
+            }
+
+            return frame;
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+uint32_t
+frameRingOccupancy(
+    FRAME_RING_T *ring)
+{
+    uint32_t tail = __atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE);
+    uint32_t head = __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE);
+
+    return head - tail;
+}
+
+//-------------------------------------------------------------------------
+// Copy the counters, from any thread.
+
+void
+frameRingStats(
+    FRAME_RING_T *ring,
+    FRAME_RING_STATS_T *stats)
+{
+    stats->pushed = __atomic_load_n(&(ring->pushed), __ATOMIC_RELAXED);
+    stats->popped = __atomic_load_n(&(ring->popped), __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&(ring->dropped), __ATOMIC_RELAXED);
+    stats->occupancy = frameRingOccupancy(ring);
+    stats->maxOccupancy = __atomic_load_n(&(ring->maxOccupancy),
+                                          __ATOMIC_RELAXED);
+}
+
+//-------------------------------------------------------------------------
+// Stop the producer from queuing more frames. The consumer still gets the
+// frames already queued.
+
+void
+frameRingClose(
+    FRAME_RING_T *ring)
+{
+    pthread_mutex_lock(&(ring->mutex));
+    ring->closed = true;
+    pthread_cond_broadcast(&(ring->cond));
+    pthread_mutex_unlock(&(ring->mutex));
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyFrameRing(
+    FRAME_RING_T *ring)
+{
+    if (ring->memory == NULL)
+    {
+        return;
+    }
+
+    free(ring->memory);
+    ring->memory = NULL;
+
+    pthread_mutex_destroy(&(ring->mutex));
+    pthread_cond_destroy(&(ring->cond));
+}
+
+//-------------------------------------------------------------------------
+
+bool
+frameRingPolicyFromName(
+    const char *name,
+    FRAME_RING_POLICY_T *policy)
+{
+    size_t i = 0;
+    for (i = 0 ; i < FRAME_RING_POLICY_COUNT ; ++i)
+    {
+        if (strcasecmp(frameRingPolicyNames[i], name) == 0)
+        {
+            *policy = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//-------------------------------------------------------------------------
+
+const char *
+frameRingPolicyName(
+    FRAME_RING_POLICY_T policy)
+{
+    return (policy < FRAME_RING_POLICY_COUNT)
+         ? frameRingPolicyNames[policy]
+         : "unknown";
+}
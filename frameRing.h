@@ -0,0 +1,160 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------------------
+
+#define FRAME_RING_MAX_CAPACITY 16
+#define FRAME_RING_MAX_HELD 16
+
+//-------------------------------------------------------------------------
+// What the producer does when the ring is full.
+
+typedef enum
+{
+    FRAME_RING_DROP_OLDEST,
+    FRAME_RING_BLOCK
+} FRAME_RING_POLICY_T;
+
+//-------------------------------------------------------------------------
+// A fixed size queue of frames from one producer (a capture thread) to
+// one consumer (an output thread). The frame buffers are allocated up
+// front: capacity queued frames, plus one being filled by the producer
+// and one being read by the consumer. The queue holds pointers to them;
+// the producer publishes a frame by advancing head, and the consumer
+// takes one by advancing tail with a compare and swap, which is also how
+// the producer drops the oldest frame when the queue is full, so that
+// only one of them can get it. Consumed buffers go back to the producer
+// through a second queue. head, tail and the free queue indices are only
+// accessed with acquire/release atomics; the mutex is only used to sleep
+// when the queue is empty (or full, if the producer blocks). The counters
+// are updated with atomics too, so that any thread can read them with
+// frameRingStats.
+//
+// The consumer can also hold on to the last few frames it has taken, for
+// a sink that hands the frame's pages to the kernel rather than copying
+// them (vmsplice): a taken buffer only goes back to the producer once
+// held more frames have been taken after it. The frame buffers are page
+// aligned for the same reason.
+
+typedef struct
+{
+    uint32_t capacity;
+    uint32_t held;
+    FRAME_RING_POLICY_T policy;
+    size_t frameSize;
+    uint8_t *memory;
+    uint8_t *queue[FRAME_RING_MAX_CAPACITY];
+    uint32_t head;
+    uint32_t tail;
+    uint8_t *free[FRAME_RING_MAX_CAPACITY + FRAME_RING_MAX_HELD + 2];
+    uint32_t freeHead;
+    uint32_t freeTail;
+    uint8_t *writing;
+    uint8_t *reading;
+    uint8_t *heldFrames[FRAME_RING_MAX_HELD];
+    uint32_t heldCount;
+    bool closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint64_t pushed;
+    uint64_t popped;
+    uint64_t dropped;
+    uint32_t maxOccupancy;
+} FRAME_RING_T;
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    uint64_t pushed;
+    uint64_t popped;
+    uint64_t dropped;
+    uint32_t occupancy;
+    uint32_t maxOccupancy;
+} FRAME_RING_STATS_T;
+
+//-------------------------------------------------------------------------
+
+bool
+initFrameRing(
+    FRAME_RING_T *ring,
+    uint32_t capacity,
+    uint32_t held,
+    size_t frameSize,
+    FRAME_RING_POLICY_T policy);
+
+uint8_t *
+frameRingWriteBuffer(
+    FRAME_RING_T *ring);
+
+bool
+frameRingPush(
+    FRAME_RING_T *ring);
+
+uint8_t *
+frameRingPop(
+    FRAME_RING_T *ring);
+
+uint32_t
+frameRingOccupancy(
+    FRAME_RING_T *ring);
+
+void
+frameRingStats(
+    FRAME_RING_T *ring,
+    FRAME_RING_STATS_T *stats);
+
+void
+frameRingClose(
+    FRAME_RING_T *ring);
+
+void
+destroyFrameRing(
+    FRAME_RING_T *ring);
+
+bool
+frameRingPolicyFromName(
+    const char *name,
+    FRAME_RING_POLICY_T *policy);
+
+const char *
+frameRingPolicyName(
+    FRAME_RING_POLICY_T policy);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,580 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frameOutput.h"
+#include "frameRing.h"
+
+//-------------------------------------------------------------------------
+// Stress tests of the frame ring and the output thread built on it. A
+// producer thread queues numbered frames (every word of a frame holds its
+// number) while a consumer takes them, both pausing at random so that the
+// queue is sometimes empty and sometimes full. The consumer checks that
+// each frame is whole, still whole when it has finished with it (so that
+// the producer never reused a buffer it was reading), and newer than the
+// last. With the block policy no frame may be missing; when dropping the
+// oldest, the missing frames must be exactly those counted as dropped,
+// and the newest frame is never dropped. When the consumer holds on to
+// frames, it also checks that the frames it holds stay whole. The output
+// thread is then checked the same way, and that draining it leaves
+// nothing unwritten.
+
+#define DEFAULT_FRAMES 100000
+
+#define TEST_FRAME_SIZE 256
+#define TEST_MAX_PAUSE 64
+
+static const uint32_t testCapacities[] = { 1, 2, 3, FRAME_RING_MAX_CAPACITY };
+static const uint32_t testHeld[] = { 1, FRAME_RING_MAX_HELD };
+
+#define COUNT_OF(array) (sizeof(array) / sizeof(array[0]))
+
+//-------------------------------------------------------------------------
+
+void
+printUsage(
+    FILE *fp,
+    const char *name)
+{
+    fprintf(fp, "\n");
+    fprintf(fp, "Usage: %s <options>\n", name);
+    fprintf(fp, "\n");
+    fprintf(fp, "    --frames <number> - frames queued in each run");
+    fprintf(fp, " (default %d)\n", DEFAULT_FRAMES);
+    fprintf(fp, "    --help - print usage and exit\n");
+    fprintf(fp, "\n");
+}
+
+//-------------------------------------------------------------------------
+
+static void
+fillFrame(
+    uint8_t *frame,
+    uint64_t number)
+{
+    size_t i = 0;
+    for (i = 0 ; i < TEST_FRAME_SIZE ; i += sizeof(number))
+    {
+        memcpy(frame + i, &number, sizeof(number));
+    }
+}
+
+//-------------------------------------------------------------------------
+// The frame's number, or 0 if its words do not all hold the same one.
+
+static uint64_t
+frameNumber(
+    const uint8_t *frame)
+{
+    uint64_t number;
+    memcpy(&number, frame, sizeof(number));
+
+    size_t i = 0;
+    for (i = sizeof(number) ; i < TEST_FRAME_SIZE ; i += sizeof(number))
+    {
+        uint64_t value;
+        memcpy(&value, frame + i, sizeof(value));
+
+        if (value != number)
+        {
+            return 0;
+        }
+    }
+
+    return number;
+}
+
+//-------------------------------------------------------------------------
+// Spin for a pseudo random while, sometimes giving up the processor, so
+// that the two threads run at varying speeds.
+
+static void
+pauseRandomly(
+    uint32_t *state)
+{
+    *state = (*state * 1103515245) + 12345;
+
+    uint32_t length = (*state >> 16) % TEST_MAX_PAUSE;
+
+    if (length == 0)
+    {
+        sched_yield();
+        return;
+    }
+
+    volatile uint32_t spin = 0;
+    while (spin < length * 16)
+    {
+        ++spin;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    uint64_t received;
+    uint64_t last;
+    uint64_t torn;
+    uint64_t reused;
+    uint64_t outOfOrder;
+    uint64_t missing;
+    bool block;
+    uint32_t state;
+    uint32_t held;
+    uint32_t heldCount;
+    const uint8_t *heldFrames[FRAME_RING_MAX_HELD];
+    uint64_t heldNumbers[FRAME_RING_MAX_HELD];
+} CONSUMER_T;
+
+//-------------------------------------------------------------------------
+// Check a frame taken by the consumer, after pausing to use it, and that
+// the frames it holds have not been reused.
+
+static void
+consumeFrame(
+    CONSUMER_T *consumer,
+    const uint8_t *frame)
+{
+    uint64_t number = frameNumber(frame);
+
+    pauseRandomly(&(consumer->state));
+
+    if (number == 0)
+    {
+        ++(consumer->torn);
+    }
+    else if (frameNumber(frame) != number)
+    {
+        ++(consumer->reused);
+    }
+
+    uint32_t i = 0;
+    for (i = 0 ; i < consumer->heldCount ; ++i)
+    {
+        if (frameNumber(consumer->heldFrames[i]) != consumer->heldNumbers[i])
+        {
+            ++(consumer->reused);
+        }
+    }
+
+    if (consumer->held > 0)
+    {
+        if (consumer->heldCount == consumer->held)
+        {
+            --(consumer->heldCount);
+
+            memmove(consumer->heldFrames,
+                    consumer->heldFrames + 1,
+                    consumer->heldCount * sizeof(consumer->heldFrames[0]));
+            memmove(consumer->heldNumbers,
+                    consumer->heldNumbers + 1,
+                    consumer->heldCount * sizeof(consumer->heldNumbers[0]));
+        }
+
+        consumer->heldFrames[consumer->heldCount] = frame;
+        consumer->heldNumbers[consumer->heldCount] = number;
+        ++(consumer->heldCount);
+    }
+
+    if (number <= consumer->last)
+    {
+        ++(consumer->outOfOrder);
+    }
+    else if (consumer->block && (number != consumer->last + 1))
+    {
+        consumer->missing += number - consumer->last - 1;
+    }
+
+    consumer->last = (number > consumer->last) ? number : consumer->last;
+    ++(consumer->received);
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+checkConsumer(
+    const char *name,
+    const CONSUMER_T *consumer,
+    const FRAME_RING_STATS_T *stats,
+    uint64_t frames,
+    uint32_t capacity)
+{
+    bool passed = (consumer->torn == 0)
+               && (consumer->reused == 0)
+               && (consumer->outOfOrder == 0)
+               && (consumer->missing == 0)
+               && (consumer->last == frames)
+               && (stats->pushed == frames)
+               && (stats->popped == consumer->received)
+               && (stats->dropped == frames - consumer->received)
+               && (stats->occupancy == 0)
+               && (stats->maxOccupancy <= capacity)
+               && ((consumer->block == false) || (stats->dropped == 0));
+
+    printf("%s capacity %"PRIu32" held %"PRIu32": %"PRIu64" pushed, %"
+           PRIu64" popped, %"PRIu64" dropped, at most %"PRIu32" queued,"
+           " last %"PRIu64"%s\n",
+           name,
+           capacity,
+           consumer->held,
+           stats->pushed,
+           stats->popped,
+           stats->dropped,
+           stats->maxOccupancy,
+           consumer->last,
+           (passed) ? "" : " FAILED");
+
+    if (passed == false)
+    {
+        printf("    %"PRIu64" received, %"PRIu64" torn, %"PRIu64" reused"
+               " while read or held, %"PRIu64" out of order, %"PRIu64" missing\n",
+               consumer->received,
+               consumer->torn,
+               consumer->reused,
+               consumer->outOfOrder,
+               consumer->missing);
+    }
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    FRAME_RING_T *ring;
+    FRAME_OUTPUT_T *output;
+    uint64_t frames;
+} PRODUCER_T;
+
+//-------------------------------------------------------------------------
+
+static void *
+producerThread(
+    void *arg)
+{
+    PRODUCER_T *producer = arg;
+    uint32_t state = 0x2468ACE0;
+
+    uint64_t number = 0;
+    for (number = 1 ; number <= producer->frames ; ++number)
+    {
+        pauseRandomly(&state);
+
+        fillFrame(frameRingWriteBuffer(producer->ring), number);
+        frameRingPush(producer->ring);
+    }
+
+    frameRingClose(producer->ring);
+
+    return NULL;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+testRing(
+    FRAME_RING_POLICY_T policy,
+    uint32_t capacity,
+    uint32_t held,
+    uint64_t frames)
+{
+    FRAME_RING_T ring;
+
+    if (initFrameRing(&ring,
+                      capacity,
+                      held,
+                      TEST_FRAME_SIZE,
+                      policy) == false)
+    {
+        printf("ring: FAILED, init\n");
+        return false;
+    }
+
+    PRODUCER_T producer = { &ring, NULL, frames };
+    pthread_t thread;
+
+    if (pthread_create(&thread, NULL, producerThread, &producer) != 0)
+    {
+        printf("ring: FAILED, starting producer\n");
+        destroyFrameRing(&ring);
+        return false;
+    }
+
+    CONSUMER_T consumer;
+    memset(&consumer, 0, sizeof(consumer));
+    consumer.block = (policy == FRAME_RING_BLOCK);
+    consumer.state = 0x13579BDF;
+    consumer.held = held;
+
+    const uint8_t *frame = NULL;
+
+    while ((frame = frameRingPop(&ring)) != NULL)
+    {
+        consumeFrame(&consumer, frame);
+    }
+
+    pthread_join(thread, NULL);
+
+    FRAME_RING_STATS_T stats;
+    frameRingStats(&ring, &stats);
+
+    char name[32];
+    snprintf(name, sizeof(name), "ring %s", frameRingPolicyName(policy));
+
+    bool passed = checkConsumer(name, &consumer, &stats, frames, capacity);
+
+    destroyFrameRing(&ring);
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+
+static size_t
+writeTestFrame(
+    void *context,
+    const uint8_t *frame)
+{
+    consumeFrame(context, frame);
+
+    return TEST_FRAME_SIZE;
+}
+
+//-------------------------------------------------------------------------
+// The same through an output thread, draining it part way through and at
+// the end.
+
+static bool
+testOutput(
+    FRAME_RING_POLICY_T policy,
+    uint32_t capacity,
+    uint32_t held,
+    uint64_t frames)
+{
+    CONSUMER_T consumer;
+    memset(&consumer, 0, sizeof(consumer));
+    consumer.block = (policy == FRAME_RING_BLOCK);
+    consumer.state = 0x0F1E2D3C;
+    consumer.held = held;
+
+    FRAME_OUTPUT_T output;
+
+    if (initFrameOutput(&output,
+                        "test",
+                        capacity,
+                        held,
+                        policy,
+                        TEST_FRAME_SIZE,
+                        writeTestFrame,
+                        &consumer) == false)
+    {
+        printf("output: FAILED, init\n");
+        return false;
+    }
+
+    uint32_t state = 0x2468ACE0;
+    bool passed = true;
+
+    uint64_t number = 0;
+    for (number = 1 ; number <= frames ; ++number)
+    {
+        pauseRandomly(&state);
+
+        fillFrame(frameOutputBuffer(&output), number);
+        frameOutputSubmit(&output);
+
+        if ((number == frames / 2) || (number == frames))
+        {
+            frameOutputDrain(&output);
+
+            // the output's thread is now idle, so this thread may look at
+            // what it has written
+
+            FRAME_RING_STATS_T ring;
+            frameRingStats(&(output.ring), &ring);
+
+            if ((consumer.last != number)
+                || (consumer.received != ring.pushed - ring.dropped))
+            {
+                printf("output %s capacity %"PRIu32": FAILED, %"PRIu64
+                       " of %"PRIu64" frames written after draining\n",
+                       frameRingPolicyName(policy),
+                       capacity,
+                       consumer.received,
+                       ring.pushed - ring.dropped);
+                passed = false;
+            }
+        }
+    }
+
+    stopFrameOutput(&output);
+
+    FRAME_OUTPUT_STATS_T stats;
+    frameOutputStats(&output, &stats);
+
+    FRAME_RING_STATS_T ring;
+    frameRingStats(&(output.ring), &ring);
+
+    if ((stats.frames != consumer.received)
+        || (stats.bytes != consumer.received * TEST_FRAME_SIZE)
+        || (stats.writeLatency.count != consumer.received))
+    {
+        printf("output %s capacity %"PRIu32": FAILED, statistics of %"
+               PRIu64" frames %"PRIu64" bytes for %"PRIu64" written\n",
+               frameRingPolicyName(policy),
+               capacity,
+               stats.frames,
+               stats.bytes,
+               consumer.received);
+        passed = false;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "output %s", frameRingPolicyName(policy));
+
+    if (checkConsumer(name, &consumer, &ring, frames, capacity) == false)
+    {
+        passed = false;
+    }
+
+    destroyFrameOutput(&output);
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+
+int
+main(
+    int argc,
+    char *argv[])
+{
+    const char *program = basename(argv[0]);
+
+    int frames = DEFAULT_FRAMES;
+
+    //---------------------------------------------------------------------
+
+    static const char *sopts = "f:h";
+    static struct option lopts[] =
+    {
+        { "frames", required_argument, NULL, 'f' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, no_argument, NULL, 0 }
+    };
+
+    int opt = 0;
+
+    while ((opt = getopt_long(argc, argv, sopts, lopts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+
+            frames = atoi(optarg);
+            break;
+
+        case 'h':
+
+            printUsage(stdout, program);
+            exit(EXIT_SUCCESS);
+
+            break;
+
+        default:
+
+            printUsage(stderr, program);
+            exit(EXIT_FAILURE);
+
+            break;
+        }
+    }
+
+    if (frames < 20)
+    {
+        fprintf(stderr, "%s: invalid options\n", program);
+        printUsage(stderr, program);
+        exit(EXIT_FAILURE);
+    }
+
+    //---------------------------------------------------------------------
+
+    static const FRAME_RING_POLICY_T policies[] =
+    {
+        FRAME_RING_DROP_OLDEST,
+        FRAME_RING_BLOCK
+    };
+
+    bool passed = true;
+
+    size_t p = 0;
+    for (p = 0 ; p < COUNT_OF(policies) ; ++p)
+    {
+        size_t c = 0;
+        for (c = 0 ; c < COUNT_OF(testCapacities) ; ++c)
+        {
+            if (testRing(policies[p], testCapacities[c], 0, frames) == false)
+            {
+                passed = false;
+            }
+        }
+
+        size_t h = 0;
+        for (h = 0 ; h < COUNT_OF(testHeld) ; ++h)
+        {
+            if (testRing(policies[p], 2, testHeld[h], frames) == false)
+            {
+                passed = false;
+            }
+        }
+
+        if (testOutput(policies[p], 2, 0, frames / 10) == false)
+        {
+            passed = false;
+        }
+
+        if (testOutput(policies[p], 2, 2, frames / 10) == false)
+        {
+            passed = false;
+        }
+    }
+
+    return (passed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
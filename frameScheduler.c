@@ -0,0 +1,243 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "frameScheduler.h"
+
+//-------------------------------------------------------------------------
+
+static struct timespec
+nanosecondsToTimespec(
+    int64_t ns)
+{
+    struct timespec ts =
+    {
+        .tv_sec = ns / NANOSECONDS_PER_SECOND,
+        .tv_nsec = ns % NANOSECONDS_PER_SECOND
+    };
+
+    return ts;
+}
+
+//-------------------------------------------------------------------------
+
+void
+monotonicSleepUntil(
+    int64_t ns)
+{
+    struct timespec ts = nanosecondsToTimespec(ns);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+        // a signal woke us early, go back to sleep until the deadline
+    }
+}
+
+//-------------------------------------------------------------------------
+
+int64_t
+monotonicNanoseconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * NANOSECONDS_PER_SECOND) + ts.tv_nsec;
+}
+
+//-------------------------------------------------------------------------
+
+void
+initFrameScheduler(
+    FRAME_SCHEDULER_T *scheduler,
+    int64_t period,
+    int64_t spin,
+    FRAME_SCHEDULER_MISSED_T missed)
+{
+    scheduler->period = period;
+    scheduler->spin = (spin < period) ? spin : period;
+    scheduler->missed = missed;
+    scheduler->phase = monotonicNanoseconds();
+    scheduler->frame = 1;
+    scheduler->deadline = scheduler->phase + period;
+    scheduler->wakeups = 0;
+    scheduler->missedDeadlines = 0;
+    scheduler->lastLateness = 0;
+    scheduler->maxLateness = 0;
+    scheduler->totalLateness = 0;
+}
+
+//-------------------------------------------------------------------------
+// Changing the period starts a new phase at the last deadline, so the next
+// deadline is one new period after the last one.
+
+void
+setFrameSchedulerPeriod(
+    FRAME_SCHEDULER_T *scheduler,
+    int64_t period)
+{
+    if (period == scheduler->period)
+    {
+        return;
+    }
+
+    scheduler->phase = scheduler->deadline - scheduler->period;
+    scheduler->frame = 1;
+    scheduler->period = period;
+    scheduler->deadline = scheduler->phase + period;
+
+    if (scheduler->spin > period)
+    {
+        scheduler->spin = period;
+    }
+}
+
+//-------------------------------------------------------------------------
+// Deadlines are always calculated as phase + frame * period rather than by
+// adding to the previous wakeup time, so errors in individual wakeups do
+// not accumulate into drift. Returns how late the wakeup was (in
+// nanoseconds) relative to the deadline that was waited for.
+
+int64_t
+frameSchedulerWait(
+    FRAME_SCHEDULER_T *scheduler)
+{
+    int64_t now = monotonicNanoseconds();
+
+    if (now >= scheduler->deadline)
+    {
+        ++(scheduler->missedDeadlines);
+
+        switch (scheduler->missed)
+        {
+        case FRAME_SCHEDULER_CATCH_UP:
+
+            break;
+
+        case FRAME_SCHEDULER_SKIP:
+
+            scheduler->frame += ((now - scheduler->deadline)
+                                 / scheduler->period) + 1;
+            scheduler->deadline = scheduler->phase
+                                + (scheduler->frame * scheduler->period);
+            break;
+
+        case FRAME_SCHEDULER_REPHASE:
+
+            scheduler->phase = now;
+            scheduler->frame = 0;
+            scheduler->deadline = now;
+            break;
+        }
+    }
+
+    int64_t deadline = scheduler->deadline;
+
+    if (deadline > now)
+    {
+        if (scheduler->spin > 0)
+        {
+            // Sleep until just before the deadline, then busy wait for
+            // the remainder to avoid the scheduler's wakeup latency.
+
+            if ((deadline - scheduler->spin) > now)
+            {
+                monotonicSleepUntil(deadline - scheduler->spin);
+            }
+
+            do
+            {
+                now = monotonicNanoseconds();
+            }
+            while (now < deadline);
+        }
+        else
+        {
+            monotonicSleepUntil(deadline);
+            now = monotonicNanoseconds();
+        }
+    }
+
+    ++(scheduler->frame);
+    scheduler->deadline = scheduler->phase
+                        + (scheduler->frame * scheduler->period);
+
+    //---------------------------------------------------------------------
+
+    int64_t lateness = now - deadline;
+
+    ++(scheduler->wakeups);
+    scheduler->lastLateness = lateness;
+    scheduler->totalLateness += lateness;
+
+    if (lateness > scheduler->maxLateness)
+    {
+        scheduler->maxLateness = lateness;
+    }
+
+    return lateness;
+}
+
+//-------------------------------------------------------------------------
+
+int64_t
+frameSchedulerMeanLateness(
+    const FRAME_SCHEDULER_T *scheduler)
+{
+    if (scheduler->wakeups == 0)
+    {
+        return 0;
+    }
+
+    return scheduler->totalLateness / (int64_t)(scheduler->wakeups);
+}
+
+//-------------------------------------------------------------------------
+
+const char *
+frameSchedulerMissedName(
+    FRAME_SCHEDULER_MISSED_T missed)
+{
+    switch (missed)
+    {
+    case FRAME_SCHEDULER_CATCH_UP:
+
+        return "catchup";
+
+    case FRAME_SCHEDULER_SKIP:
+
+        return "skip";
+
+    case FRAME_SCHEDULER_REPHASE:
+
+        return "rephase";
+    }
+
+    return "unknown";
+}
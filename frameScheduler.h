@@ -0,0 +1,110 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+//-------------------------------------------------------------------------
+
+#include <stdint.h>
+
+//-------------------------------------------------------------------------
+
+#define NANOSECONDS_PER_SECOND 1000000000LL
+#define NANOSECONDS_PER_MILLISECOND 1000000LL
+#define NANOSECONDS_PER_MICROSECOND 1000LL
+
+//-------------------------------------------------------------------------
+// What to do when the work for a frame runs past the next deadline.
+//
+// CATCH_UP - keep the original deadlines and run the late frames back to
+//            back until the schedule is met again.
+// SKIP     - drop the missed deadlines and wait for the next deadline
+//            that is still in the future, keeping the original phase.
+// REPHASE  - start the next frame immediately and measure all further
+//            deadlines from now.
+
+typedef enum
+{
+    FRAME_SCHEDULER_CATCH_UP,
+    FRAME_SCHEDULER_SKIP,
+    FRAME_SCHEDULER_REPHASE
+} FRAME_SCHEDULER_MISSED_T;
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    int64_t period;
+    int64_t spin;
+    FRAME_SCHEDULER_MISSED_T missed;
+    int64_t phase;
+    int64_t frame;
+    int64_t deadline;
+    uint64_t wakeups;
+    uint64_t missedDeadlines;
+    int64_t lastLateness;
+    int64_t maxLateness;
+    int64_t totalLateness;
+} FRAME_SCHEDULER_T;
+
+//-------------------------------------------------------------------------
+
+int64_t
+monotonicNanoseconds(void);
+
+void
+monotonicSleepUntil(
+    int64_t ns);
+
+void
+initFrameScheduler(
+    FRAME_SCHEDULER_T *scheduler,
+    int64_t period,
+    int64_t spin,
+    FRAME_SCHEDULER_MISSED_T missed);
+
+void
+setFrameSchedulerPeriod(
+    FRAME_SCHEDULER_T *scheduler,
+    int64_t period);
+
+int64_t
+frameSchedulerWait(
+    FRAME_SCHEDULER_T *scheduler);
+
+int64_t
+frameSchedulerMeanLateness(
+    const FRAME_SCHEDULER_T *scheduler);
+
+const char *
+frameSchedulerMissedName(
+    FRAME_SCHEDULER_MISSED_T missed);
+
+//-------------------------------------------------------------------------
+
+#endif
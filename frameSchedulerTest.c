@@ -0,0 +1,280 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frameScheduler.h"
+#include "latencyHistogram.h"
+
+//-------------------------------------------------------------------------
+// Measures how closely frameSchedulerWait() keeps to its deadlines over
+// thousands of frames, once sleeping and once sleeping then spinning.
+// Each wakeup is timed independently of the scheduler's own bookkeeping
+// against the fixed deadline it was waiting for. The test fails if a wait
+// returns before its deadline, if the schedule drifts, or if the 99th
+// percentile lateness is above the limit. The limit is generous by
+// default so that the test passes on a loaded build machine; tighten it
+// on the target to check the real jitter.
+
+#define DEFAULT_FRAMES 2000
+#define DEFAULT_PERIOD 1000
+#define DEFAULT_SPIN 200
+#define DEFAULT_LIMIT 5000
+
+//-------------------------------------------------------------------------
+
+void
+printUsage(
+    FILE *fp,
+    const char *name)
+{
+    fprintf(fp, "\n");
+    fprintf(fp, "Usage: %s <options>\n", name);
+    fprintf(fp, "\n");
+    fprintf(fp, "    --frames <number> - frames in each run");
+    fprintf(fp, " (default %d)\n", DEFAULT_FRAMES);
+    fprintf(fp, "    --period <microseconds> - frame period");
+    fprintf(fp, " (default %d)\n", DEFAULT_PERIOD);
+    fprintf(fp, "    --spin <microseconds> - spin time of the second run");
+    fprintf(fp, " (default %d)\n", DEFAULT_SPIN);
+    fprintf(fp, "    --limit <microseconds> - highest 99th percentile");
+    fprintf(fp, " lateness (default %d)\n", DEFAULT_LIMIT);
+    fprintf(fp, "    --help - print usage and exit\n");
+    fprintf(fp, "\n");
+}
+
+//-------------------------------------------------------------------------
+
+static int64_t
+microseconds(
+    int64_t ns)
+{
+    return ns / NANOSECONDS_PER_MICROSECOND;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+measureJitter(
+    const char *name,
+    int frames,
+    int64_t period,
+    int64_t spin,
+    int64_t limit)
+{
+    FRAME_SCHEDULER_T scheduler;
+    initFrameScheduler(&scheduler, period, spin, FRAME_SCHEDULER_CATCH_UP);
+
+    LATENCY_HISTOGRAM_T lateness;
+    initLatencyHistogram(&lateness);
+
+    LATENCY_HISTOGRAM_T interval;
+    initLatencyHistogram(&interval);
+
+    int64_t phase = scheduler.phase;
+    int64_t previous = phase;
+    int64_t drift = 0;
+    int early = 0;
+
+    int frame = 0;
+    for (frame = 1 ; frame <= frames ; ++frame)
+    {
+        frameSchedulerWait(&scheduler);
+
+        int64_t now = monotonicNanoseconds();
+        int64_t late = now - (phase + (frame * period));
+
+        if (late < 0)
+        {
+            ++early;
+        }
+
+        latencyHistogramAdd(&lateness, late);
+
+        if (frame > 1)
+        {
+            int64_t error = (now - previous) - period;
+            latencyHistogramAdd(&interval, (error < 0) ? -error : error);
+        }
+
+        previous = now;
+        drift = late;
+    }
+
+    int64_t p50 = latencyHistogramPercentile(&lateness, 50.0);
+    int64_t p99 = latencyHistogramPercentile(&lateness, 99.0);
+
+    printf("%s: %d frames at %" PRId64 " us, lateness p50 %" PRId64
+           " us p99 %" PRId64 " us max %" PRId64 " us, interval error p99 %"
+           PRId64 " us, %" PRIu64 " missed, %d early\n",
+           name,
+           frames,
+           microseconds(period),
+           microseconds(p50),
+           microseconds(p99),
+           microseconds(lateness.max),
+           microseconds(latencyHistogramPercentile(&interval, 99.0)),
+           scheduler.missedDeadlines,
+           early);
+
+    bool passed = true;
+
+    if (early > 0)
+    {
+        printf("%s: FAILED, %d wakeups before their deadline\n",
+               name,
+               early);
+        passed = false;
+    }
+
+    if (scheduler.wakeups != (uint64_t)frames)
+    {
+        printf("%s: FAILED, %" PRIu64 " wakeups for %d frames\n",
+               name,
+               scheduler.wakeups,
+               frames);
+        passed = false;
+    }
+
+    if (drift > limit)
+    {
+        printf("%s: FAILED, last frame %" PRId64 " us behind schedule\n",
+               name,
+               microseconds(drift));
+        passed = false;
+    }
+
+    if (p99 > limit)
+    {
+        printf("%s: FAILED, p99 lateness above %" PRId64 " us\n",
+               name,
+               microseconds(limit));
+        passed = false;
+    }
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+
+int
+main(
+    int argc,
+    char *argv[])
+{
+    const char *program = basename(argv[0]);
+
+    int frames = DEFAULT_FRAMES;
+    int64_t period = DEFAULT_PERIOD;
+    int64_t spin = DEFAULT_SPIN;
+    int64_t limit = DEFAULT_LIMIT;
+
+    //---------------------------------------------------------------------
+
+    static const char *sopts = "f:hl:p:s:";
+    static struct option lopts[] =
+    {
+        { "frames", required_argument, NULL, 'f' },
+        { "help", no_argument, NULL, 'h' },
+        { "limit", required_argument, NULL, 'l' },
+        { "period", required_argument, NULL, 'p' },
+        { "spin", required_argument, NULL, 's' },
+        { NULL, no_argument, NULL, 0 }
+    };
+
+    int opt = 0;
+
+    while ((opt = getopt_long(argc, argv, sopts, lopts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+
+            frames = atoi(optarg);
+            break;
+
+        case 'h':
+
+            printUsage(stdout, program);
+            exit(EXIT_SUCCESS);
+
+            break;
+
+        case 'l':
+
+            limit = atoll(optarg);
+            break;
+
+        case 'p':
+
+            period = atoll(optarg);
+            break;
+
+        case 's':
+
+            spin = atoll(optarg);
+            break;
+
+        default:
+
+            printUsage(stderr, program);
+            exit(EXIT_FAILURE);
+
+            break;
+        }
+    }
+
+    if ((frames < 2) || (period <= 0) || (spin < 0) || (limit <= 0))
+    {
+        fprintf(stderr, "%s: invalid options\n", program);
+        printUsage(stderr, program);
+        exit(EXIT_FAILURE);
+    }
+
+    period *= NANOSECONDS_PER_MICROSECOND;
+    spin *= NANOSECONDS_PER_MICROSECOND;
+    limit *= NANOSECONDS_PER_MICROSECOND;
+
+    //---------------------------------------------------------------------
+
+    bool passed = measureJitter("sleep", frames, period, 0, limit);
+
+    if (measureJitter("spin", frames, period, spin, limit) == false)
+    {
+        passed = false;
+    }
+
+    return (passed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
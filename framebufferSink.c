@@ -0,0 +1,409 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "displayBackend.h"
+#include "framebufferSink.h"
+#include "imageFormat.h"
+
+//-------------------------------------------------------------------------
+// The snapshot format with the same depth as the framebuffer.
+
+static bool
+framebufferImageType(
+    uint32_t bitsPerPixel,
+    VC_IMAGE_TYPE_T *type)
+{
+    switch (bitsPerPixel)
+    {
+    case 16:
+
+        *type = VC_IMAGE_RGB565;
+        return true;
+
+    case 24:
+
+        *type = VC_IMAGE_RGB888;
+        return true;
+
+    case 32:
+
+        *type = VC_IMAGE_RGBX32;
+        return true;
+
+    default:
+
+        return false;
+    }
+}
+
+//-------------------------------------------------------------------------
+// Get the geometry of a framebuffer device. Returns false if fd is not a
+// framebuffer.
+
+static bool
+getFramebufferGeometry(
+    FRAMEBUFFER_SINK_T *sink,
+    uint32_t *bitsPerPixel)
+{
+    struct fb_var_screeninfo var;
+    struct fb_fix_screeninfo fix;
+
+    if ((ioctl(sink->fd, FBIOGET_VSCREENINFO, &var) == -1)
+        || (ioctl(sink->fd, FBIOGET_FSCREENINFO, &fix) == -1))
+    {
+        return false;
+    }
+
+    sink->width = var.xres;
+    sink->height = var.yres;
+    sink->lineLength = fix.line_length;
+    sink->xoffset = var.xoffset;
+    sink->yoffset = var.yoffset;
+    sink->mapSize = fix.smem_len;
+
+    // 16 bit framebuffers are RGB565, as are the snapshots. Deeper ones
+    // usually have red in the most significant byte, i.e. the opposite
+    // byte order to the snapshots.
+
+    sink->swapRedBlue = (var.bits_per_pixel > 16) && (var.red.offset != 0);
+
+    *bitsPerPixel = var.bits_per_pixel;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Open and map the framebuffer. The width, height and bitsPerPixel are
+// only used if path is not a framebuffer device; if they are given, a
+// file that does not exist is created. The conversion is only used if the
+// framebuffer is 16 bit. Returns false, with errno set, on failure.
+
+bool
+initFramebufferSink(
+    FRAMEBUFFER_SINK_T *sink,
+    const char *path,
+    uint32_t width,
+    uint32_t height,
+    uint32_t bitsPerPixel,
+    PIXEL_CONVERT_T convert)
+{
+    memset(sink, 0, sizeof(*sink));
+
+    int flags = O_RDWR;
+
+    if ((width > 0) && (height > 0))
+    {
+        flags |= O_CREAT;
+    }
+
+    sink->fd = open(path, flags, 0644);
+
+    if (sink->fd == -1)
+    {
+        return false;
+    }
+
+    if (getFramebufferGeometry(sink, &bitsPerPixel) == false)
+    {
+        if ((width == 0) || (height == 0))
+        {
+            close(sink->fd);
+            errno = ENOTTY;
+            return false;
+        }
+
+        sink->width = width;
+        sink->height = height;
+        sink->lineLength = width * (bitsPerPixel / 8);
+        sink->mapSize = sink->lineLength * height;
+
+        struct stat st;
+
+        if ((fstat(sink->fd, &st) == -1)
+            || ((st.st_size < (off_t)sink->mapSize)
+                && (ftruncate(sink->fd, sink->mapSize) == -1)))
+        {
+            int error = errno;
+            close(sink->fd);
+            errno = error;
+            return false;
+        }
+    }
+
+    if ((framebufferImageType(bitsPerPixel, &(sink->type)) == false)
+        || (((sink->xoffset + sink->width) * (bitsPerPixel / 8))
+            > sink->lineLength)
+        || (((sink->yoffset + sink->height) * sink->lineLength)
+            > sink->mapSize))
+    {
+        close(sink->fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    sink->bytesPerPixel = bitsPerPixel / 8;
+
+    if ((convert != PIXEL_CONVERT_NONE) && (bitsPerPixel == 16))
+    {
+        sink->convert = convert;
+        sink->type = VC_IMAGE_RGBX32;
+    }
+
+    //---------------------------------------------------------------------
+
+    sink->map = mmap(NULL,
+                     sink->mapSize,
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED,
+                     sink->fd,
+                     0);
+
+    if (sink->map == MAP_FAILED)
+    {
+        int error = errno;
+        close(sink->fd);
+        sink->map = NULL;
+        errno = error;
+        return false;
+    }
+
+    sink->pitch = imageFormatPitch(sink->type, sink->width);
+    sink->buffer = malloc(sink->pitch * sink->height);
+    sink->previous = malloc(sink->width * sink->bytesPerPixel * sink->height);
+    sink->previousValid = false;
+
+    if (sink->convert != PIXEL_CONVERT_NONE)
+    {
+        sink->converted = malloc(sink->width * 2 * sink->height);
+    }
+
+    if ((sink->buffer == NULL)
+        || (sink->previous == NULL)
+        || ((sink->convert != PIXEL_CONVERT_NONE)
+            && (sink->converted == NULL)))
+    {
+        destroyFramebufferSink(sink);
+        errno = ENOMEM;
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Read back a snapshot resource, the size of the framebuffer, into the
+// sink's buffer.
+
+bool
+framebufferSinkRead(
+    FRAMEBUFFER_SINK_T *sink,
+    DISPMANX_RESOURCE_HANDLE_T resource)
+{
+    VC_RECT_T rect;
+    setRect(&rect, 0, 0, sink->width, sink->height);
+
+    return displayBackend()->resourceReadData(resource,
+                                              &rect,
+                                              sink->buffer,
+                                              sink->pitch) == 0;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+copyFramebufferLine(
+    const FRAMEBUFFER_SINK_T *sink,
+    uint8_t *line,
+    const uint8_t *row,
+    uint32_t rowBytes)
+{
+    if (sink->swapRedBlue)
+    {
+        uint32_t x = 0;
+        for (x = 0 ; x < rowBytes ; x += sink->bytesPerPixel)
+        {
+            memcpy(line + x, row + x, sink->bytesPerPixel);
+            line[x] = row[x + 2];
+            line[x + 2] = row[x];
+        }
+    }
+    else
+    {
+        memcpy(line, row, rowBytes);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    FRAMEBUFFER_SINK_T *sink;
+    const uint8_t *pixels;
+    uint32_t pitch;
+    size_t written;
+} FRAMEBUFFER_SINK_JOB_T;
+
+//-------------------------------------------------------------------------
+// Convert (if needed) and write one stripe of lines. Stripes start on a
+// multiple of four lines, so that the dither pattern lines up.
+
+static void
+writeFramebufferStripe(
+    void *arg,
+    uint32_t stripe,
+    uint32_t stripes)
+{
+    FRAMEBUFFER_SINK_JOB_T *job = arg;
+    FRAMEBUFFER_SINK_T *sink = job->sink;
+
+    uint32_t rowBytes = sink->width * sink->bytesPerPixel;
+    size_t written = 0;
+
+    uint32_t first = 0;
+    uint32_t end = 0;
+
+    workerPoolStripe(stripe, stripes, sink->height, 4, &first, &end);
+
+    if (first == end)
+    {
+        return;
+    }
+
+    const uint8_t *pixels = job->pixels + (first * job->pitch);
+    uint32_t pitch = job->pitch;
+
+    if (sink->convert != PIXEL_CONVERT_NONE)
+    {
+        uint8_t *converted = sink->converted + (first * rowBytes);
+
+        convertRgba32ToRgb565(converted,
+                              rowBytes,
+                              pixels,
+                              pitch,
+                              sink->width,
+                              end - first,
+                              sink->convert);
+
+        pixels = converted;
+        pitch = rowBytes;
+    }
+
+    const uint8_t *row = pixels;
+    uint8_t *previous = sink->previous + (first * rowBytes);
+    uint8_t *line = sink->map
+                  + ((sink->yoffset + first) * sink->lineLength)
+                  + (sink->xoffset * sink->bytesPerPixel);
+
+    uint32_t y = 0;
+    for (y = first ; y < end ; ++y)
+    {
+        if ((sink->previousValid == false)
+            || (memcmp(row, previous, rowBytes) != 0))
+        {
+            copyFramebufferLine(sink, line, row, rowBytes);
+            memcpy(previous, row, rowBytes);
+            written += rowBytes;
+        }
+
+        row += pitch;
+        previous += rowBytes;
+        line += sink->lineLength;
+    }
+
+    __sync_fetch_and_add(&(job->written), written);
+}
+
+//-------------------------------------------------------------------------
+// Copy the lines of a frame, read back with the given pitch, that differ
+// from the last frame written into the framebuffer, in stripes on the
+// pool if there is one. Returns the number of bytes written.
+
+size_t
+framebufferSinkWrite(
+    FRAMEBUFFER_SINK_T *sink,
+    const uint8_t *pixels,
+    uint32_t pitch,
+    WORKER_POOL_T *pool)
+{
+    FRAMEBUFFER_SINK_JOB_T job = { sink, pixels, pitch, 0 };
+
+    workerPoolRun(pool, writeFramebufferStripe, &job);
+
+    sink->previousValid = true;
+
+    return job.written;
+}
+
+//-------------------------------------------------------------------------
+// Forget the last frame, so that the next one is written in full (e.g.
+// after something else may have drawn on the framebuffer).
+
+void
+framebufferSinkReset(
+    FRAMEBUFFER_SINK_T *sink)
+{
+    sink->previousValid = false;
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyFramebufferSink(
+    FRAMEBUFFER_SINK_T *sink)
+{
+    if (sink->map == NULL)
+    {
+        return;
+    }
+
+    munmap(sink->map, sink->mapSize);
+    sink->map = NULL;
+
+    close(sink->fd);
+    sink->fd = -1;
+
+    free(sink->buffer);
+    sink->buffer = NULL;
+
+    free(sink->previous);
+    sink->previous = NULL;
+
+    free(sink->converted);
+    sink->converted = NULL;
+}
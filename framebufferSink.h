@@ -0,0 +1,108 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef FRAMEBUFFER_SINK_H
+#define FRAMEBUFFER_SINK_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "displayTypes.h"
+
+#include "pixelConvert.h"
+#include "workerPool.h"
+
+//-------------------------------------------------------------------------
+// A Linux framebuffer (e.g. an SPI or DPI panel on /dev/fb1) used as the
+// destination of a pipeline instead of a DispmanX display. Each snapshot
+// is taken at the size and depth of the framebuffer, read back, and copied
+// into the memory mapped framebuffer. Only the lines that differ from the
+// last frame written are copied, as every page touched costs bus time on
+// panels that use deferred I/O (e.g. fbtft). A 16 bit framebuffer can
+// instead be fed from RGBX32 snapshots converted (and dithered) by the
+// CPU. A regular file can stand in for the
+// framebuffer device, in which case its geometry must be given, its lines
+// are not padded and its pixels are in the snapshot's byte order.
+
+typedef struct
+{
+    int fd;
+    uint8_t *map;
+    size_t mapSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerPixel;
+    uint32_t lineLength;
+    uint32_t xoffset;
+    uint32_t yoffset;
+    bool swapRedBlue;
+    VC_IMAGE_TYPE_T type;
+    PIXEL_CONVERT_T convert;
+    uint8_t *converted;
+    uint8_t *buffer;
+    uint32_t pitch;
+    uint8_t *previous;
+    bool previousValid;
+} FRAMEBUFFER_SINK_T;
+
+//-------------------------------------------------------------------------
+
+bool
+initFramebufferSink(
+    FRAMEBUFFER_SINK_T *sink,
+    const char *path,
+    uint32_t width,
+    uint32_t height,
+    uint32_t bitsPerPixel,
+    PIXEL_CONVERT_T convert);
+
+bool
+framebufferSinkRead(
+    FRAMEBUFFER_SINK_T *sink,
+    DISPMANX_RESOURCE_HANDLE_T resource);
+
+size_t
+framebufferSinkWrite(
+    FRAMEBUFFER_SINK_T *sink,
+    const uint8_t *pixels,
+    uint32_t pitch,
+    WORKER_POOL_T *pool);
+
+void
+framebufferSinkReset(
+    FRAMEBUFFER_SINK_T *sink);
+
+void
+destroyFramebufferSink(
+    FRAMEBUFFER_SINK_T *sink);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,689 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "framebufferSink.h"
+#include "imageFormat.h"
+#include "pixelConvert.h"
+#include "workerPool.h"
+
+//-------------------------------------------------------------------------
+// Writes frames through the framebuffer sink into a regular file standing
+// in for the framebuffer device, for each depth and with the conversion
+// to RGB565, on the calling thread and on a worker pool. The file must
+// hold exactly the rows of the frame (without the padding at the end of
+// each row), only the lines that changed may be rewritten, and the bytes
+// returned must be those of the changed lines. Then runs raspi2raspi on
+// the software backend with --dest-fb set to a regular file, and checks
+// the bytes it logs as written and the pattern left in the file.
+
+#define TEST_WIDTH 50
+#define TEST_HEIGHT 37
+#define TEST_PITCH_PADDING 12
+
+// Seven stripes of the test height would not start on a row of the
+// dither pattern if the sink did not align them.
+
+#define TEST_THREADS 3
+#define TEST_STRIPES 7
+
+#define TEST_SENTINEL 0x5A
+
+typedef struct
+{
+    uint32_t bitsPerPixel;
+    PIXEL_CONVERT_T convert;
+} SINK_TEST_T;
+
+static const SINK_TEST_T sinkTests[] =
+{
+    { 16, PIXEL_CONVERT_NONE },
+    { 24, PIXEL_CONVERT_NONE },
+    { 32, PIXEL_CONVERT_NONE },
+    { 16, PIXEL_CONVERT_DITHER }
+};
+
+// The software backend fills row y of snapshot n with the byte
+// ((n / change) * 31) + y, so with change=0 the first frame is the only
+// one written, and with change=5 every line is rewritten four times.
+
+typedef struct
+{
+    const char *geometry;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerPixel;
+    uint32_t change;
+    uint32_t frames;
+} PROGRAM_TEST_T;
+
+static const PROGRAM_TEST_T programTests[] =
+{
+    { "64x48x32", 64, 48, 4, 5, 20 },
+    { "64x48x16", 64, 48, 2, 0, 20 }
+};
+
+#define COUNT_OF(array) (sizeof(array) / sizeof(array[0]))
+
+//-------------------------------------------------------------------------
+
+void
+printUsage(
+    FILE *fp,
+    const char *name)
+{
+    fprintf(fp, "\n");
+    fprintf(fp, "Usage: %s <options>\n", name);
+    fprintf(fp, "\n");
+    fprintf(fp, "    --raspi2raspi <path> - the program to test\n");
+    fprintf(fp, "    --help - print usage and exit\n");
+    fprintf(fp, "\n");
+}
+
+//-------------------------------------------------------------------------
+// Pseudo random bytes, the same on every run.
+
+static void
+fillBytes(
+    uint8_t *bytes,
+    size_t size)
+{
+    uint32_t state = 0x87654321;
+
+    size_t i = 0;
+    for (i = 0 ; i < size ; ++i)
+    {
+        state = (state * 1103515245) + 12345;
+        bytes[i] = state >> 16;
+    }
+}
+
+//-------------------------------------------------------------------------
+// Create an empty file for the sink in the temporary directory.
+
+static bool
+makeTestFile(
+    char *path,
+    size_t size)
+{
+    snprintf(path, size, "%s/framebufferSinkTest-XXXXXX", P_tmpdir);
+
+    int fd = mkstemp(path);
+
+    if (fd == -1)
+    {
+        printf("FAILED, %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    close(fd);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// The rows the framebuffer should hold for a frame, without padding.
+
+static void
+expectedRows(
+    const FRAMEBUFFER_SINK_T *sink,
+    const uint8_t *pixels,
+    uint32_t pitch,
+    uint8_t *expected)
+{
+    uint32_t rowBytes = sink->width * sink->bytesPerPixel;
+
+    if (sink->convert != PIXEL_CONVERT_NONE)
+    {
+        convertRgba32ToRgb565(expected,
+                              rowBytes,
+                              pixels,
+                              pitch,
+                              sink->width,
+                              sink->height,
+                              sink->convert);
+        return;
+    }
+
+    uint32_t y = 0;
+    for (y = 0 ; y < sink->height ; ++y)
+    {
+        memcpy(expected + (y * rowBytes), pixels + (y * pitch), rowBytes);
+    }
+}
+
+//-------------------------------------------------------------------------
+// Write a frame and check the bytes returned and the file. Lines that are
+// the same in the last frame written must still hold the sentinel the
+// file was filled with; every other line must be the expected row.
+
+static bool
+checkWrite(
+    const char *name,
+    const char *step,
+    FRAMEBUFFER_SINK_T *sink,
+    const uint8_t *pixels,
+    uint32_t pitch,
+    const uint8_t *expected,
+    const uint8_t *last,
+    WORKER_POOL_T *pool,
+    uint8_t *file)
+{
+    uint32_t rowBytes = sink->width * sink->bytesPerPixel;
+    size_t size = (size_t)rowBytes * sink->height;
+
+    memset(file, TEST_SENTINEL, size);
+
+    if (pwrite(sink->fd, file, size, 0) != (ssize_t)size)
+    {
+        printf("%s %s: FAILED, writing the file: %s\n",
+               name,
+               step,
+               strerror(errno));
+        return false;
+    }
+
+    size_t written = framebufferSinkWrite(sink, pixels, pitch, pool);
+
+    if (pread(sink->fd, file, size, 0) != (ssize_t)size)
+    {
+        printf("%s %s: FAILED, reading the file: %s\n",
+               name,
+               step,
+               strerror(errno));
+        return false;
+    }
+
+    size_t changed = 0;
+    uint32_t wrong = 0;
+
+    uint32_t y = 0;
+    for (y = 0 ; y < sink->height ; ++y)
+    {
+        const uint8_t *row = expected + (y * rowBytes);
+        const uint8_t *line = file + (y * rowBytes);
+
+        if ((last != NULL)
+            && (memcmp(row, last + (y * rowBytes), rowBytes) == 0))
+        {
+            uint32_t x = 0;
+            for (x = 0 ; x < rowBytes ; ++x)
+            {
+                if (line[x] != TEST_SENTINEL)
+                {
+                    ++wrong;
+                    break;
+                }
+            }
+        }
+        else
+        {
+            changed += rowBytes;
+
+            if (memcmp(row, line, rowBytes) != 0)
+            {
+                ++wrong;
+            }
+        }
+    }
+
+    bool passed = (written == changed) && (wrong == 0);
+
+    printf("%s %s: %zu bytes written, %zu expected, %"PRIu32" lines"
+           " wrong%s\n",
+           name,
+           step,
+           written,
+           changed,
+           wrong,
+           (passed) ? "" : " FAILED");
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+// Write a frame in full, then a frame with a few lines changed (and the
+// padding of another), the same frame again, and after a reset the same
+// frame in full.
+
+static bool
+testSink(
+    const SINK_TEST_T *test,
+    WORKER_POOL_T *pool)
+{
+    char path[64];
+
+    if (makeTestFile(path, sizeof(path)) == false)
+    {
+        return false;
+    }
+
+    FRAMEBUFFER_SINK_T sink;
+
+    if (initFramebufferSink(&sink,
+                            path,
+                            TEST_WIDTH,
+                            TEST_HEIGHT,
+                            test->bitsPerPixel,
+                            test->convert) == false)
+    {
+        printf("FAILED, %s: %s\n", path, strerror(errno));
+        unlink(path);
+        return false;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "%"PRIu32" bpp %s (%s)",
+             test->bitsPerPixel,
+             pixelConvertName(test->convert),
+             (pool != NULL) ? "pool" : "inline");
+
+    uint32_t bytesPerPixel = imageFormatBytesPerPixel(sink.type);
+    uint32_t pitch = (sink.width * bytesPerPixel) + TEST_PITCH_PADDING;
+    uint32_t rowBytes = sink.width * sink.bytesPerPixel;
+    size_t size = (size_t)rowBytes * sink.height;
+
+    uint8_t *pixels = malloc((size_t)pitch * sink.height);
+    uint8_t *first = malloc(size);
+    uint8_t *second = malloc(size);
+    uint8_t *file = malloc(size);
+
+    bool passed = (pixels != NULL)
+               && (first != NULL)
+               && (second != NULL)
+               && (file != NULL);
+
+    if (passed == false)
+    {
+        printf("out of memory\n");
+    }
+    else
+    {
+        fillBytes(pixels, (size_t)pitch * sink.height);
+        expectedRows(&sink, pixels, pitch, first);
+
+        passed = checkWrite(name,
+                            "first frame",
+                            &sink,
+                            pixels,
+                            pitch,
+                            first,
+                            NULL,
+                            pool,
+                            file);
+
+        // the first byte of a line, the last of a line (which the
+        // conversion drops), one in the middle of the last line, and a
+        // change to the padding only
+
+        uint8_t *last = pixels + ((sink.height - 1) * pitch);
+
+        pixels[3 * pitch] ^= 0xFF;
+        pixels[(8 * pitch) + (sink.width * bytesPerPixel) - 1] ^= 0xFF;
+        last[(sink.width / 2) * bytesPerPixel] ^= 0xFF;
+        pixels[(13 * pitch) + pitch - 1] ^= 0xFF;
+
+        expectedRows(&sink, pixels, pitch, second);
+
+        passed = checkWrite(name,
+                            "changed lines",
+                            &sink,
+                            pixels,
+                            pitch,
+                            second,
+                            first,
+                            pool,
+                            file)
+              && passed;
+
+        passed = checkWrite(name,
+                            "same frame",
+                            &sink,
+                            pixels,
+                            pitch,
+                            second,
+                            second,
+                            pool,
+                            file)
+              && passed;
+
+        framebufferSinkReset(&sink);
+
+        passed = checkWrite(name,
+                            "after reset",
+                            &sink,
+                            pixels,
+                            pitch,
+                            second,
+                            NULL,
+                            pool,
+                            file)
+              && passed;
+    }
+
+    free(pixels);
+    free(first);
+    free(second);
+    free(file);
+
+    destroyFramebufferSink(&sink);
+    unlink(path);
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+readLog(
+    FILE *log,
+    uint64_t *bytes)
+{
+    char line[512];
+    bool found = false;
+
+    rewind(log);
+
+    while (fgets(line, sizeof(line), log) != NULL)
+    {
+        const char *message = strstr(line, "info:");
+        uint64_t lineBytes = 0;
+
+        if ((message != NULL)
+            && (strstr(message, "bytes written to the framebuffer") != NULL)
+            && (sscanf(message, "info:%"SCNu64, &lineBytes) == 1))
+        {
+            *bytes = lineBytes;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+//-------------------------------------------------------------------------
+// Run raspi2raspi for a number of frames with the framebuffer in a
+// regular file. The output queue is off, so that every frame captured is
+// presented and the lines written do not depend on timing.
+
+static bool
+testProgram(
+    const char *path,
+    const PROGRAM_TEST_T *test)
+{
+    char file[64];
+
+    if (makeTestFile(file, sizeof(file)) == false)
+    {
+        return false;
+    }
+
+    FILE *log = tmpfile();
+
+    if (log == NULL)
+    {
+        printf("%s: FAILED, %s\n", test->geometry, strerror(errno));
+        unlink(file);
+        return false;
+    }
+
+    char change[32];
+    snprintf(change, sizeof(change), "change=%"PRIu32, test->change);
+
+    char frames[16];
+    snprintf(frames, sizeof(frames), "%"PRIu32, test->frames);
+
+    // the child must not write out what is still buffered here
+
+    fflush(stdout);
+
+    pid_t pid = fork();
+
+    if (pid == -1)
+    {
+        printf("%s: FAILED, fork: %s\n", test->geometry, strerror(errno));
+        fclose(log);
+        unlink(file);
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        if (freopen("/dev/null", "w", stdout) == NULL)
+        {
+            _exit(EXIT_FAILURE);
+        }
+
+        dup2(fileno(log), STDERR_FILENO);
+
+        execl(path,
+              path,
+              "--backend",
+              "software",
+              "--software",
+              change,
+              "--dest-fb",
+              file,
+              "--fb-geometry",
+              test->geometry,
+              "--benchmark",
+              frames,
+              "--output-queue",
+              "0",
+              (char *)NULL);
+
+        fprintf(stderr, "running %s failed: %s\n", path, strerror(errno));
+        _exit(EXIT_FAILURE);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    uint64_t loggedBytes = 0;
+    bool logged = readLog(log, &loggedBytes);
+
+    fclose(log);
+
+    //---------------------------------------------------------------------
+
+    uint32_t rowBytes = test->width * test->bytesPerPixel;
+    size_t size = (size_t)rowBytes * test->height;
+
+    uint32_t distinct = 1;
+    uint32_t pattern = 0;
+
+    if (test->change > 0)
+    {
+        distinct = (test->frames + test->change - 1) / test->change;
+        pattern = (test->frames - 1) / test->change;
+    }
+
+    uint8_t *pixels = malloc(size);
+    uint32_t wrong = 0;
+    bool readBack = false;
+
+    FILE *fp = fopen(file, "rb");
+
+    if ((pixels != NULL) && (fp != NULL))
+    {
+        readBack = (fread(pixels, 1, size, fp) == size);
+    }
+
+    if (readBack)
+    {
+        uint32_t y = 0;
+        for (y = 0 ; y < test->height ; ++y)
+        {
+            uint8_t value = ((pattern * 31) + y) & 0xFF;
+            const uint8_t *line = pixels + (y * rowBytes);
+
+            uint32_t x = 0;
+            for (x = 0 ; x < rowBytes ; ++x)
+            {
+                if (line[x] != value)
+                {
+                    ++wrong;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+
+    free(pixels);
+    unlink(file);
+
+    uint64_t expected = (uint64_t)distinct * size;
+
+    bool passed = WIFEXITED(status)
+               && (WEXITSTATUS(status) == 0)
+               && logged
+               && (loggedBytes == expected)
+               && readBack
+               && (wrong == 0);
+
+    printf("raspi2raspi %s change=%"PRIu32": %"PRIu64" bytes written,"
+           " %"PRIu64" expected, %"PRIu32" lines wrong%s\n",
+           test->geometry,
+           test->change,
+           loggedBytes,
+           expected,
+           wrong,
+           (passed) ? "" : " FAILED");
+
+    if (passed == false)
+    {
+        printf("    exit status %d\n", status);
+    }
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+
+int
+main(
+    int argc,
+    char *argv[])
+{
+    const char *program = basename(argv[0]);
+    const char *raspi2raspi = NULL;
+
+    //---------------------------------------------------------------------
+
+    static const char *sopts = "hr:";
+    static struct option lopts[] =
+    {
+        { "help", no_argument, NULL, 'h' },
+        { "raspi2raspi", required_argument, NULL, 'r' },
+        { NULL, no_argument, NULL, 0 }
+    };
+
+    int opt = 0;
+
+    while ((opt = getopt_long(argc, argv, sopts, lopts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'h':
+
+            printUsage(stdout, program);
+            exit(EXIT_SUCCESS);
+
+            break;
+
+        case 'r':
+
+            raspi2raspi = optarg;
+            break;
+
+        default:
+
+            printUsage(stderr, program);
+            exit(EXIT_FAILURE);
+
+            break;
+        }
+    }
+
+    //---------------------------------------------------------------------
+
+    WORKER_POOL_T pool;
+
+    if (initWorkerPool(&pool, TEST_THREADS, TEST_STRIPES, 1) == false)
+    {
+        printf("FAILED, cannot start the worker pool\n");
+        exit(EXIT_FAILURE);
+    }
+
+    bool passed = true;
+
+    size_t i = 0;
+    for (i = 0 ; i < COUNT_OF(sinkTests) ; ++i)
+    {
+        if (testSink(&(sinkTests[i]), NULL) == false)
+        {
+            passed = false;
+        }
+
+        if (testSink(&(sinkTests[i]), &pool) == false)
+        {
+            passed = false;
+        }
+    }
+
+    destroyWorkerPool(&pool);
+
+    if (raspi2raspi != NULL)
+    {
+        for (i = 0 ; i < COUNT_OF(programTests) ; ++i)
+        {
+            if (testProgram(raspi2raspi, &(programTests[i])) == false)
+            {
+                passed = false;
+            }
+        }
+    }
+
+    return (passed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
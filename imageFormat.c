@@ -0,0 +1,123 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <strings.h>
+
+#include "imageFormat.h"
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    const char *name;
+    VC_IMAGE_TYPE_T type;
+    uint32_t bytesPerPixel;
+} IMAGE_FORMAT_T;
+
+static const IMAGE_FORMAT_T imageFormats[] =
+{
+    { "rgb565", VC_IMAGE_RGB565, 2 },
+    { "rgb888", VC_IMAGE_RGB888, 3 },
+    { "rgba32", VC_IMAGE_RGBA32, 4 },
+    { "rgbx32", VC_IMAGE_RGBX32, 4 }
+};
+
+#define IMAGE_FORMAT_COUNT (sizeof(imageFormats) / sizeof(imageFormats[0]))
+
+//-------------------------------------------------------------------------
+
+static const IMAGE_FORMAT_T *
+findImageFormat(
+    VC_IMAGE_TYPE_T type)
+{
+    size_t i = 0;
+    for (i = 0 ; i < IMAGE_FORMAT_COUNT ; ++i)
+    {
+        if (imageFormats[i].type == type)
+        {
+            return &(imageFormats[i]);
+        }
+    }
+
+    return NULL;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+imageFormatFromName(
+    const char *name,
+    VC_IMAGE_TYPE_T *type)
+{
+    size_t i = 0;
+    for (i = 0 ; i < IMAGE_FORMAT_COUNT ; ++i)
+    {
+        if (strcasecmp(imageFormats[i].name, name) == 0)
+        {
+            *type = imageFormats[i].type;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//-------------------------------------------------------------------------
+
+const char *
+imageFormatName(
+    VC_IMAGE_TYPE_T type)
+{
+    const IMAGE_FORMAT_T *format = findImageFormat(type);
+
+    return (format != NULL) ? format->name : "unknown";
+}
+
+//-------------------------------------------------------------------------
+
+uint32_t
+imageFormatBytesPerPixel(
+    VC_IMAGE_TYPE_T type)
+{
+    const IMAGE_FORMAT_T *format = findImageFormat(type);
+
+    return (format != NULL) ? format->bytesPerPixel : 4;
+}
+
+//-------------------------------------------------------------------------
+// The pitch of the buffer used to read back a resource of this width.
+
+uint32_t
+imageFormatPitch(
+    VC_IMAGE_TYPE_T type,
+    uint32_t width)
+{
+    return ALIGN_TO_16(width) * imageFormatBytesPerPixel(type);
+}
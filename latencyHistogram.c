@@ -0,0 +1,161 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <string.h>
+
+#include "latencyHistogram.h"
+
+//-------------------------------------------------------------------------
+
+static uint32_t
+latencyHistogramBucket(
+    uint64_t value)
+{
+    if (value < 2 * LATENCY_HISTOGRAM_SUB_BUCKETS)
+    {
+        return value;
+    }
+
+    // value >> shift is in [SUB_BUCKETS, 2 * SUB_BUCKETS), so consecutive
+    // powers of two map to consecutive runs of SUB_BUCKETS buckets.
+
+    uint32_t shift = (63 - __builtin_clzll(value))
+                   - LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+
+    return (shift * LATENCY_HISTOGRAM_SUB_BUCKETS) + (value >> shift);
+}
+
+//-------------------------------------------------------------------------
+// The largest value that falls into the bucket.
+
+static uint64_t
+latencyHistogramBucketValue(
+    uint32_t bucket)
+{
+    if (bucket < 2 * LATENCY_HISTOGRAM_SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    uint32_t shift = (bucket / LATENCY_HISTOGRAM_SUB_BUCKETS) - 1;
+    uint64_t mantissa = (bucket % LATENCY_HISTOGRAM_SUB_BUCKETS)
+                      + LATENCY_HISTOGRAM_SUB_BUCKETS;
+
+    return ((mantissa + 1) << shift) - 1;
+}
+
+//-------------------------------------------------------------------------
+
+void
+initLatencyHistogram(
+    LATENCY_HISTOGRAM_T *histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+//-------------------------------------------------------------------------
+
+void
+latencyHistogramAdd(
+    LATENCY_HISTOGRAM_T *histogram,
+    int64_t value)
+{
+    if (value < 0)
+    {
+        value = 0;
+    }
+
+    ++(histogram->buckets[latencyHistogramBucket(value)]);
+    ++(histogram->count);
+
+    if (value > histogram->max)
+    {
+        histogram->max = value;
+    }
+}
+
+//-------------------------------------------------------------------------
+// Add the values of another histogram to this one.
+
+void
+latencyHistogramMerge(
+    LATENCY_HISTOGRAM_T *histogram,
+    const LATENCY_HISTOGRAM_T *other)
+{
+    uint32_t i = 0;
+    for (i = 0 ; i < LATENCY_HISTOGRAM_BUCKETS ; ++i)
+    {
+        histogram->buckets[i] += other->buckets[i];
+    }
+
+    histogram->count += other->count;
+
+    if (other->max > histogram->max)
+    {
+        histogram->max = other->max;
+    }
+}
+
+//-------------------------------------------------------------------------
+// Returns the value below which the given percentage of the values fall,
+// or zero if the histogram is empty.
+
+int64_t
+latencyHistogramPercentile(
+    const LATENCY_HISTOGRAM_T *histogram,
+    double percentile)
+{
+    if (histogram->count == 0)
+    {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)((percentile / 100.0) * histogram->count);
+
+    if (rank >= histogram->count)
+    {
+        rank = histogram->count - 1;
+    }
+
+    uint64_t seen = 0;
+
+    uint32_t i = 0;
+    for (i = 0 ; i < LATENCY_HISTOGRAM_BUCKETS ; ++i)
+    {
+        seen += histogram->buckets[i];
+
+        if (seen > rank)
+        {
+            int64_t value = latencyHistogramBucketValue(i);
+
+            return (value < histogram->max) ? value : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
@@ -0,0 +1,79 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+//-------------------------------------------------------------------------
+
+#include <stdint.h>
+
+//-------------------------------------------------------------------------
+// Log-linear histogram of nanosecond durations. Values below 32 have a
+// bucket each; above that, every power of two is split into 16 buckets,
+// so a reported value is within about 6% of the real one. The buckets
+// cover the whole int64_t range in a fixed array, so adding a value never
+// allocates.
+
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS 4
+#define LATENCY_HISTOGRAM_SUB_BUCKETS (1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS)
+#define LATENCY_HISTOGRAM_BUCKETS \
+    ((64 - LATENCY_HISTOGRAM_SUB_BUCKET_BITS) * LATENCY_HISTOGRAM_SUB_BUCKETS)
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    uint32_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    int64_t max;
+} LATENCY_HISTOGRAM_T;
+
+//-------------------------------------------------------------------------
+
+void
+initLatencyHistogram(
+    LATENCY_HISTOGRAM_T *histogram);
+
+void
+latencyHistogramAdd(
+    LATENCY_HISTOGRAM_T *histogram,
+    int64_t value);
+
+void
+latencyHistogramMerge(
+    LATENCY_HISTOGRAM_T *histogram,
+    const LATENCY_HISTOGRAM_T *other);
+
+int64_t
+latencyHistogramPercentile(
+    const LATENCY_HISTOGRAM_T *histogram,
+    double percentile);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,163 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef HAVE_LIBBSD
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/file.h>
+
+#include "pidFile.h"
+
+//-------------------------------------------------------------------------
+
+struct pidfh
+{
+    int fd;
+    char *path;
+};
+
+//-------------------------------------------------------------------------
+
+struct pidfh *
+pidfile_open(
+    const char *path,
+    mode_t mode,
+    pid_t *pidptr)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, mode);
+
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1)
+    {
+        int error = errno;
+
+        if ((error == EWOULDBLOCK) && (pidptr != NULL))
+        {
+            char buffer[24];
+            ssize_t length = pread(fd, buffer, sizeof(buffer) - 1, 0);
+
+            *pidptr = -1;
+
+            if (length > 0)
+            {
+                buffer[length] = '\0';
+                *pidptr = (pid_t)strtol(buffer, NULL, 10);
+            }
+
+            error = EEXIST;
+        }
+
+        close(fd);
+        errno = error;
+
+        return NULL;
+    }
+
+    struct pidfh *pfh = malloc(sizeof(*pfh));
+
+    if (pfh != NULL)
+    {
+        pfh->path = strdup(path);
+    }
+
+    if ((pfh == NULL) || (pfh->path == NULL))
+    {
+        free(pfh);
+        unlink(path);
+        close(fd);
+        errno = ENOMEM;
+
+        return NULL;
+    }
+
+    pfh->fd = fd;
+
+    return pfh;
+}
+
+//-------------------------------------------------------------------------
+
+int
+pidfile_write(
+    struct pidfh *pfh)
+{
+    if (pfh == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    char buffer[24];
+    int length = snprintf(buffer,
+                          sizeof(buffer),
+                          "%jd\n",
+                          (intmax_t)getpid());
+
+    if ((ftruncate(pfh->fd, 0) == -1) ||
+        (pwrite(pfh->fd, buffer, length, 0) != length))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+//-------------------------------------------------------------------------
+
+int
+pidfile_remove(
+    struct pidfh *pfh)
+{
+    if (pfh == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int result = unlink(pfh->path);
+
+    close(pfh->fd);
+    free(pfh->path);
+    free(pfh);
+
+    return result;
+}
+
+//-------------------------------------------------------------------------
+
+#endif
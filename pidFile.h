@@ -0,0 +1,67 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef PID_FILE_H
+#define PID_FILE_H
+
+//-------------------------------------------------------------------------
+// PID files come from libbsd when it is available. Otherwise a small
+// replacement with the same interface is used: the file is locked with
+// flock(2), so a second instance finds it locked and gets the PID of the
+// first.
+
+#ifdef HAVE_LIBBSD
+
+#include <bsd/libutil.h>
+
+#else
+
+#include <sys/types.h>
+
+//-------------------------------------------------------------------------
+
+struct pidfh;
+
+struct pidfh *
+pidfile_open(
+    const char *path,
+    mode_t mode,
+    pid_t *pidptr);
+
+int
+pidfile_write(
+    struct pidfh *pfh);
+
+int
+pidfile_remove(
+    struct pidfh *pfh);
+
+#endif
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,746 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "frameRing.h"
+#include "imageFormat.h"
+#include "pipeSink.h"
+
+//-------------------------------------------------------------------------
+
+#define PIPE_SINK_POLL_MILLISECONDS 100
+#define PIPE_SINK_MAX_IOVECS 64
+
+static const char frameMarker[] = "FRAME\n";
+
+//-------------------------------------------------------------------------
+
+static const char *pipeFormatNames[] =
+{
+    "raw",
+    "y4m"
+};
+
+#define PIPE_FORMAT_COUNT \
+    (sizeof(pipeFormatNames) / sizeof(pipeFormatNames[0]))
+
+//-------------------------------------------------------------------------
+
+bool
+pipeFormatFromName(
+    const char *name,
+    PIPE_FORMAT_T *format)
+{
+    size_t i = 0;
+    for (i = 0 ; i < PIPE_FORMAT_COUNT ; ++i)
+    {
+        if (strcasecmp(pipeFormatNames[i], name) == 0)
+        {
+            *format = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//-------------------------------------------------------------------------
+
+const char *
+pipeFormatName(
+    PIPE_FORMAT_T format)
+{
+    return (format < PIPE_FORMAT_COUNT)
+         ? pipeFormatNames[format]
+         : "unknown";
+}
+
+//-------------------------------------------------------------------------
+// The ffmpeg -pix_fmt of the raw frames written for a snapshot type.
+
+const char *
+pipeSinkRawPixelFormat(
+    VC_IMAGE_TYPE_T type)
+{
+    switch (type)
+    {
+    case VC_IMAGE_RGB565:
+
+        return "rgb565le";
+
+    case VC_IMAGE_RGB888:
+
+        return "rgb24";
+
+    case VC_IMAGE_RGBX32:
+
+        return "rgb0";
+
+    default:
+
+        return "rgba";
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static size_t
+roundUpToPage(
+    size_t size)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    return (size + page - 1) & ~(page - 1);
+}
+
+//-------------------------------------------------------------------------
+// How many frames of bufferSize must be written after a frame before the
+// reader must have consumed it.
+
+static uint32_t
+framesFillingPipe(
+    const PIPE_SINK_T *sink,
+    int pipeSize)
+{
+    return (pipeSize / sink->bufferSize) + 1;
+}
+
+//-------------------------------------------------------------------------
+// Wait for the reader to make room in the pipe. Returns false if it has
+// not by the time the sink is closing, so that a stalled reader can not
+// hold up the exit.
+
+static bool
+waitForPipe(
+    PIPE_SINK_T *sink)
+{
+    struct pollfd fds = { sink->fd, POLLOUT, 0 };
+
+    while (poll(&fds, 1, PIPE_SINK_POLL_MILLISECONDS) == 0)
+    {
+        if (sink->closing)
+        {
+            errno = ETIMEDOUT;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Write all of the data described by iov, with vmsplice if splice is set
+// and it can be used (the data must then stay untouched until the reader
+// has consumed it), and writev otherwise.
+
+static bool
+sendPipeData(
+    PIPE_SINK_T *sink,
+    struct iovec *iov,
+    int count,
+    bool splice)
+{
+    while (count > 0)
+    {
+        ssize_t sent = splice
+                     ? vmsplice(sink->fd, iov, count, 0)
+                     : writev(sink->fd, iov, count);
+
+        if (sent == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            if (errno == EAGAIN)
+            {
+                if (waitForPipe(sink) == false)
+                {
+                    return false;
+                }
+
+                continue;
+            }
+
+            if (splice && ((errno == EINVAL) || (errno == ENOSYS)))
+            {
+                sink->useVmsplice = false;
+                splice = false;
+                continue;
+            }
+
+            return false;
+        }
+
+        while ((count > 0) && ((size_t)sent >= iov->iov_len))
+        {
+            sent -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+
+        if (count > 0)
+        {
+            iov->iov_base = (uint8_t *)iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+closePipeSinkFile(
+    PIPE_SINK_T *sink)
+{
+    if (sink->fd != -1)
+    {
+        // a duplicate of standard output shares its flags with the
+        // process that started this one
+
+        if (sink->originalFlags != -1)
+        {
+            fcntl(sink->fd, F_SETFL, sink->originalFlags);
+            sink->originalFlags = -1;
+        }
+
+        close(sink->fd);
+        sink->fd = -1;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+freePipeSinkBuffers(
+    PIPE_SINK_T *sink)
+{
+    uint32_t i = 0;
+    for (i = 0 ; i < sink->bufferCount ; ++i)
+    {
+        free(sink->buffers[i]);
+        sink->buffers[i] = NULL;
+    }
+
+    sink->bufferCount = 0;
+}
+
+//-------------------------------------------------------------------------
+// Get a newly opened file ready for frames: find out whether it is a pipe
+// (and so whether vmsplice can be used), allocate enough buffers for the
+// pipe if frames are converted, or check the caller holds enough raw
+// frames for it, and start the stream.
+
+static bool
+startPipeSinkStream(
+    PIPE_SINK_T *sink)
+{
+    struct stat info;
+
+    if (fstat(sink->fd, &info) == -1)
+    {
+        return false;
+    }
+
+    sink->isPipe = S_ISFIFO(info.st_mode);
+    sink->useVmsplice = false;
+
+    // raw frames are written from the caller's frame, so need no buffer
+
+    uint32_t bufferCount = (sink->format == PIPE_FORMAT_Y4M) ? 1 : 0;
+
+    if (sink->isPipe)
+    {
+        int flags = fcntl(sink->fd, F_GETFL);
+
+        if (flags == -1)
+        {
+            return false;
+        }
+
+        if ((flags & O_NONBLOCK) == 0)
+        {
+            if (fcntl(sink->fd, F_SETFL, flags | O_NONBLOCK) == -1)
+            {
+                return false;
+            }
+
+            sink->originalFlags = flags;
+        }
+    }
+
+    if (sink->isPipe)
+    {
+        // A buffer is reused once the frames written after it fill more
+        // than the pipe, by which time the reader must have consumed it.
+
+        int pipeSize = fcntl(sink->fd, F_GETPIPE_SZ);
+        uint32_t frames = (pipeSize > 0)
+                        ? framesFillingPipe(sink, pipeSize)
+                        : UINT32_MAX;
+
+        if (bufferCount > 0)
+        {
+            if (frames < PIPE_SINK_MAX_BUFFERS)
+            {
+                sink->useVmsplice = true;
+                bufferCount = frames + 1;
+            }
+        }
+        else if (frames <= sink->held)
+        {
+            sink->useVmsplice = true;
+        }
+    }
+
+    freePipeSinkBuffers(sink);
+
+    uint32_t i = 0;
+    for (i = 0 ; i < bufferCount ; ++i)
+    {
+        void *buffer = NULL;
+
+        if (posix_memalign(&buffer,
+                           sysconf(_SC_PAGESIZE),
+                           sink->bufferSize) != 0)
+        {
+            errno = ENOMEM;
+            return false;
+        }
+
+        sink->buffers[i] = buffer;
+        sink->bufferCount = i + 1;
+    }
+
+    sink->nextBuffer = 0;
+
+    if (sink->format == PIPE_FORMAT_Y4M)
+    {
+        char header[128];
+        int length = snprintf(header,
+                              sizeof(header),
+                              "YUV4MPEG2 W%d H%d F%ld:1000 Ip A1:1"
+                              " C420jpeg\n",
+                              sink->width,
+                              sink->height,
+                              lround(sink->rate * 1000.0));
+
+        struct iovec iov = { header, length };
+
+        if (sendPipeData(sink, &iov, 1, false) == false)
+        {
+            return false;
+        }
+
+        sink->bytes += length;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Open a FIFO, if it has a reader. The open does not block, so that the
+// capture's output thread can still be stopped while there is no reader.
+
+static bool
+openPipeSinkFifo(
+    PIPE_SINK_T *sink)
+{
+    if (sink->isFifo == false)
+    {
+        errno = EPIPE;
+        return false;
+    }
+
+    sink->fd = open(sink->path, O_WRONLY | O_NONBLOCK);
+
+    if (sink->fd == -1)
+    {
+        return false;
+    }
+
+    if (startPipeSinkStream(sink) == false)
+    {
+        int error = errno;
+        closePipeSinkFile(sink);
+        errno = error;
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Open the output. path is "-" for standard output. Returns false, with
+// errno set, on failure.
+
+bool
+initPipeSink(
+    PIPE_SINK_T *sink,
+    const char *path,
+    PIPE_FORMAT_T format,
+    VC_IMAGE_TYPE_T type,
+    uint32_t width,
+    uint32_t height,
+    double rate)
+{
+    memset(sink, 0, sizeof(*sink));
+
+    sink->fd = -1;
+    sink->originalFlags = -1;
+    sink->path = path;
+    sink->format = format;
+    sink->type = type;
+    sink->width = width;
+    sink->height = height;
+    sink->bytesPerPixel = imageFormatBytesPerPixel(type);
+    sink->pitch = imageFormatPitch(type, width);
+    sink->rate = rate;
+
+    if (format == PIPE_FORMAT_Y4M)
+    {
+        size_t chroma = ((width + 1) / 2) * ((height + 1) / 2);
+
+        sink->frameSize = strlen(frameMarker)
+                        + (width * height)
+                        + (2 * chroma);
+    }
+    else
+    {
+        sink->frameSize = width * height * sink->bytesPerPixel;
+    }
+
+    sink->bufferSize = roundUpToPage(sink->frameSize);
+
+    // Unpadded raw frames can be spliced from the caller's frame if it
+    // holds enough of them for the pipe, which is assumed to be the
+    // default size unless it is already open.
+
+    if ((format == PIPE_FORMAT_RAW)
+        && (sink->pitch == width * sink->bytesPerPixel))
+    {
+        int pipeSize = (strcmp(path, "-") == 0)
+                     ? fcntl(STDOUT_FILENO, F_GETPIPE_SZ)
+                     : -1;
+
+        if (pipeSize <= 0)
+        {
+            pipeSize = PIPE_SINK_DEFAULT_PIPE_SIZE;
+        }
+
+        uint32_t held = framesFillingPipe(sink, pipeSize);
+
+        if (held <= FRAME_RING_MAX_HELD)
+        {
+            sink->held = held;
+        }
+    }
+
+    //---------------------------------------------------------------------
+
+    struct stat info;
+
+    if (strcmp(path, "-") == 0)
+    {
+        sink->fd = dup(STDOUT_FILENO);
+    }
+    else if ((stat(path, &info) == 0) && S_ISFIFO(info.st_mode))
+    {
+        // opened when it has a reader
+        sink->isFifo = true;
+        return true;
+    }
+    else
+    {
+        sink->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    if (sink->fd == -1)
+    {
+        return false;
+    }
+
+    if (startPipeSinkStream(sink) == false)
+    {
+        int error = errno;
+        destroyPipeSink(sink);
+        errno = error;
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    PIPE_SINK_T *sink;
+    const uint8_t *pixels;
+    uint8_t *planes;
+} PIPE_SINK_JOB_T;
+
+//-------------------------------------------------------------------------
+
+static void
+readPixel(
+    const PIPE_SINK_T *sink,
+    const uint8_t *pixel,
+    int32_t *r,
+    int32_t *g,
+    int32_t *b)
+{
+    if (sink->bytesPerPixel == 2)
+    {
+        uint32_t value = pixel[0] | (pixel[1] << 8);
+
+        *r = ((value >> 8) & 0xF8) | (value >> 13);
+        *g = ((value >> 3) & 0xFC) | ((value >> 9) & 0x03);
+        *b = ((value << 3) & 0xF8) | ((value >> 2) & 0x07);
+    }
+    else
+    {
+        *r = pixel[0];
+        *g = pixel[1];
+        *b = pixel[2];
+    }
+}
+
+//-------------------------------------------------------------------------
+// Convert one stripe of rows to I420 (full range BT.601, as C420jpeg
+// expects), averaging each 2x2 block for the chroma. Stripes start on an
+// even row.
+
+static void
+convertI420Stripe(
+    void *arg,
+    uint32_t stripe,
+    uint32_t stripes)
+{
+    PIPE_SINK_JOB_T *job = arg;
+    const PIPE_SINK_T *sink = job->sink;
+
+    uint32_t width = sink->width;
+    uint32_t height = sink->height;
+    uint32_t chromaWidth = (width + 1) / 2;
+    uint32_t chromaHeight = (height + 1) / 2;
+
+    uint8_t *yPlane = job->planes;
+    uint8_t *uPlane = yPlane + (width * height);
+    uint8_t *vPlane = uPlane + (chromaWidth * chromaHeight);
+
+    uint32_t first = 0;
+    uint32_t end = 0;
+
+    workerPoolStripe(stripe, stripes, height, 2, &first, &end);
+
+    uint32_t y = 0;
+    for (y = first ; y < end ; y += 2)
+    {
+        uint8_t *u = uPlane + ((y / 2) * chromaWidth);
+        uint8_t *v = vPlane + ((y / 2) * chromaWidth);
+
+        uint32_t x = 0;
+        for (x = 0 ; x < width ; x += 2)
+        {
+            int32_t rSum = 0;
+            int32_t gSum = 0;
+            int32_t bSum = 0;
+
+            // the last row and column are repeated if the size is odd
+
+            uint32_t dy = 0;
+            for (dy = 0 ; dy < 2 ; ++dy)
+            {
+                uint32_t row = (y + dy < height) ? y + dy : height - 1;
+
+                uint32_t dx = 0;
+                for (dx = 0 ; dx < 2 ; ++dx)
+                {
+                    uint32_t column = (x + dx < width) ? x + dx : width - 1;
+
+                    int32_t r = 0;
+                    int32_t g = 0;
+                    int32_t b = 0;
+
+                    readPixel(sink,
+                              job->pixels
+                              + (row * sink->pitch)
+                              + (column * sink->bytesPerPixel),
+                              &r,
+                              &g,
+                              &b);
+
+                    yPlane[(row * width) + column]
+                        = ((77 * r) + (150 * g) + (29 * b) + 128) >> 8;
+
+                    rSum += r;
+                    gSum += g;
+                    bSum += b;
+                }
+            }
+
+            int32_t r = (rSum + 2) >> 2;
+            int32_t g = (gSum + 2) >> 2;
+            int32_t b = (bSum + 2) >> 2;
+
+            u[x / 2] = (((-43 * r) - (85 * g) + (128 * b) + 128) >> 8) + 128;
+            v[x / 2] = (((128 * r) - (107 * g) - (21 * b) + 128) >> 8) + 128;
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+// Write raw rows straight from the frame, without the padding at the end
+// of each.
+
+static bool
+sendPipeRows(
+    PIPE_SINK_T *sink,
+    const uint8_t *pixels)
+{
+    struct iovec iov[PIPE_SINK_MAX_IOVECS];
+    uint32_t rowBytes = sink->width * sink->bytesPerPixel;
+
+    uint32_t y = 0;
+    while (y < sink->height)
+    {
+        int count = 0;
+        for (count = 0
+             ; (count < PIPE_SINK_MAX_IOVECS) && (y < sink->height)
+             ; ++count, ++y)
+        {
+            iov[count].iov_base = (uint8_t *)pixels + (y * sink->pitch);
+            iov[count].iov_len = rowBytes;
+        }
+
+        if (sendPipeData(sink, iov, count, false) == false)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Write a frame (read back with the snapshot's pitch). Y4M conversion is
+// done in stripes on the pool if there is one. A raw frame may be
+// spliced, so must not be changed until held more frames have been
+// written. Returns false, with errno set, if the frame could not be
+// written; the output is then closed, and for a FIFO opened again when it
+// next has a reader.
+
+bool
+pipeSinkWrite(
+    PIPE_SINK_T *sink,
+    const uint8_t *pixels,
+    WORKER_POOL_T *pool)
+{
+    if ((sink->fd == -1) && (openPipeSinkFifo(sink) == false))
+    {
+        return false;
+    }
+
+    bool sent = false;
+
+    if (sink->format == PIPE_FORMAT_Y4M)
+    {
+        uint8_t *buffer = sink->buffers[sink->nextBuffer];
+        sink->nextBuffer = (sink->nextBuffer + 1) % sink->bufferCount;
+
+        struct iovec iov = { buffer, sink->frameSize };
+
+        memcpy(buffer, frameMarker, strlen(frameMarker));
+
+        PIPE_SINK_JOB_T job = { sink, pixels, buffer + strlen(frameMarker) };
+        workerPoolRun(pool, convertI420Stripe, &job);
+
+        sent = sendPipeData(sink, &iov, 1, sink->useVmsplice);
+    }
+    else if (sink->useVmsplice)
+    {
+        struct iovec iov = { (uint8_t *)pixels, sink->frameSize };
+
+        sent = sendPipeData(sink, &iov, 1, true);
+    }
+    else
+    {
+        sent = sendPipeRows(sink, pixels);
+    }
+
+    if (sent == false)
+    {
+        int error = errno;
+        closePipeSinkFile(sink);
+        errno = error;
+        return false;
+    }
+
+    sink->bytes += sink->frameSize;
+    ++(sink->frames);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Stop waiting for a stalled reader, so that the output can be stopped.
+
+void
+pipeSinkClosing(
+    PIPE_SINK_T *sink)
+{
+    sink->closing = true;
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyPipeSink(
+    PIPE_SINK_T *sink)
+{
+    closePipeSinkFile(sink);
+    freePipeSinkBuffers(sink);
+}
@@ -0,0 +1,134 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef PIPE_SINK_H
+#define PIPE_SINK_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "displayTypes.h"
+
+#include "workerPool.h"
+
+//-------------------------------------------------------------------------
+// A stream of captured frames written to standard output, a FIFO or a
+// file, e.g. for recording with ffmpeg. Frames are either raw (the
+// snapshot's pixels, without the padding at the end of each row) or
+// YUV4MPEG2, converted to I420 on the CPU. On a pipe, frames are passed
+// with vmsplice, which hands their pages to the pipe instead of copying
+// them through the kernel, so a frame must stay untouched until the
+// frames after it hold more than the pipe can, when the reader must have
+// consumed it. Converted frames are built in a rotation of page aligned
+// buffers for this. Raw frames are spliced from the caller's frame, which
+// it keeps for held more frames (zero if the rows are padded, or the
+// frames are converted); the size of a FIFO's pipe is not known until it
+// is opened, so the default size is assumed, and a bigger pipe is written
+// with writev. Raw rows with padding, other files, and kernels without
+// vmsplice, are written with writev. A FIFO is opened when it first has a
+// reader, and again if the reader goes away.
+
+#define PIPE_SINK_MAX_BUFFERS 32
+#define PIPE_SINK_DEFAULT_PIPE_SIZE 65536
+
+typedef enum
+{
+    PIPE_FORMAT_RAW,
+    PIPE_FORMAT_Y4M
+} PIPE_FORMAT_T;
+
+typedef struct
+{
+    const char *path;
+    int fd;
+    int originalFlags;
+    bool isFifo;
+    bool isPipe;
+    bool useVmsplice;
+    volatile bool closing;
+    PIPE_FORMAT_T format;
+    VC_IMAGE_TYPE_T type;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerPixel;
+    uint32_t pitch;
+    double rate;
+    size_t frameSize;
+    size_t bufferSize;
+    uint32_t held;
+    uint8_t *buffers[PIPE_SINK_MAX_BUFFERS];
+    uint32_t bufferCount;
+    uint32_t nextBuffer;
+    uint64_t bytes;
+    uint64_t frames;
+} PIPE_SINK_T;
+
+//-------------------------------------------------------------------------
+
+bool
+pipeFormatFromName(
+    const char *name,
+    PIPE_FORMAT_T *format);
+
+const char *
+pipeFormatName(
+    PIPE_FORMAT_T format);
+
+const char *
+pipeSinkRawPixelFormat(
+    VC_IMAGE_TYPE_T type);
+
+bool
+initPipeSink(
+    PIPE_SINK_T *sink,
+    const char *path,
+    PIPE_FORMAT_T format,
+    VC_IMAGE_TYPE_T type,
+    uint32_t width,
+    uint32_t height,
+    double rate);
+
+bool
+pipeSinkWrite(
+    PIPE_SINK_T *sink,
+    const uint8_t *pixels,
+    WORKER_POOL_T *pool);
+
+void
+pipeSinkClosing(
+    PIPE_SINK_T *sink);
+
+void
+destroyPipeSink(
+    PIPE_SINK_T *sink);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,682 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+//-------------------------------------------------------------------------
+// Runs raspi2raspi on the software backend with its output pipe on
+// standard output, through a real pipe to this program, for each of a
+// few pixel formats, sizes and stream formats. Every frame read is
+// compared with a scalar reference of what the backend's pattern should
+// look like (converted to I420 for YUV4MPEG2), the frames must follow
+// each other without a gap (the output blocks rather than dropping), the
+// stream must end on a frame boundary, and the frames and bytes read
+// after the header must be those raspi2raspi logs as written by its
+// output thread, with vmsplice or writev as expected.
+
+#define DEFAULT_FRAMES 30
+
+#define PIPE_POLL_MILLISECONDS 5000
+
+static const char frameMarker[] = "FRAME\n";
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    const char *format;
+    uint32_t bytesPerPixel;
+    const char *pipeFormat;
+    uint32_t width;
+    uint32_t height;
+    const char *method;
+} PIPE_TEST_T;
+
+// Raw rows are only spliced without padding (a width that is a multiple
+// of 16). The odd sizes check the padding is left out, and that the last
+// row and column are repeated for the chroma.
+
+static const PIPE_TEST_T pipeTests[] =
+{
+    { "rgba32", 4, "raw", 320, 240, "vmsplice" },
+    { "rgb888", 3, "raw", 100, 75, "writev" },
+    { "rgb565", 2, "y4m", 100, 75, "vmsplice" },
+    { "rgba32", 4, "y4m", 320, 240, "vmsplice" }
+};
+
+#define COUNT_OF(array) (sizeof(array) / sizeof(array[0]))
+
+//-------------------------------------------------------------------------
+
+void
+printUsage(
+    FILE *fp,
+    const char *name)
+{
+    fprintf(fp, "\n");
+    fprintf(fp, "Usage: %s <options>\n", name);
+    fprintf(fp, "\n");
+    fprintf(fp, "    --frames <number> - frames read before stopping");
+    fprintf(fp, " raspi2raspi (default %d)\n", DEFAULT_FRAMES);
+    fprintf(fp, "    --raspi2raspi <path> - the program to test\n");
+    fprintf(fp, "    --help - print usage and exit\n");
+    fprintf(fp, "\n");
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+isY4m(
+    const PIPE_TEST_T *test)
+{
+    return strcmp(test->pipeFormat, "y4m") == 0;
+}
+
+//-------------------------------------------------------------------------
+
+static size_t
+frameSize(
+    const PIPE_TEST_T *test)
+{
+    if (isY4m(test))
+    {
+        size_t chroma = ((test->width + 1) / 2) * ((test->height + 1) / 2);
+
+        return strlen(frameMarker) + (test->width * test->height) + 2 * chroma;
+    }
+
+    return test->width * test->height * test->bytesPerPixel;
+}
+
+//-------------------------------------------------------------------------
+// The colour of a pixel whose bytes all hold value, with each RGB565
+// component widened by repeating its top bits.
+
+static void
+pixelColour(
+    const PIPE_TEST_T *test,
+    uint8_t value,
+    int32_t *r,
+    int32_t *g,
+    int32_t *b)
+{
+    if (test->bytesPerPixel == 2)
+    {
+        uint32_t pixel = value | (value << 8);
+        uint32_t red = pixel >> 11;
+        uint32_t green = (pixel >> 5) & 0x3F;
+        uint32_t blue = pixel & 0x1F;
+
+        *r = (red << 3) | (red >> 2);
+        *g = (green << 2) | (green >> 4);
+        *b = (blue << 3) | (blue >> 2);
+    }
+    else
+    {
+        *r = value;
+        *g = value;
+        *b = value;
+    }
+}
+
+//-------------------------------------------------------------------------
+// The frame written for a snapshot from the software backend, whose rows
+// are filled with the row number plus a value that changes with each
+// snapshot.
+
+static void
+expectedFrame(
+    const PIPE_TEST_T *test,
+    uint8_t first,
+    uint8_t *frame)
+{
+    uint32_t width = test->width;
+    uint32_t height = test->height;
+
+    if (isY4m(test) == false)
+    {
+        uint32_t rowBytes = width * test->bytesPerPixel;
+
+        uint32_t y = 0;
+        for (y = 0 ; y < height ; ++y)
+        {
+            memset(frame + (y * rowBytes), (first + y) & 0xFF, rowBytes);
+        }
+
+        return;
+    }
+
+    memcpy(frame, frameMarker, strlen(frameMarker));
+
+    uint8_t *yPlane = frame + strlen(frameMarker);
+    uint8_t *uPlane = yPlane + (width * height);
+    uint8_t *vPlane = uPlane + (((width + 1) / 2) * ((height + 1) / 2));
+
+    uint32_t y = 0;
+    for (y = 0 ; y < height ; ++y)
+    {
+        int32_t r = 0;
+        int32_t g = 0;
+        int32_t b = 0;
+
+        pixelColour(test, (first + y) & 0xFF, &r, &g, &b);
+
+        memset(yPlane + (y * width),
+               ((77 * r) + (150 * g) + (29 * b) + 128) >> 8,
+               width);
+    }
+
+    // every pixel of a row is the same, so each 2x2 block is the average
+    // of two rows (the last repeated if the height is odd)
+
+    for (y = 0 ; y < height ; y += 2)
+    {
+        int32_t r0 = 0;
+        int32_t g0 = 0;
+        int32_t b0 = 0;
+        int32_t r1 = 0;
+        int32_t g1 = 0;
+        int32_t b1 = 0;
+
+        uint32_t next = (y + 1 < height) ? y + 1 : y;
+
+        pixelColour(test, (first + y) & 0xFF, &r0, &g0, &b0);
+        pixelColour(test, (first + next) & 0xFF, &r1, &g1, &b1);
+
+        int32_t r = ((2 * (r0 + r1)) + 2) >> 2;
+        int32_t g = ((2 * (g0 + g1)) + 2) >> 2;
+        int32_t b = ((2 * (b0 + b1)) + 2) >> 2;
+
+        uint32_t chromaWidth = (width + 1) / 2;
+
+        memset(uPlane + ((y / 2) * chromaWidth),
+               (((-43 * r) - (85 * g) + (128 * b) + 128) >> 8) + 128,
+               chromaWidth);
+        memset(vPlane + ((y / 2) * chromaWidth),
+               (((128 * r) - (107 * g) - (21 * b) + 128) >> 8) + 128,
+               chromaWidth);
+    }
+}
+
+//-------------------------------------------------------------------------
+// Read size bytes, unless the stream ends first. Returns the number of
+// bytes read, or -1 on an error or if nothing arrives for a while.
+
+static ssize_t
+readStream(
+    int fd,
+    uint8_t *buffer,
+    size_t size)
+{
+    size_t total = 0;
+
+    while (total < size)
+    {
+        struct pollfd fds = { fd, POLLIN, 0 };
+
+        if (poll(&fds, 1, PIPE_POLL_MILLISECONDS) != 1)
+        {
+            return -1;
+        }
+
+        ssize_t length = read(fd, buffer + total, size - total);
+
+        if (length == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return -1;
+        }
+
+        if (length == 0)
+        {
+            break;
+        }
+
+        total += length;
+    }
+
+    return total;
+}
+
+//-------------------------------------------------------------------------
+// Read and check the YUV4MPEG2 header. Returns its length, or 0.
+
+static size_t
+readHeader(
+    const PIPE_TEST_T *test,
+    int fd)
+{
+    char header[128];
+    size_t length = 0;
+
+    while (length < sizeof(header) - 1)
+    {
+        if (readStream(fd, (uint8_t *)header + length, 1) != 1)
+        {
+            return 0;
+        }
+
+        if (header[length++] == '\n')
+        {
+            break;
+        }
+    }
+
+    header[length] = '\0';
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    if ((sscanf(header, "YUV4MPEG2 W%"SCNu32" H%"SCNu32, &width, &height)
+         != 2)
+        || (width != test->width)
+        || (height != test->height)
+        || (strstr(header, " C420jpeg\n") == NULL))
+    {
+        printf("bad header: %s", header);
+        return 0;
+    }
+
+    return length;
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    uint64_t header;
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t mismatched;
+    uint64_t partial;
+} PIPE_READ_T;
+
+//-------------------------------------------------------------------------
+// Read frames until the stream ends, stopping raspi2raspi once enough
+// have been read. Each frame must be the one for the snapshot after the
+// last.
+
+static bool
+readFrames(
+    const PIPE_TEST_T *test,
+    int fd,
+    pid_t pid,
+    int frames,
+    PIPE_READ_T *result)
+{
+    size_t size = frameSize(test);
+    uint8_t *frame = malloc(size);
+    uint8_t *expected = malloc(size);
+
+    if ((frame == NULL) || (expected == NULL))
+    {
+        free(frame);
+        free(expected);
+        printf("out of memory\n");
+        return false;
+    }
+
+    bool passed = true;
+    uint32_t first = 0;
+
+    while (true)
+    {
+        ssize_t length = readStream(fd, frame, size);
+
+        if (length == -1)
+        {
+            printf("reading the pipe failed or timed out\n");
+            passed = false;
+            break;
+        }
+
+        result->bytes += length;
+
+        if ((size_t)length < size)
+        {
+            result->partial = length;
+            break;
+        }
+
+        // the first frame can be for any snapshot, then each one is for
+        // the next
+
+        bool matched = false;
+
+        if (result->frames == 0)
+        {
+            for (first = 0 ; (first < 256) && (matched == false) ; ++first)
+            {
+                expectedFrame(test, first, expected);
+                matched = (memcmp(frame, expected, size) == 0);
+            }
+
+            --first;
+        }
+        else
+        {
+            first = (first + 31) & 0xFF;
+            expectedFrame(test, first, expected);
+            matched = (memcmp(frame, expected, size) == 0);
+        }
+
+        if (matched == false)
+        {
+            ++(result->mismatched);
+        }
+
+        if (++(result->frames) == (uint64_t)frames)
+        {
+            kill(pid, SIGTERM);
+        }
+    }
+
+    free(frame);
+    free(expected);
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+// What raspi2raspi logged it wrote to the pipe.
+
+static bool
+readLog(
+    FILE *log,
+    uint64_t *frames,
+    uint64_t *bytes,
+    char *method,
+    size_t size)
+{
+    char line[256];
+    bool found = false;
+
+    rewind(log);
+
+    while (fgets(line, sizeof(line), log) != NULL)
+    {
+        const char *message = strstr(line, "info:");
+        uint64_t lineFrames = 0;
+        uint64_t lineBytes = 0;
+        char written[16];
+
+        if ((message != NULL)
+            && (sscanf(message,
+                       "info:%"SCNu64" frames, %"SCNu64" bytes written to -"
+                       " (%15[^)])",
+                       &lineFrames,
+                       &lineBytes,
+                       written) == 3))
+        {
+            *frames = lineFrames;
+            *bytes = lineBytes;
+            snprintf(method, size, "%s", written);
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+testPipe(
+    const char *path,
+    const PIPE_TEST_T *test,
+    int frames)
+{
+    int fds[2];
+    FILE *log = tmpfile();
+
+    if ((log == NULL) || (pipe(fds) == -1))
+    {
+        printf("%s %s: FAILED, %s\n",
+               test->pipeFormat,
+               test->format,
+               strerror(errno));
+        return false;
+    }
+
+    char size[32];
+    snprintf(size, sizeof(size), "size=%"PRIu32"x%"PRIu32,
+             test->width,
+             test->height);
+
+    pid_t pid = fork();
+
+    if (pid == -1)
+    {
+        printf("%s %s: FAILED, fork: %s\n",
+               test->pipeFormat,
+               test->format,
+               strerror(errno));
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fileno(log), STDERR_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+
+        execl(path,
+              path,
+              "--backend",
+              "software",
+              "--software",
+              size,
+              "--format",
+              test->format,
+              "--fps",
+              "60",
+              "--output-pipe",
+              "-",
+              "--output-pipe-format",
+              test->pipeFormat,
+              "--output-policy",
+              "block",
+              (char *)NULL);
+
+        fprintf(stderr, "running %s failed: %s\n", path, strerror(errno));
+        _exit(EXIT_FAILURE);
+    }
+
+    close(fds[1]);
+
+    //---------------------------------------------------------------------
+
+    PIPE_READ_T result;
+    memset(&result, 0, sizeof(result));
+
+    bool passed = true;
+
+    if (isY4m(test))
+    {
+        result.header = readHeader(test, fds[0]);
+        passed = (result.header > 0);
+    }
+
+    if (passed)
+    {
+        passed = readFrames(test, fds[0], pid, frames, &result);
+    }
+
+    kill(pid, SIGTERM);
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    uint64_t loggedFrames = 0;
+    uint64_t loggedBytes = 0;
+    char method[16] = "";
+
+    bool logged = readLog(log,
+                          &loggedFrames,
+                          &loggedBytes,
+                          method,
+                          sizeof(method));
+
+    fclose(log);
+
+    passed = passed
+          && WIFEXITED(status)
+          && (WEXITSTATUS(status) == 0)
+          && (result.frames >= (uint64_t)frames)
+          && (result.mismatched == 0)
+          && (result.partial == 0)
+          && logged
+          && (loggedFrames == result.frames)
+          && (loggedBytes == result.bytes)
+          && (strcmp(method, test->method) == 0);
+
+    printf("%s %s %"PRIu32"x%"PRIu32": %"PRIu64" frames, %"PRIu64" bytes"
+           " read, %"PRIu64" frames, %"PRIu64" bytes written (%s)%s\n",
+           test->pipeFormat,
+           test->format,
+           test->width,
+           test->height,
+           result.frames,
+           result.bytes,
+           loggedFrames,
+           loggedBytes,
+           method,
+           (passed) ? "" : " FAILED");
+
+    if (passed == false)
+    {
+        printf("    %"PRIu64" frames not as expected, %"PRIu64" bytes of a"
+               " partial frame, exit status %d\n",
+               result.mismatched,
+               result.partial,
+               status);
+    }
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+
+int
+main(
+    int argc,
+    char *argv[])
+{
+    const char *program = basename(argv[0]);
+    const char *raspi2raspi = NULL;
+
+    int frames = DEFAULT_FRAMES;
+
+    //---------------------------------------------------------------------
+
+    static const char *sopts = "f:hr:";
+    static struct option lopts[] =
+    {
+        { "frames", required_argument, NULL, 'f' },
+        { "help", no_argument, NULL, 'h' },
+        { "raspi2raspi", required_argument, NULL, 'r' },
+        { NULL, no_argument, NULL, 0 }
+    };
+
+    int opt = 0;
+
+    while ((opt = getopt_long(argc, argv, sopts, lopts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+
+            frames = atoi(optarg);
+            break;
+
+        case 'h':
+
+            printUsage(stdout, program);
+            exit(EXIT_SUCCESS);
+
+            break;
+
+        case 'r':
+
+            raspi2raspi = optarg;
+            break;
+
+        default:
+
+            printUsage(stderr, program);
+            exit(EXIT_FAILURE);
+
+            break;
+        }
+    }
+
+    if ((frames < 1) || (raspi2raspi == NULL))
+    {
+        fprintf(stderr, "%s: invalid options\n", program);
+        printUsage(stderr, program);
+        exit(EXIT_FAILURE);
+    }
+
+    //---------------------------------------------------------------------
+
+    // a reader that has gone away must not kill this program
+
+    signal(SIGPIPE, SIG_IGN);
+
+    bool passed = true;
+
+    size_t i = 0;
+    for (i = 0 ; i < COUNT_OF(pipeTests) ; ++i)
+    {
+        if (testPipe(raspi2raspi, &(pipeTests[i]), frames) == false)
+        {
+            passed = false;
+        }
+    }
+
+    return (passed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,2270 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "displayBackend.h"
+#include "displayMonitor.h"
+#include "imageFormat.h"
+#include "pipeline.h"
+#include "syslogUtilities.h"
+
+//-------------------------------------------------------------------------
+
+#define GOVERNOR_HOLD_NANOSECONDS NANOSECONDS_PER_SECOND
+
+#define STATS_PUBLISH_NANOSECONDS (250 * NANOSECONDS_PER_MILLISECOND)
+#define CAPTURE_RATE_NANOSECONDS NANOSECONDS_PER_SECOND
+
+#if MAX_DESTINATIONS > STATS_SEGMENT_MAX_DESTINATIONS
+#error "the statistics file has too few destination slots"
+#endif
+
+#define RECOVERY_ATTEMPTS_PER_TIER 3
+#define RECOVERY_BACKOFF_MIN_NANOSECONDS NANOSECONDS_PER_MILLISECOND
+#define RECOVERY_BACKOFF_MAX_NANOSECONDS (500 * NANOSECONDS_PER_MILLISECOND)
+
+// Displays can be shared between pipelines, so they are opened and closed
+// through a reference counted table. This is mostly used from the main
+// thread, but a pipeline recovering from an error reopens its displays
+// from its own thread, so the table is protected by a mutex.
+
+#define MAX_OPEN_DISPLAYS 16
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    uint32_t displayNumber;
+    DISPMANX_DISPLAY_HANDLE_T display;
+    uint32_t references;
+} OPEN_DISPLAY_T;
+
+static OPEN_DISPLAY_T openDisplays[MAX_OPEN_DISPLAYS];
+static pthread_mutex_t openDisplaysMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Incremented (from a signal handler) to ask every pipeline to log its
+// statistics.
+
+static volatile uint32_t statsRequests = 0;
+
+//-------------------------------------------------------------------------
+
+static DISPMANX_DISPLAY_HANDLE_T
+acquireDisplayLocked(
+    uint32_t displayNumber)
+{
+    OPEN_DISPLAY_T *unused = NULL;
+
+    int i = 0;
+    for (i = 0 ; i < MAX_OPEN_DISPLAYS ; ++i)
+    {
+        OPEN_DISPLAY_T *entry = &(openDisplays[i]);
+
+        if (entry->references == 0)
+        {
+            if (unused == NULL)
+            {
+                unused = entry;
+            }
+        }
+        else if (entry->displayNumber == displayNumber)
+        {
+            ++(entry->references);
+            return entry->display;
+        }
+    }
+
+    if (unused == NULL)
+    {
+        return 0;
+    }
+
+    DISPMANX_DISPLAY_HANDLE_T display
+        = displayBackend()->displayOpen(displayNumber);
+
+    if (display != 0)
+    {
+        unused->displayNumber = displayNumber;
+        unused->display = display;
+        unused->references = 1;
+    }
+
+    return display;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+releaseDisplayLocked(
+    DISPMANX_DISPLAY_HANDLE_T display)
+{
+    int i = 0;
+    for (i = 0 ; i < MAX_OPEN_DISPLAYS ; ++i)
+    {
+        OPEN_DISPLAY_T *entry = &(openDisplays[i]);
+
+        if ((entry->references > 0) && (entry->display == display))
+        {
+            if (--(entry->references) == 0)
+            {
+                displayBackend()->displayClose(display);
+            }
+
+            return;
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static DISPMANX_DISPLAY_HANDLE_T
+acquireDisplay(
+    uint32_t displayNumber)
+{
+    pthread_mutex_lock(&openDisplaysMutex);
+    DISPMANX_DISPLAY_HANDLE_T display = acquireDisplayLocked(displayNumber);
+    pthread_mutex_unlock(&openDisplaysMutex);
+
+    return display;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+releaseDisplay(
+    DISPMANX_DISPLAY_HANDLE_T display)
+{
+    pthread_mutex_lock(&openDisplaysMutex);
+    releaseDisplayLocked(display);
+    pthread_mutex_unlock(&openDisplaysMutex);
+}
+
+//-------------------------------------------------------------------------
+// Close and reopen a display. A display that is shared with another
+// pipeline stays open, and the same handle is returned.
+
+static DISPMANX_DISPLAY_HANDLE_T
+reacquireDisplay(
+    DISPMANX_DISPLAY_HANDLE_T display,
+    uint32_t displayNumber)
+{
+    pthread_mutex_lock(&openDisplaysMutex);
+    releaseDisplayLocked(display);
+    display = acquireDisplayLocked(displayNumber);
+    pthread_mutex_unlock(&openDisplaysMutex);
+
+    return display;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+pipelineLog(
+    const PIPELINE_T *pipeline,
+    int priority,
+    const char *format,
+    ...)
+{
+    char message[256];
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    messageLog(pipeline->isDaemon,
+               pipeline->program,
+               priority,
+               "%s%s",
+               pipeline->prefix,
+               message);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+logLatencyHistogram(
+    PIPELINE_T *pipeline,
+    const char *name,
+    const LATENCY_HISTOGRAM_T *histogram)
+{
+    if (histogram->count == 0)
+    {
+        return;
+    }
+
+    pipelineLog(pipeline,
+                LOG_INFO,
+                "%s latency p50 %"PRId64" us, p90 %"PRId64" us,"
+                " p99 %"PRId64" us, max %"PRId64" us (%"PRIu64" samples)",
+                name,
+                latencyHistogramPercentile(histogram, 50.0)
+                    / NANOSECONDS_PER_MICROSECOND,
+                latencyHistogramPercentile(histogram, 90.0)
+                    / NANOSECONDS_PER_MICROSECOND,
+                latencyHistogramPercentile(histogram, 99.0)
+                    / NANOSECONDS_PER_MICROSECOND,
+                histogram->max / NANOSECONDS_PER_MICROSECOND,
+                histogram->count);
+}
+
+//-------------------------------------------------------------------------
+// The pipeline's statistics, including frames presented by the framebuffer
+// output's thread, which keeps its own. Can be called from any thread
+// that is not updating the pipeline's own statistics.
+
+void
+pipelineStats(
+    const PIPELINE_T *pipeline,
+    PIPELINE_STATS_T *stats)
+{
+    *stats = pipeline->stats;
+
+    if ((pipeline->config.framebuffer != NULL)
+        && (pipeline->config.outputQueue > 0))
+    {
+        FRAME_OUTPUT_STATS_T output;
+        frameOutputStats(&(pipeline->framebufferOutput), &output);
+
+        stats->framesPresented += output.frames;
+        stats->framebufferBytes += output.bytes;
+        latencyHistogramMerge(&(stats->updateLatency),
+                              &(output.writeLatency));
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+logFrameOutputStats(
+    PIPELINE_T *pipeline,
+    FRAME_OUTPUT_T *output)
+{
+    FRAME_RING_STATS_T ring;
+    frameRingStats(&(output->ring), &ring);
+
+    pipelineLog(pipeline,
+                LOG_INFO,
+                "%s output: %"PRIu64" frames queued, %"PRIu64" written,"
+                " %"PRIu64" dropped, %d/%d queued now, at most %d",
+                output->name,
+                ring.pushed,
+                ring.popped,
+                ring.dropped,
+                ring.occupancy,
+                output->ring.capacity,
+                ring.maxOccupancy);
+}
+
+//-------------------------------------------------------------------------
+// The rate frames are really being captured at, measured over about a
+// second. The scheduler's period says nothing about this with vsync or
+// synthetic sync, or while the governor is lowering the rate. Until the
+// first second has passed, the rate so far is used.
+
+static double
+pipelineCaptureRate(
+    PIPELINE_T *pipeline)
+{
+    int64_t now = monotonicNanoseconds();
+    int64_t elapsed = now - pipeline->rateStart;
+    uint64_t frames = pipeline->stats.framesCaptured - pipeline->rateFrames;
+
+    if (elapsed >= CAPTURE_RATE_NANOSECONDS)
+    {
+        pipeline->captureFps = (double)frames
+                             * NANOSECONDS_PER_SECOND
+                             / elapsed;
+        pipeline->rateStart = now;
+        pipeline->rateFrames = pipeline->stats.framesCaptured;
+    }
+    else if ((pipeline->rateFrames == 0) && (elapsed > 0))
+    {
+        return (double)frames * NANOSECONDS_PER_SECOND / elapsed;
+    }
+
+    return pipeline->captureFps;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+logPipelineStats(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_STATS_T stats;
+    pipelineStats(pipeline, &stats);
+
+    uint32_t inFlight = 0;
+
+    if (pipeline->active)
+    {
+        inFlight = resourceRingInFlight(&(pipeline->ring));
+    }
+
+    pipelineLog(pipeline,
+                LOG_INFO,
+                "%"PRIu64" frames captured, %"PRIu64" presented,"
+                " %"PRIu64" skipped, %d update(s) in flight, %.1f fps,"
+                " %"PRIu64" reconfiguration(s)",
+                stats.framesCaptured,
+                stats.framesPresented,
+                stats.framesSkipped,
+                inFlight,
+                pipelineCaptureRate(pipeline),
+                stats.reconfigurations);
+
+    if (stats.failures > 0)
+    {
+        pipelineLog(pipeline,
+                    LOG_INFO,
+                    "%"PRIu64" failed frames, %"PRIu64" retries,"
+                    " %"PRIu64" element recreations,"
+                    " %"PRIu64" display reopens",
+                    stats.failures,
+                    stats.frameRetries,
+                    stats.elementRecreations,
+                    stats.displayReopens);
+    }
+
+    if ((pipeline->config.framebuffer != NULL)
+        && (stats.framesPresented > 0))
+    {
+        uint64_t perFrame = stats.framebufferBytes / stats.framesPresented;
+        uint64_t fullFrame = (uint64_t)pipeline->framebuffer.width
+                           * pipeline->framebuffer.height
+                           * pipeline->framebuffer.bytesPerPixel;
+
+        pipelineLog(pipeline,
+                    LOG_INFO,
+                    "%"PRIu64" bytes written to the framebuffer,"
+                    " %"PRIu64" per frame (%.1f%% of a full frame)",
+                    stats.framebufferBytes,
+                    perFrame,
+                    (fullFrame > 0) ? (100.0 * perFrame) / fullFrame : 0.0);
+    }
+
+    if ((pipeline->config.framebuffer != NULL)
+        && (pipeline->config.outputQueue > 0))
+    {
+        logFrameOutputStats(pipeline, &(pipeline->framebufferOutput));
+    }
+
+    if (pipeline->config.outputPipe != NULL)
+    {
+        FRAME_OUTPUT_STATS_T output;
+        frameOutputStats(&(pipeline->pipeOutput), &output);
+
+        // the output's thread decides this when the stream starts
+        bool useVmsplice = __atomic_load_n(&(pipeline->pipe.useVmsplice),
+                                           __ATOMIC_RELAXED);
+
+        pipelineLog(pipeline,
+                    LOG_INFO,
+                    "%"PRIu64" frames, %"PRIu64" bytes written to %s (%s)",
+                    output.frames,
+                    output.bytes,
+                    pipeline->config.outputPipe,
+                    useVmsplice ? "vmsplice" : "writev");
+
+        logFrameOutputStats(pipeline, &(pipeline->pipeOutput));
+        logLatencyHistogram(pipeline, "pipe write", &(output.writeLatency));
+    }
+
+    logLatencyHistogram(pipeline, "snapshot", &(stats.snapshotLatency));
+    logLatencyHistogram(pipeline, "update", &(stats.updateLatency));
+    logLatencyHistogram(pipeline, "wakeup", &(stats.wakeupLatency));
+}
+
+//-------------------------------------------------------------------------
+
+static void
+publishLatencyHistogram(
+    STATS_SEGMENT_LATENCY_T *latency,
+    const LATENCY_HISTOGRAM_T *histogram)
+{
+    latency->p50 = latencyHistogramPercentile(histogram, 50.0);
+    latency->p90 = latencyHistogramPercentile(histogram, 90.0);
+    latency->p99 = latencyHistogramPercentile(histogram, 99.0);
+    latency->max = histogram->max;
+}
+
+//-------------------------------------------------------------------------
+// Copy the pipeline's statistics to its slot in the statistics file, if
+// there is one.
+
+static void
+publishPipelineStats(
+    PIPELINE_T *pipeline)
+{
+    STATS_SEGMENT_PIPELINE_T *published = pipeline->published;
+
+    if (published == NULL)
+    {
+        return;
+    }
+
+    PIPELINE_STATS_T copy;
+    pipelineStats(pipeline, &copy);
+    const PIPELINE_STATS_T *stats = &copy;
+
+    statsSegmentBeginWrite(published);
+
+    published->active = pipeline->active;
+    published->updated = monotonicNanoseconds();
+    published->sourceDisplay = pipeline->config.sourceDisplayNumber;
+    published->sourceWidth = pipeline->sourceInfo.width;
+    published->sourceHeight = pipeline->sourceInfo.height;
+    published->snapshotWidth = pipeline->width;
+    published->snapshotHeight = pipeline->height;
+    published->destinationCount = pipeline->config.destinationCount;
+
+    uint32_t i = 0;
+    for (i = 0 ; i < pipeline->config.destinationCount ; ++i)
+    {
+        const DESTINATION_T *destination = &(pipeline->destinations[i]);
+        STATS_SEGMENT_DESTINATION_T *slot = &(published->destinations[i]);
+
+        slot->display = destination->displayNumber;
+        slot->width = destination->info.width;
+        slot->height = destination->info.height;
+        slot->x = destination->destRect.x;
+        slot->y = destination->destRect.y;
+        slot->copyWidth = destination->destRect.width;
+        slot->copyHeight = destination->destRect.height;
+
+        // An empty rectangle fills the display.
+
+        if ((slot->copyWidth == 0) || (slot->copyHeight == 0))
+        {
+            slot->copyWidth = slot->width;
+            slot->copyHeight = slot->height;
+        }
+    }
+
+    published->framesCaptured = stats->framesCaptured;
+    published->framesPresented = stats->framesPresented;
+    published->framesSkipped = stats->framesSkipped;
+    published->reconfigurations = stats->reconfigurations;
+    published->failures = stats->failures;
+    published->frameRetries = stats->frameRetries;
+    published->elementRecreations = stats->elementRecreations;
+    published->displayReopens = stats->displayReopens;
+    published->captureFps = pipelineCaptureRate(pipeline);
+
+    publishLatencyHistogram(&(published->snapshotLatency),
+                            &(stats->snapshotLatency));
+    publishLatencyHistogram(&(published->updateLatency),
+                            &(stats->updateLatency));
+    publishLatencyHistogram(&(published->wakeupLatency),
+                            &(stats->wakeupLatency));
+
+    statsSegmentEndWrite(published);
+}
+
+//-------------------------------------------------------------------------
+// Move a rectangle of a display to where it is once the display has been
+// rotated clockwise.
+
+static void
+rotateRect(
+    VC_RECT_T *rect,
+    DISPMANX_TRANSFORM_T rotation,
+    const DISPMANX_MODEINFO_T *info)
+{
+    VC_RECT_T original = *rect;
+
+    switch (rotation)
+    {
+    case DISPMANX_ROTATE_90:
+
+        setRect(rect,
+                info->height - original.y - original.height,
+                original.x,
+                original.height,
+                original.width);
+        break;
+
+    case DISPMANX_ROTATE_180:
+
+        setRect(rect,
+                info->width - original.x - original.width,
+                info->height - original.y - original.height,
+                original.width,
+                original.height);
+        break;
+
+    case DISPMANX_ROTATE_270:
+
+        setRect(rect,
+                original.y,
+                info->width - original.x - original.width,
+                original.height,
+                original.width);
+        break;
+
+    default:
+
+        break;
+    }
+}
+
+//-------------------------------------------------------------------------
+// Scale a rectangle of the given size to fit the destination display,
+// keeping its aspect ratio, and center it.
+
+static void
+fitRect(
+    VC_RECT_T *rect,
+    uint32_t width,
+    uint32_t height,
+    const DISPMANX_MODEINFO_T *info)
+{
+    uint32_t fitWidth = info->width;
+    uint32_t fitHeight = info->height;
+
+    if (((uint64_t)width * info->height) > ((uint64_t)info->width * height))
+    {
+        fitHeight = ((uint64_t)info->width * height) / width;
+    }
+    else
+    {
+        fitWidth = ((uint64_t)info->height * width) / height;
+    }
+
+    setRect(rect,
+            (info->width - fitWidth) / 2,
+            (info->height - fitHeight) / 2,
+            fitWidth,
+            fitHeight);
+}
+
+//-------------------------------------------------------------------------
+// Work out the size of the snapshot, the region of it shown by the
+// elements, and where each element is placed on its display, from the
+// current display sizes.
+//
+// By default, the snapshot is taken at the size of the largest
+// destination and scaled by each element to the size of its display. When
+// only a region of the source is copied, the snapshot is only as large as
+// needed for that region to fill the largest destination. A smaller
+// capture size reduces the memory bandwidth used by the snapshot, and the
+// display hardware upscales it on presentation. The snapshot is taken
+// rotated, so it has the orientation of the destinations, and only flips
+// are left to the elements.
+//
+// A framebuffer has no element to scale, crop or flip the snapshot, so
+// the whole source is captured at the size of the framebuffer, with all
+// of the transform applied by the snapshot.
+
+static void
+setPipelineGeometry(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_CONFIG_T *config = &(pipeline->config);
+    const DISPMANX_MODEINFO_T *sourceInfo = &(pipeline->sourceInfo);
+
+    if (config->framebuffer != NULL)
+    {
+        pipeline->width = pipeline->framebuffer.width;
+        pipeline->height = pipeline->framebuffer.height;
+        pipeline->snapshotTransform = config->transform;
+        return;
+    }
+
+    //---------------------------------------------------------------------
+
+    VC_RECT_T region;
+    setRect(&region, 0, 0, sourceInfo->width, sourceInfo->height);
+
+    bool cropped = false;
+
+    if ((config->crop.width > 0) && (config->crop.height > 0))
+    {
+        if ((config->crop.x < sourceInfo->width)
+            && (config->crop.y < sourceInfo->height))
+        {
+            region = config->crop;
+
+            if ((region.x + region.width) > sourceInfo->width)
+            {
+                region.width = sourceInfo->width - region.x;
+            }
+
+            if ((region.y + region.height) > sourceInfo->height)
+            {
+                region.height = sourceInfo->height - region.y;
+            }
+
+            cropped = true;
+
+            pipelineLog(pipeline,
+                        LOG_INFO,
+                        "copying region %d,%d %dx%d of the source display",
+                        region.x,
+                        region.y,
+                        region.width,
+                        region.height);
+        }
+        else
+        {
+            pipelineLog(pipeline,
+                        LOG_WARNING,
+                        "crop region is outside the source display,"
+                        " copying the whole display");
+        }
+    }
+
+    //---------------------------------------------------------------------
+    // The snapshot is taken rotated, so from here on the source and the
+    // region are in the orientation of the destinations.
+
+    uint32_t rotation = config->transform & DISPMANX_ROTATE_270;
+    bool transposed = (rotation == DISPMANX_ROTATE_90)
+                   || (rotation == DISPMANX_ROTATE_270);
+
+    uint32_t sourceWidth = transposed
+                         ? sourceInfo->height
+                         : sourceInfo->width;
+    uint32_t sourceHeight = transposed
+                          ? sourceInfo->width
+                          : sourceInfo->height;
+
+    rotateRect(&region, rotation, sourceInfo);
+
+    pipeline->snapshotTransform = rotation;
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    uint32_t i = 0;
+    for (i = 0 ; i < config->destinationCount ; ++i)
+    {
+        const DISPMANX_MODEINFO_T *info = &(pipeline->destinations[i].info);
+
+        if (info->width > width)
+        {
+            width = info->width;
+        }
+
+        if (info->height > height)
+        {
+            height = info->height;
+        }
+    }
+
+    if (cropped)
+    {
+        width = ((uint64_t)sourceWidth
+                 * ((width < region.width) ? width : region.width))
+              / region.width;
+        height = ((uint64_t)sourceHeight
+                  * ((height < region.height) ? height : region.height))
+               / region.height;
+    }
+
+    if ((config->captureWidth > 0) && (config->captureHeight > 0))
+    {
+        width = config->captureWidth;
+        height = config->captureHeight;
+    }
+    else if ((config->captureScale > 0.0) && (config->captureScale < 1.0))
+    {
+        width = width * config->captureScale;
+        height = height * config->captureScale;
+    }
+
+    pipeline->width = (width > 0) ? width : 1;
+    pipeline->height = (height > 0) ? height : 1;
+
+    //---------------------------------------------------------------------
+    // The source rectangle is in 16.16 fixed point, in snapshot pixels.
+
+    setRect(&(pipeline->sourceRect),
+            ((uint64_t)region.x * pipeline->width << 16) / sourceWidth,
+            ((uint64_t)region.y * pipeline->height << 16) / sourceHeight,
+            ((uint64_t)region.width * pipeline->width << 16) / sourceWidth,
+            ((uint64_t)region.height * pipeline->height << 16)
+                / sourceHeight);
+
+    //---------------------------------------------------------------------
+
+    for (i = 0 ; i < config->destinationCount ; ++i)
+    {
+        DESTINATION_T *destination = &(pipeline->destinations[i]);
+
+        if (config->center
+             && (region.width <= destination->info.width)
+             && (region.height <= destination->info.height))
+        {
+            setRect(
+                &(destination->destRect),
+                (destination->info.width - region.width) / 2,
+                (destination->info.height - region.height) / 2,
+                region.width,
+                region.height);
+
+            pipelineLog(pipeline,
+                        LOG_INFO,
+                        "centering source display within destination"
+                        " display [%d]",
+                        destination->displayNumber);
+        }
+        else if (cropped)
+        {
+            fitRect(&(destination->destRect),
+                    region.width,
+                    region.height,
+                    &(destination->info));
+        }
+        else
+        {
+            setRect(&(destination->destRect), 0, 0, 0, 0);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+// Ask all of the pipelines to log their statistics. This only increments
+// a counter, so it is safe to call from a signal handler.
+
+void
+requestPipelineStats(void)
+{
+    ++statsRequests;
+}
+
+//-------------------------------------------------------------------------
+
+void
+initPipeline(
+    PIPELINE_T *pipeline,
+    const PIPELINE_CONFIG_T *config,
+    const char *name,
+    bool isDaemon,
+    const char *program,
+    volatile bool *run)
+{
+    memset(pipeline, 0, sizeof(*pipeline));
+
+    pipeline->config = *config;
+    pipeline->isDaemon = isDaemon;
+    pipeline->program = program;
+    pipeline->run = run;
+    pipeline->pipe.fd = -1;
+
+    initLatencyHistogram(&(pipeline->stats.snapshotLatency));
+    initLatencyHistogram(&(pipeline->stats.updateLatency));
+    initLatencyHistogram(&(pipeline->stats.wakeupLatency));
+
+    if (name != NULL)
+    {
+        snprintf(pipeline->prefix, sizeof(pipeline->prefix), "%s: ", name);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+getPipelineDisplayInfo(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_CONFIG_T *config = &(pipeline->config);
+
+    int result = displayBackend()->displayGetInfo(pipeline->sourceDisplay,
+                                                  &(pipeline->sourceInfo));
+
+    if (result != 0)
+    {
+        pipelineLog(pipeline,
+                    LOG_ERR,
+                    "getting source display dimensions failed");
+        return false;
+    }
+
+    uint32_t i = 0;
+    for (i = 0 ; i < config->destinationCount ; ++i)
+    {
+        DESTINATION_T *destination = &(pipeline->destinations[i]);
+
+        result = displayBackend()->displayGetInfo(destination->display,
+                                                  &(destination->info));
+
+        if (result != 0)
+        {
+            pipelineLog(pipeline,
+                        LOG_ERR,
+                        "getting destination display [%d] dimensions failed",
+                        destination->displayNumber);
+            return false;
+        }
+
+        pipelineLog(pipeline,
+                    LOG_INFO,
+                    "copying from [%d] %dx%d to [%d] %dx%d",
+                    config->sourceDisplayNumber,
+                    pipeline->sourceInfo.width,
+                    pipeline->sourceInfo.height,
+                    destination->displayNumber,
+                    destination->info.width,
+                    destination->info.height);
+    }
+
+    if (config->framebuffer != NULL)
+    {
+        pipelineLog(pipeline,
+                    LOG_INFO,
+                    "copying from [%d] %dx%d to %s %dx%d",
+                    config->sourceDisplayNumber,
+                    pipeline->sourceInfo.width,
+                    pipeline->sourceInfo.height,
+                    config->framebuffer,
+                    pipeline->framebuffer.width,
+                    pipeline->framebuffer.height);
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Returns true if any of the displays has changed size (or can no longer
+// be queried) since the pipeline's resources were created.
+
+static bool
+pipelineDisplaysChanged(
+    PIPELINE_T *pipeline)
+{
+    DISPMANX_MODEINFO_T info;
+
+    const DISPLAY_BACKEND_T *backend = displayBackend();
+
+    if ((backend->displayGetInfo(pipeline->sourceDisplay, &info) != 0)
+        || (info.width != pipeline->sourceInfo.width)
+        || (info.height != pipeline->sourceInfo.height))
+    {
+        return true;
+    }
+
+    uint32_t i = 0;
+    for (i = 0 ; i < pipeline->config.destinationCount ; ++i)
+    {
+        DESTINATION_T *destination = &(pipeline->destinations[i]);
+
+        if ((backend->displayGetInfo(destination->display, &info) != 0)
+            || (info.width != destination->info.width)
+            || (info.height != destination->info.height))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//-------------------------------------------------------------------------
+// Add an element showing the front snapshot resource to each destination.
+
+static bool
+addPipelineElements(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_CONFIG_T *config = &(pipeline->config);
+
+    if (config->destinationCount == 0)
+    {
+        return true;
+    }
+
+    VC_DISPMANX_ALPHA_T alpha =
+    {
+        DISPMANX_FLAGS_ALPHA_FIXED_ALL_PIXELS,
+        255,
+        0
+    };
+
+    DISPMANX_UPDATE_HANDLE_T update = displayBackend()->updateStart();
+
+    if (update == 0)
+    {
+        pipelineLog(pipeline, LOG_ERR, "display update failed");
+        return false;
+    }
+
+    DISPMANX_RESOURCE_HANDLE_T front = resourceRingFront(&(pipeline->ring));
+    bool result = true;
+
+    // the snapshot has already been rotated
+
+    DISPMANX_TRANSFORM_T flips = config->transform
+                               & (DISPMANX_FLIP_HRIZ | DISPMANX_FLIP_VERT);
+
+    uint32_t i = 0;
+    for (i = 0 ; i < config->destinationCount ; ++i)
+    {
+        DESTINATION_T *destination = &(pipeline->destinations[i]);
+
+        destination->element
+            = displayBackend()->elementAdd(update,
+                                           destination->display,
+                                           config->layerNumber,
+                                           &(destination->destRect),
+                                           front,
+                                           &(pipeline->sourceRect),
+                                           &alpha,
+                                           flips);
+
+        if (destination->element == 0)
+        {
+            pipelineLog(pipeline,
+                        LOG_ERR,
+                        "failed to create DispmanX element on display [%d]",
+                        destination->displayNumber);
+            result = false;
+        }
+    }
+
+    displayBackend()->updateSubmitSync(update);
+
+    return result;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+removePipelineElements(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_CONFIG_T *config = &(pipeline->config);
+
+    resourceRingDrain(&(pipeline->ring));
+
+    if (config->destinationCount == 0)
+    {
+        return;
+    }
+
+    DISPMANX_UPDATE_HANDLE_T update = displayBackend()->updateStart();
+
+    if (update == 0)
+    {
+        return;
+    }
+
+    uint32_t i = 0;
+    for (i = 0 ; i < config->destinationCount ; ++i)
+    {
+        if (pipeline->destinations[i].element != 0)
+        {
+            displayBackend()->elementRemove(update,
+                                            pipeline->destinations[i].element);
+            pipeline->destinations[i].element = 0;
+        }
+    }
+
+    displayBackend()->updateSubmitSync(update);
+}
+
+//-------------------------------------------------------------------------
+// Create the snapshot resources, change detector and elements for the
+// current display sizes.
+
+static bool
+createPipelineResources(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_CONFIG_T *config = &(pipeline->config);
+
+    //---------------------------------------------------------------------
+
+    setPipelineGeometry(pipeline);
+
+    pipelineLog(pipeline,
+                LOG_INFO,
+                "snapshot %dx%d %s, %d bytes per frame",
+                pipeline->width,
+                pipeline->height,
+                imageFormatName(config->format),
+                pipeline->width
+                * pipeline->height
+                * imageFormatBytesPerPixel(config->format));
+
+    // A stream can not change size part way through.
+
+    if ((config->outputPipe != NULL)
+        && (pipeline->pipe.width > 0)
+        && ((pipeline->width != pipeline->pipe.width)
+            || (pipeline->height != pipeline->pipe.height)))
+    {
+        pipelineLog(pipeline,
+                    LOG_WARNING,
+                    "not writing to %s until the snapshot is %dx%d again",
+                    config->outputPipe,
+                    pipeline->pipe.width,
+                    pipeline->pipe.height);
+    }
+
+    if (initResourceRing(&(pipeline->ring),
+                         config->buffers,
+                         config->format,
+                         pipeline->width,
+                         pipeline->height) == false)
+    {
+        pipelineLog(pipeline, LOG_ERR, "creating snapshot resources failed");
+        return false;
+    }
+
+    if (config->skipUnchanged)
+    {
+        if (initChangeDetector(&(pipeline->detector),
+                               config->format,
+                               pipeline->width,
+                               pipeline->height,
+                               config->sampleStride) == false)
+        {
+            pipelineLog(pipeline,
+                        LOG_ERR,
+                        "allocating change detection buffer failed");
+            destroyResourceRing(&(pipeline->ring));
+            return false;
+        }
+    }
+
+    // Other processes can share the snapshots through shared memory. The
+    // copy carries on without it if the segment can not be created.
+
+    if (config->exportFrames)
+    {
+        if (createFrameExport(&(pipeline->frameExport),
+                              config->exportIndex,
+                              config->format,
+                              imageFormatName(config->format),
+                              pipeline->width,
+                              pipeline->height,
+                              imageFormatBytesPerPixel(config->format),
+                              imageFormatPitch(config->format,
+                                               pipeline->width),
+                              config->exportSlots))
+        {
+            pipelineLog(pipeline,
+                        LOG_INFO,
+                        "exporting frames to /dev/shm%s (%d slots)",
+                        pipeline->frameExport.name,
+                        config->exportSlots);
+        }
+        else
+        {
+            pipelineLog(pipeline,
+                        LOG_WARNING,
+                        "exporting frames to /dev/shm%s failed: %s",
+                        pipeline->frameExport.name,
+                        (errno == EBUSY)
+                            ? "in use by another process"
+                            : strerror(errno));
+        }
+    }
+
+    //---------------------------------------------------------------------
+
+    pipeline->active = true;
+
+    return addPipelineElements(pipeline);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+destroyPipelineResources(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_CONFIG_T *config = &(pipeline->config);
+
+    if (pipeline->active == false)
+    {
+        return;
+    }
+
+    removePipelineElements(pipeline);
+
+    destroyResourceRing(&(pipeline->ring));
+    destroyFrameExport(&(pipeline->frameExport));
+
+    if (config->skipUnchanged)
+    {
+        destroyChangeDetector(&(pipeline->detector));
+    }
+
+    pipeline->active = false;
+}
+
+//-------------------------------------------------------------------------
+// Make the next frame written to the framebuffer a full one. If frames are
+// written on an output thread, the frames already queued are written
+// first, so that the sink is not changed under that thread.
+
+static void
+resetPipelineFramebuffer(
+    PIPELINE_T *pipeline)
+{
+    frameOutputDrain(&(pipeline->framebufferOutput));
+    framebufferSinkReset(&(pipeline->framebuffer));
+}
+
+//-------------------------------------------------------------------------
+// Rebuild the pipeline's resources and elements for the current display
+// sizes. If a display cannot be queried (e.g. it has been unplugged) the
+// pipeline is left inactive, and this is tried again later.
+
+static void
+reconfigurePipeline(
+    PIPELINE_T *pipeline)
+{
+    destroyPipelineResources(pipeline);
+
+    if (getPipelineDisplayInfo(pipeline) == false)
+    {
+        return;
+    }
+
+    if (createPipelineResources(pipeline) == false)
+    {
+        destroyPipelineResources(pipeline);
+        return;
+    }
+
+    ++(pipeline->stats.reconfigurations);
+
+    if (pipeline->config.skipUnchanged)
+    {
+        changeDetectorReset(&(pipeline->detector));
+    }
+
+    if (pipeline->config.framebuffer != NULL)
+    {
+        resetPipelineFramebuffer(pipeline);
+    }
+
+    pipelineLog(pipeline, LOG_INFO, "reconfigured for new display geometry");
+}
+
+//-------------------------------------------------------------------------
+// Check whether the displays need to be reconfigured, either because of a
+// TV service notification or because polling shows they have changed.
+
+static void
+checkPipelineDisplays(
+    PIPELINE_T *pipeline)
+{
+    int64_t now = monotonicNanoseconds();
+    bool changed = false;
+
+    uint32_t generation = displayMonitorGeneration();
+
+    if (generation != pipeline->displayGeneration)
+    {
+        pipeline->displayGeneration = generation;
+        changed = true;
+    }
+    else if ((pipeline->config.displayPoll > 0)
+             && (now >= pipeline->nextDisplayPoll))
+    {
+        pipeline->nextDisplayPoll = now + pipeline->config.displayPoll;
+
+        changed = (pipeline->active == false)
+               || pipelineDisplaysChanged(pipeline);
+    }
+
+    if (changed)
+    {
+        reconfigurePipeline(pipeline);
+    }
+}
+
+//-------------------------------------------------------------------------
+// Close and reopen the pipeline's displays, then rebuild its resources and
+// elements. Returns false if a display could not be reopened; if one can
+// be reopened but not queried it is treated as unplugged.
+
+static bool
+reopenPipelineDisplays(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_CONFIG_T *config = &(pipeline->config);
+
+    // the callback has to be removed while the display is still open
+
+    if (config->sync == SYNC_VSYNC)
+    {
+        vsyncDetachDisplay(&(pipeline->vsync));
+    }
+
+    destroyPipelineResources(pipeline);
+
+    pipeline->sourceDisplay = reacquireDisplay(pipeline->sourceDisplay,
+                                               config->sourceDisplayNumber);
+
+    if (pipeline->sourceDisplay == 0)
+    {
+        pipelineLog(pipeline, LOG_ERR, "reopen source display failed");
+        return false;
+    }
+
+    uint32_t i = 0;
+    for (i = 0 ; i < config->destinationCount ; ++i)
+    {
+        DESTINATION_T *destination = &(pipeline->destinations[i]);
+
+        destination->display = reacquireDisplay(destination->display,
+                                                 destination->displayNumber);
+
+        if (destination->display == 0)
+        {
+            pipelineLog(pipeline,
+                        LOG_ERR,
+                        "reopen destination display [%d] failed",
+                        destination->displayNumber);
+            return false;
+        }
+    }
+
+    if ((config->sync == SYNC_VSYNC)
+        && (vsyncSetDisplay(&(pipeline->vsync),
+                            pipeline->sourceDisplay) == false))
+    {
+        pipelineLog(pipeline, LOG_ERR, "registering vsync callback failed");
+        return false;
+    }
+
+    if (getPipelineDisplayInfo(pipeline) == false)
+    {
+        return true;
+    }
+
+    if (createPipelineResources(pipeline) == false)
+    {
+        destroyPipelineResources(pipeline);
+        return false;
+    }
+
+    if (config->skipUnchanged)
+    {
+        changeDetectorReset(&(pipeline->detector));
+    }
+
+    if (config->framebuffer != NULL)
+    {
+        resetPipelineFramebuffer(pipeline);
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+resetPipelineRecovery(
+    PIPELINE_T *pipeline)
+{
+    pipeline->recoveryTier = RECOVERY_RETRY_FRAME;
+    pipeline->recoveryAttempts = 0;
+    pipeline->recoveryBackoff = RECOVERY_BACKOFF_MIN_NANOSECONDS;
+}
+
+//-------------------------------------------------------------------------
+// Called after a frame has failed. Each failure without a good frame in
+// between is an attempt at the current tier of recovery; once a tier has
+// been tried RECOVERY_ATTEMPTS_PER_TIER times, the next one is used. The
+// delay before each attempt doubles, up to a limit. Returns false once
+// every tier has been tried and the pipeline should give up.
+
+static bool
+recoverPipeline(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_STATS_T *stats = &(pipeline->stats);
+
+    ++(stats->failures);
+
+    while (*(pipeline->run))
+    {
+        if (++(pipeline->recoveryAttempts) > RECOVERY_ATTEMPTS_PER_TIER)
+        {
+            ++(pipeline->recoveryTier);
+            pipeline->recoveryAttempts = 1;
+        }
+
+        if (pipeline->recoveryTier == RECOVERY_EXIT)
+        {
+            pipelineLog(pipeline, LOG_ERR, "unable to recover, giving up");
+            return false;
+        }
+
+        monotonicSleepUntil(monotonicNanoseconds()
+                            + pipeline->recoveryBackoff);
+
+        pipeline->recoveryBackoff *= 2;
+
+        if (pipeline->recoveryBackoff > RECOVERY_BACKOFF_MAX_NANOSECONDS)
+        {
+            pipeline->recoveryBackoff = RECOVERY_BACKOFF_MAX_NANOSECONDS;
+        }
+
+        //-----------------------------------------------------------------
+
+        bool recovered = true;
+
+        switch (pipeline->recoveryTier)
+        {
+        case RECOVERY_RETRY_FRAME:
+
+            ++(stats->frameRetries);
+            break;
+
+        case RECOVERY_RECREATE_ELEMENTS:
+
+            pipelineLog(pipeline, LOG_WARNING, "recreating elements");
+            ++(stats->elementRecreations);
+
+            removePipelineElements(pipeline);
+            recovered = addPipelineElements(pipeline);
+            break;
+
+        case RECOVERY_REOPEN_DISPLAYS:
+
+            pipelineLog(pipeline, LOG_WARNING, "reopening displays");
+            ++(stats->displayReopens);
+
+            recovered = reopenPipelineDisplays(pipeline);
+            break;
+
+        default:
+
+            break;
+        }
+
+        if (recovered)
+        {
+            return true;
+        }
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Write a queued frame to the framebuffer, on the framebuffer output's
+// thread. The output counts the frames, bytes and time taken itself.
+
+static size_t
+writeFramebufferOutput(
+    void *context,
+    const uint8_t *frame)
+{
+    PIPELINE_T *pipeline = context;
+    FRAMEBUFFER_SINK_T *framebuffer = &(pipeline->framebuffer);
+
+    return framebufferSinkWrite(framebuffer,
+                                frame,
+                                framebuffer->pitch,
+                                pipeline->outputPool);
+}
+
+//-------------------------------------------------------------------------
+// Write a queued frame to the output pipe, on the pipe output's thread.
+// Only the first failure is logged, as a FIFO without a reader fails every
+// frame until one opens it.
+
+static size_t
+writePipeOutput(
+    void *context,
+    const uint8_t *frame)
+{
+    PIPELINE_T *pipeline = context;
+    PIPE_SINK_T *pipe = &(pipeline->pipe);
+    bool wasOpen = (pipe->fd != -1);
+    uint64_t bytes = pipe->bytes;
+
+    if ((pipeSinkWrite(pipe, frame, pipeline->outputPool) == false)
+        && wasOpen)
+    {
+        pipelineLog(pipeline,
+                    LOG_WARNING,
+                    "writing to %s failed: %s",
+                    pipeline->config.outputPipe,
+                    strerror(errno));
+    }
+
+    return pipe->bytes - bytes;
+}
+
+//-------------------------------------------------------------------------
+// The nominal frame rate, for the header of a Y4M stream.
+
+static double
+pipelineFrameRate(
+    const PIPELINE_T *pipeline)
+{
+    const PIPELINE_CONFIG_T *config = &(pipeline->config);
+
+    if (config->sync == SYNC_SYNTHETIC)
+    {
+        return config->syntheticRate / config->vsyncDivisor;
+    }
+
+    return (double)NANOSECONDS_PER_SECOND / config->frameDuration;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+logWorkerPool(
+    PIPELINE_T *pipeline,
+    const char *name,
+    const WORKER_POOL_T *pool)
+{
+    char cores[32] = "not pinned";
+
+    if (pool->pinned)
+    {
+        snprintf(cores,
+                 sizeof(cores),
+                 "cores %d to %d",
+                 pool->firstCore,
+                 pool->firstCore + pool->threads - 2);
+    }
+
+    pipelineLog(pipeline,
+                LOG_INFO,
+                "%d %s worker threads, %d stripes per frame (%s)",
+                pool->threads,
+                name,
+                pool->stripes,
+                cores);
+}
+
+//-------------------------------------------------------------------------
+
+bool
+openPipeline(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_CONFIG_T *config = &(pipeline->config);
+
+    //---------------------------------------------------------------------
+
+    pipeline->sourceDisplay = acquireDisplay(config->sourceDisplayNumber);
+
+    if (pipeline->sourceDisplay == 0)
+    {
+        pipelineLog(pipeline, LOG_ERR, "open source display failed");
+        return false;
+    }
+
+    // A framebuffer replaces the destination displays, and the snapshot
+    // is taken in its pixel format so that it can be copied straight in.
+
+    if (config->framebuffer != NULL)
+    {
+        config->destinationCount = 0;
+
+        if (initFramebufferSink(&(pipeline->framebuffer),
+                                config->framebuffer,
+                                config->framebufferWidth,
+                                config->framebufferHeight,
+                                config->framebufferBits,
+                                config->framebufferConvert) == false)
+        {
+            pipelineLog(pipeline,
+                        LOG_ERR,
+                        "opening framebuffer %s failed: %s",
+                        config->framebuffer,
+                        strerror(errno));
+            return false;
+        }
+
+        config->format = pipeline->framebuffer.type;
+
+        if (pipeline->framebuffer.convert != PIXEL_CONVERT_NONE)
+        {
+            pipelineLog(pipeline,
+                        LOG_INFO,
+                        "converting snapshots to rgb565 (%s, %s)",
+                        pixelConvertName(pipeline->framebuffer.convert),
+                        pixelConvertImplementation());
+        }
+        else if (config->framebufferConvert != PIXEL_CONVERT_NONE)
+        {
+            pipelineLog(pipeline,
+                        LOG_WARNING,
+                        "framebuffer is not 16 bit, not converting");
+        }
+    }
+
+    uint32_t i = 0;
+    for (i = 0 ; i < config->destinationCount ; ++i)
+    {
+        DESTINATION_T *destination = &(pipeline->destinations[i]);
+
+        destination->displayNumber = config->destinationNumbers[i];
+        destination->display = acquireDisplay(destination->displayNumber);
+
+        if (destination->display == 0)
+        {
+            pipelineLog(pipeline,
+                        LOG_ERR,
+                        "open destination display [%d] failed",
+                        destination->displayNumber);
+            return false;
+        }
+    }
+
+    //---------------------------------------------------------------------
+
+    pipeline->governed = (config->minFps > 0.0)
+                      && (config->sync == SYNC_TIMER);
+
+    if (pipeline->governed)
+    {
+        config->skipUnchanged = true;
+
+        if (config->maxFps <= 0.0)
+        {
+            config->maxFps = config->fps;
+        }
+
+        config->frameDuration = NANOSECONDS_PER_SECOND / config->maxFps;
+    }
+
+    // Pixel work done on the CPU (comparing snapshots and writing to a
+    // framebuffer) is split into stripes across a pool of threads.
+
+    if (config->workers > 1)
+    {
+        if (initWorkerPool(&(pipeline->workerPool),
+                           config->workers,
+                           config->stripes,
+                           config->firstCore) == false)
+        {
+            pipelineLog(pipeline, LOG_ERR, "starting worker threads failed");
+            return false;
+        }
+
+        pipeline->pool = &(pipeline->workerPool);
+
+        logWorkerPool(pipeline, "capture", pipeline->pool);
+    }
+
+    if (config->skipUnchanged && (config->sampleStride <= 1))
+    {
+        pipelineLog(pipeline,
+                    LOG_INFO,
+                    "comparing snapshots in %dx%d tiles (%s)",
+                    FRAME_DIFF_DEFAULT_TILE_SIZE,
+                    FRAME_DIFF_DEFAULT_TILE_SIZE,
+                    frameDiffImplementation());
+    }
+
+    //---------------------------------------------------------------------
+
+    pipeline->displayGeneration = displayMonitorGeneration();
+    pipeline->nextDisplayPoll = monotonicNanoseconds() + config->displayPoll;
+
+    resetPipelineRecovery(pipeline);
+
+    if ((getPipelineDisplayInfo(pipeline) == false)
+        || (createPipelineResources(pipeline) == false))
+    {
+        return false;
+    }
+
+    // The output threads split their pixel work across a pool of their
+    // own, so that neither they nor the capture wait for the other's job
+    // to finish.
+
+    bool outputThreads = ((config->framebuffer != NULL)
+                          && (config->outputQueue > 0))
+                      || (config->outputPipe != NULL);
+
+    if (outputThreads && (config->workers > 1))
+    {
+        if (initWorkerPool(&(pipeline->outputWorkerPool),
+                           config->workers,
+                           config->stripes,
+                           config->firstCore + config->workers - 1) == false)
+        {
+            pipelineLog(pipeline, LOG_ERR, "starting worker threads failed");
+            return false;
+        }
+
+        pipeline->outputPool = &(pipeline->outputWorkerPool);
+
+        logWorkerPool(pipeline, "output", pipeline->outputPool);
+    }
+
+    // Writing to a framebuffer can be handed off to an output thread
+    // through a queue of frames, so that it overlaps the next capture.
+
+    if ((config->framebuffer != NULL) && (config->outputQueue > 0))
+    {
+        FRAMEBUFFER_SINK_T *framebuffer = &(pipeline->framebuffer);
+
+        if (initFrameOutput(&(pipeline->framebufferOutput),
+                            "framebuffer",
+                            config->outputQueue,
+                            0,
+                            config->outputPolicy,
+                            (size_t)framebuffer->pitch * framebuffer->height,
+                            writeFramebufferOutput,
+                            pipeline) == false)
+        {
+            pipelineLog(pipeline, LOG_ERR, "starting output thread failed");
+            return false;
+        }
+
+        pipelineLog(pipeline,
+                    LOG_INFO,
+                    "queueing up to %d frame(s) for the framebuffer (%s)",
+                    config->outputQueue,
+                    frameRingPolicyName(config->outputPolicy));
+    }
+
+    // Every captured frame is streamed to the output pipe, always from its
+    // own thread, so that a slow reader only costs dropped frames.
+
+    if (config->outputPipe != NULL)
+    {
+        if (initPipeSink(&(pipeline->pipe),
+                         config->outputPipe,
+                         config->outputPipeFormat,
+                         config->format,
+                         pipeline->width,
+                         pipeline->height,
+                         pipelineFrameRate(pipeline)) == false)
+        {
+            pipelineLog(pipeline,
+                        LOG_ERR,
+                        "opening %s failed: %s",
+                        config->outputPipe,
+                        strerror(errno));
+            return false;
+        }
+
+        uint32_t queue = (config->outputQueue > 0) ? config->outputQueue : 1;
+
+        if (initFrameOutput(&(pipeline->pipeOutput),
+                            "pipe",
+                            queue,
+                            pipeline->pipe.held,
+                            config->outputPolicy,
+                            (size_t)imageFormatPitch(config->format,
+                                                     pipeline->width)
+                            * pipeline->height,
+                            writePipeOutput,
+                            pipeline) == false)
+        {
+            pipelineLog(pipeline, LOG_ERR, "starting output thread failed");
+            return false;
+        }
+
+        if (config->outputPipeFormat == PIPE_FORMAT_RAW)
+        {
+            pipelineLog(pipeline,
+                        LOG_INFO,
+                        "streaming raw frames to %s"
+                        " (ffmpeg -f rawvideo -pix_fmt %s -s %dx%d -r %.2f)",
+                        config->outputPipe,
+                        pipeSinkRawPixelFormat(config->format),
+                        pipeline->width,
+                        pipeline->height,
+                        pipeline->pipe.rate);
+        }
+        else
+        {
+            pipelineLog(pipeline,
+                        LOG_INFO,
+                        "streaming %dx%d y4m frames to %s",
+                        pipeline->width,
+                        pipeline->height,
+                        config->outputPipe);
+        }
+    }
+
+    //---------------------------------------------------------------------
+
+    initFrameScheduler(&(pipeline->scheduler),
+                       config->frameDuration,
+                       config->spin,
+                       config->missed);
+
+    if (pipeline->governed)
+    {
+        initFrameRateGovernor(&(pipeline->governor),
+                              config->minFps,
+                              config->maxFps,
+                              GOVERNOR_HOLD_NANOSECONDS);
+
+        pipelineLog(pipeline,
+                    LOG_INFO,
+                    "frame rate governed between %.1f and %.1f fps",
+                    pipeline->governor.minFps,
+                    pipeline->governor.maxFps);
+    }
+
+    //---------------------------------------------------------------------
+
+    if (config->sync == SYNC_VSYNC)
+    {
+        if (initVsync(&(pipeline->vsync),
+                      pipeline->sourceDisplay,
+                      config->vsyncDivisor,
+                      config->vsyncOffset) == false)
+        {
+            pipelineLog(pipeline,
+                        LOG_ERR,
+                        "registering vsync callback failed");
+            return false;
+        }
+    }
+    else if (config->sync == SYNC_SYNTHETIC)
+    {
+        if (initSyntheticVsync(&(pipeline->vsync),
+                               config->syntheticRate,
+                               config->vsyncDivisor,
+                               config->vsyncOffset) == false)
+        {
+            pipelineLog(pipeline,
+                        LOG_ERR,
+                        "starting synthetic vsync failed");
+            return false;
+        }
+    }
+
+    if (config->sync != SYNC_TIMER)
+    {
+        pipelineLog(pipeline,
+                    LOG_INFO,
+                    "capturing every %d %s vsync(s), %"PRId64" us after vsync",
+                    config->vsyncDivisor,
+                    (config->sync == SYNC_VSYNC)
+                        ? "source display"
+                        : "synthetic",
+                    config->vsyncOffset / NANOSECONDS_PER_MICROSECOND);
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Copy a snapshot into memory, with the pitch of its format. The change
+// detector may already have read back the whole snapshot; otherwise it is
+// read straight into pixels.
+
+static bool
+readPipelineFrame(
+    PIPELINE_T *pipeline,
+    DISPMANX_RESOURCE_HANDLE_T resource,
+    uint8_t *pixels)
+{
+    PIPELINE_CONFIG_T *config = &(pipeline->config);
+    uint32_t pitch = imageFormatPitch(config->format, pipeline->width);
+
+    const uint8_t *snapshot = config->skipUnchanged
+                            ? changeDetectorSnapshot(&(pipeline->detector))
+                            : NULL;
+
+    if (snapshot != NULL)
+    {
+        memcpy(pixels, snapshot, (size_t)pitch * pipeline->height);
+        return true;
+    }
+
+    VC_RECT_T rect;
+    setRect(&rect, 0, 0, pipeline->width, pipeline->height);
+
+    return displayBackend()->resourceReadData(resource,
+                                              &rect,
+                                              pixels,
+                                              pitch) == 0;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+queuePipelineFrame(
+    PIPELINE_T *pipeline,
+    DISPMANX_RESOURCE_HANDLE_T resource,
+    FRAME_OUTPUT_T *output)
+{
+    if (readPipelineFrame(pipeline,
+                          resource,
+                          frameOutputBuffer(output)) == false)
+    {
+        return false;
+    }
+
+    frameOutputSubmit(output);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Publish a snapshot for other processes, read straight into the shared
+// memory.
+
+static bool
+exportPipelineFrame(
+    PIPELINE_T *pipeline,
+    DISPMANX_RESOURCE_HANDLE_T resource,
+    int64_t timestamp)
+{
+    FRAME_EXPORT_T *frameExport = &(pipeline->frameExport);
+
+    if (readPipelineFrame(pipeline,
+                          resource,
+                          frameExportBeginWrite(frameExport)) == false)
+    {
+        frameExportCancelWrite(frameExport);
+        return false;
+    }
+
+    frameExportEndWrite(frameExport, timestamp);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Capture one frame and, unless it is unchanged, present it on the
+// destinations. Returns false if the frame failed.
+
+static bool
+capturePipelineFrame(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_CONFIG_T *config = &(pipeline->config);
+    PIPELINE_STATS_T *stats = &(pipeline->stats);
+
+    DISPMANX_RESOURCE_HANDLE_T resource
+        = resourceRingBack(&(pipeline->ring));
+
+    int64_t start = monotonicNanoseconds();
+
+    int result = displayBackend()->snapshot(pipeline->sourceDisplay,
+                                            resource,
+                                            pipeline->snapshotTransform);
+
+    int64_t now = monotonicNanoseconds();
+    latencyHistogramAdd(&(stats->snapshotLatency), now - start);
+
+    if (result != 0)
+    {
+        pipelineLog(pipeline, LOG_WARNING, "DispmanX snapshot failed");
+        return false;
+    }
+
+    ++(stats->framesCaptured);
+
+    //---------------------------------------------------------------------
+
+    bool changed = (config->skipUnchanged == false)
+                || changeDetectorChanged(&(pipeline->detector),
+                                         resource,
+                                         pipeline->pool);
+
+    if (pipeline->governed
+        && frameRateGovernorUpdate(&(pipeline->governor), changed, now))
+    {
+        setFrameSchedulerPeriod(&(pipeline->scheduler),
+                                NANOSECONDS_PER_SECOND
+                                / pipeline->governor.fps);
+    }
+
+    if ((pipeline->frameExport.header != NULL)
+        && (exportPipelineFrame(pipeline, resource, now) == false))
+    {
+        pipelineLog(pipeline, LOG_WARNING, "reading snapshot failed");
+        return false;
+    }
+
+    if ((config->outputPipe != NULL)
+        && (pipeline->width == pipeline->pipe.width)
+        && (pipeline->height == pipeline->pipe.height)
+        && (queuePipelineFrame(pipeline,
+                               resource,
+                               &(pipeline->pipeOutput)) == false))
+    {
+        pipelineLog(pipeline, LOG_WARNING, "reading snapshot failed");
+        return false;
+    }
+
+    if (changed == false)
+    {
+        ++(stats->framesSkipped);
+    }
+    else if ((config->framebuffer != NULL) && (config->outputQueue > 0))
+    {
+        if (queuePipelineFrame(pipeline,
+                               resource,
+                               &(pipeline->framebufferOutput)) == false)
+        {
+            pipelineLog(pipeline, LOG_WARNING, "reading snapshot failed");
+            return false;
+        }
+    }
+    else if (config->framebuffer != NULL)
+    {
+        start = monotonicNanoseconds();
+
+        // the change detector may have already read back the whole
+        // snapshot
+
+        FRAMEBUFFER_SINK_T *framebuffer = &(pipeline->framebuffer);
+
+        const uint8_t *snapshot = config->skipUnchanged
+                                ? changeDetectorSnapshot(&(pipeline->detector))
+                                : NULL;
+
+        if (snapshot != NULL)
+        {
+            stats->framebufferBytes
+                += framebufferSinkWrite(framebuffer,
+                                        snapshot,
+                                        pipeline->detector.pitch,
+                                        pipeline->pool);
+        }
+        else if (framebufferSinkRead(framebuffer, resource))
+        {
+            stats->framebufferBytes
+                += framebufferSinkWrite(framebuffer,
+                                        framebuffer->buffer,
+                                        framebuffer->pitch,
+                                        pipeline->pool);
+        }
+        else
+        {
+            pipelineLog(pipeline, LOG_WARNING, "reading snapshot failed");
+            return false;
+        }
+
+        latencyHistogramAdd(&(stats->updateLatency),
+                            monotonicNanoseconds() - start);
+
+        ++(stats->framesPresented);
+    }
+    else
+    {
+        start = monotonicNanoseconds();
+
+        DISPMANX_UPDATE_HANDLE_T update = displayBackend()->updateStart();
+
+        if (update == 0)
+        {
+            pipelineLog(pipeline, LOG_WARNING, "display update failed");
+            return false;
+        }
+
+        uint32_t i = 0;
+        for (i = 0 ; i < config->destinationCount ; ++i)
+        {
+            result = displayBackend()->elementChangeSource(
+                         update,
+                         pipeline->destinations[i].element,
+                         resource);
+
+            if (result != 0)
+            {
+                pipelineLog(pipeline,
+                            LOG_WARNING,
+                            "changing element source on display [%d] failed",
+                            pipeline->destinations[i].displayNumber);
+                displayBackend()->updateSubmitSync(update);
+                return false;
+            }
+        }
+
+        resourceRingSubmit(&(pipeline->ring), update);
+
+        latencyHistogramAdd(&(stats->updateLatency),
+                            monotonicNanoseconds() - start);
+
+        ++(stats->framesPresented);
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Record how long a --benchmark run took, and how much CPU time the
+// pipeline's thread used since before.
+
+static void
+recordPipelineBenchmark(
+    PIPELINE_T *pipeline,
+    int64_t start,
+    const struct rusage *before)
+{
+    PIPELINE_BENCHMARK_T *benchmark = &(pipeline->benchmark);
+
+    struct rusage after;
+    getrusage(RUSAGE_THREAD, &after);
+
+    benchmark->elapsed = monotonicNanoseconds() - start;
+    timersub(&(after.ru_utime), &(before->ru_utime), &(benchmark->userTime));
+    timersub(&(after.ru_stime),
+             &(before->ru_stime),
+             &(benchmark->systemTime));
+}
+
+//-------------------------------------------------------------------------
+// Run the capture loop until *run becomes false, or with --benchmark
+// until that many frames have been captured without pausing between them.
+// Returns false if the loop stopped because of an error that could not be
+// recovered from.
+
+bool
+runPipeline(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_CONFIG_T *config = &(pipeline->config);
+    bool benchmark = (config->benchmarkFrames > 0);
+
+    struct rusage before;
+    getrusage(RUSAGE_THREAD, &before);
+    int64_t start = monotonicNanoseconds();
+
+    int64_t nextStats = start + config->statsInterval;
+    pipeline->nextPublish = start;
+    pipeline->rateStart = start;
+    pipeline->rateFrames = 0;
+    pipeline->captureFps = 0.0;
+
+    while (*(pipeline->run)
+           && ((benchmark == false)
+               || (pipeline->stats.framesCaptured < config->benchmarkFrames)))
+    {
+        checkPipelineDisplays(pipeline);
+
+        if (pipeline->active)
+        {
+            if (capturePipelineFrame(pipeline))
+            {
+                resetPipelineRecovery(pipeline);
+            }
+            else if (recoverPipeline(pipeline) == false)
+            {
+                return false;
+            }
+        }
+
+        //-----------------------------------------------------------------
+
+        if ((config->statsInterval > 0)
+            && (monotonicNanoseconds() >= nextStats))
+        {
+            logPipelineStats(pipeline);
+            nextStats += config->statsInterval;
+        }
+
+        int64_t now = monotonicNanoseconds();
+
+        if (now >= pipeline->nextPublish)
+        {
+            publishPipelineStats(pipeline);
+            pipeline->nextPublish = now + STATS_PUBLISH_NANOSECONDS;
+        }
+
+        uint32_t statsRequest = statsRequests;
+
+        if (statsRequest != pipeline->statsRequest)
+        {
+            pipeline->statsRequest = statsRequest;
+            logPipelineStats(pipeline);
+        }
+
+        //-----------------------------------------------------------------
+
+        if (benchmark && pipeline->active)
+        {
+            // capture the next frame straight away
+        }
+        else if (config->sync == SYNC_TIMER)
+        {
+            latencyHistogramAdd(&(pipeline->stats.wakeupLatency),
+                                frameSchedulerWait(&(pipeline->scheduler)));
+        }
+        else if (vsyncWait(&(pipeline->vsync)))
+        {
+            latencyHistogramAdd(&(pipeline->stats.wakeupLatency),
+                                pipeline->vsync.lastLateness);
+        }
+        else if (pipeline->active)
+        {
+            pipelineLog(pipeline, LOG_WARNING, "timed out waiting for vsync");
+        }
+    }
+
+    // a benchmark is not over until the queued frames have been written
+
+    stopFrameOutput(&(pipeline->framebufferOutput));
+
+    pipeSinkClosing(&(pipeline->pipe));
+    stopFrameOutput(&(pipeline->pipeOutput));
+
+    if (benchmark)
+    {
+        recordPipelineBenchmark(pipeline, start, &before);
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+static void *
+pipelineThread(
+    void *arg)
+{
+    PIPELINE_T *pipeline = arg;
+
+    if (runPipeline(pipeline) == false)
+    {
+        pipeline->failed = true;
+
+        // stop the other pipelines, so that the process can exit with an
+        // error and be restarted
+
+        *(pipeline->run) = false;
+    }
+
+    return NULL;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+startPipeline(
+    PIPELINE_T *pipeline)
+{
+    return pthread_create(&(pipeline->thread),
+                          NULL,
+                          pipelineThread,
+                          pipeline) == 0;
+}
+
+//-------------------------------------------------------------------------
+
+void
+joinPipeline(
+    PIPELINE_T *pipeline)
+{
+    pthread_join(pipeline->thread, NULL);
+}
+
+//-------------------------------------------------------------------------
+
+void
+closePipeline(
+    PIPELINE_T *pipeline)
+{
+    PIPELINE_CONFIG_T *config = &(pipeline->config);
+
+    //---------------------------------------------------------------------
+
+    if (config->sync == SYNC_TIMER)
+    {
+        pipelineLog(pipeline,
+                    LOG_INFO,
+                    "%"PRIu64" frames, %"PRIu64" missed deadlines (%s),"
+                    " wakeup lateness mean %"PRId64" us max %"PRId64" us",
+                    pipeline->scheduler.wakeups,
+                    pipeline->scheduler.missedDeadlines,
+                    frameSchedulerMissedName(pipeline->scheduler.missed),
+                    frameSchedulerMeanLateness(&(pipeline->scheduler))
+                        / NANOSECONDS_PER_MICROSECOND,
+                    pipeline->scheduler.maxLateness
+                        / NANOSECONDS_PER_MICROSECOND);
+    }
+    else
+    {
+        pipelineLog(pipeline,
+                    LOG_INFO,
+                    "%"PRIu64" frames, %"PRIu64" missed vsyncs",
+                    pipeline->vsync.triggered,
+                    pipeline->vsync.missed);
+
+        destroyVsync(&(pipeline->vsync));
+    }
+
+    logPipelineStats(pipeline);
+
+    if (config->buffers > 1)
+    {
+        pipelineLog(pipeline,
+                    LOG_INFO,
+                    "%d buffers, at most %d update(s) in flight",
+                    config->buffers,
+                    pipeline->ring.maxInFlight);
+    }
+
+    //---------------------------------------------------------------------
+
+    destroyPipelineResources(pipeline);
+
+    destroyFrameOutput(&(pipeline->framebufferOutput));
+    destroyFrameOutput(&(pipeline->pipeOutput));
+    destroyPipeSink(&(pipeline->pipe));
+    destroyFramebufferSink(&(pipeline->framebuffer));
+
+    if (pipeline->pool != NULL)
+    {
+        destroyWorkerPool(pipeline->pool);
+        pipeline->pool = NULL;
+    }
+
+    if (pipeline->outputPool != NULL)
+    {
+        destroyWorkerPool(pipeline->outputPool);
+        pipeline->outputPool = NULL;
+    }
+
+    releaseDisplay(pipeline->sourceDisplay);
+
+    uint32_t i = 0;
+    for (i = 0 ; i < config->destinationCount ; ++i)
+    {
+        releaseDisplay(pipeline->destinations[i].display);
+    }
+}
@@ -0,0 +1,265 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include "displayTypes.h"
+
+#include "changeDetector.h"
+#include "frameExport.h"
+#include "frameOutput.h"
+#include "frameRateGovernor.h"
+#include "framebufferSink.h"
+#include "frameScheduler.h"
+#include "latencyHistogram.h"
+#include "pipeSink.h"
+#include "resourceRing.h"
+#include "statsSegment.h"
+#include "vsync.h"
+#include "workerPool.h"
+
+//-------------------------------------------------------------------------
+
+#define MAX_DESTINATIONS 8
+
+//-------------------------------------------------------------------------
+// What triggers the capture of each frame.
+
+typedef enum
+{
+    SYNC_TIMER,
+    SYNC_VSYNC,
+    SYNC_SYNTHETIC
+} SYNC_T;
+
+//-------------------------------------------------------------------------
+// How hard the pipeline tries to recover from a failed frame. Each tier is
+// attempted a few times, with exponential backoff, before moving on to the
+// next.
+
+typedef enum
+{
+    RECOVERY_RETRY_FRAME,
+    RECOVERY_RECREATE_ELEMENTS,
+    RECOVERY_REOPEN_DISPLAYS,
+    RECOVERY_EXIT
+} RECOVERY_TIER_T;
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    uint32_t sourceDisplayNumber;
+    uint32_t destinationNumbers[MAX_DESTINATIONS];
+    uint32_t destinationCount;
+    const char *framebuffer;
+    uint32_t framebufferWidth;
+    uint32_t framebufferHeight;
+    uint32_t framebufferBits;
+    PIXEL_CONVERT_T framebufferConvert;
+    uint32_t outputQueue;
+    FRAME_RING_POLICY_T outputPolicy;
+    const char *outputPipe;
+    PIPE_FORMAT_T outputPipeFormat;
+    bool exportFrames;
+    uint32_t exportIndex;
+    uint32_t exportSlots;
+    int32_t layerNumber;
+    bool center;
+    int fps;
+    int64_t frameDuration;
+    int64_t spin;
+    FRAME_SCHEDULER_MISSED_T missed;
+    SYNC_T sync;
+    uint32_t vsyncDivisor;
+    int64_t vsyncOffset;
+    double syntheticRate;
+    uint32_t buffers;
+    VC_IMAGE_TYPE_T format;
+    double captureScale;
+    uint32_t captureWidth;
+    uint32_t captureHeight;
+    VC_RECT_T crop;
+    DISPMANX_TRANSFORM_T transform;
+    int64_t displayPoll;
+    uint64_t benchmarkFrames;
+    bool skipUnchanged;
+    uint32_t sampleStride;
+    uint32_t workers;
+    uint32_t stripes;
+    uint32_t firstCore;
+    int64_t statsInterval;
+    double minFps;
+    double maxFps;
+} PIPELINE_CONFIG_T;
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    uint32_t displayNumber;
+    DISPMANX_DISPLAY_HANDLE_T display;
+    DISPMANX_MODEINFO_T info;
+    VC_RECT_T destRect;
+    DISPMANX_ELEMENT_HANDLE_T element;
+} DESTINATION_T;
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    uint64_t framesCaptured;
+    uint64_t framesPresented;
+    uint64_t framesSkipped;
+    uint64_t reconfigurations;
+    uint64_t failures;
+    uint64_t frameRetries;
+    uint64_t elementRecreations;
+    uint64_t displayReopens;
+    uint64_t framebufferBytes;
+    LATENCY_HISTOGRAM_T snapshotLatency;
+    LATENCY_HISTOGRAM_T updateLatency;
+    LATENCY_HISTOGRAM_T wakeupLatency;
+} PIPELINE_STATS_T;
+
+//-------------------------------------------------------------------------
+// Wall clock and CPU time (of the pipeline's thread) taken by a
+// --benchmark run.
+
+typedef struct
+{
+    int64_t elapsed;
+    struct timeval userTime;
+    struct timeval systemTime;
+} PIPELINE_BENCHMARK_T;
+
+//-------------------------------------------------------------------------
+// A source display copied to one or more destination displays, or to a
+// framebuffer, and optionally streamed to a pipe. Each pipeline runs its
+// capture loop on its own thread; displays used by more than one pipeline
+// are only opened once. The pipeline is active while its snapshot
+// resources and elements exist; they are rebuilt when the displays are
+// plugged, unplugged or change mode.
+
+typedef struct
+{
+    PIPELINE_CONFIG_T config;
+    char prefix[32];
+    bool isDaemon;
+    const char *program;
+    volatile bool *run;
+    DISPMANX_DISPLAY_HANDLE_T sourceDisplay;
+    DISPMANX_MODEINFO_T sourceInfo;
+    DESTINATION_T destinations[MAX_DESTINATIONS];
+    FRAMEBUFFER_SINK_T framebuffer;
+    FRAME_OUTPUT_T framebufferOutput;
+    PIPE_SINK_T pipe;
+    FRAME_OUTPUT_T pipeOutput;
+    uint32_t width;
+    uint32_t height;
+    VC_RECT_T sourceRect;
+    DISPMANX_TRANSFORM_T snapshotTransform;
+    bool active;
+    uint32_t displayGeneration;
+    int64_t nextDisplayPoll;
+    RECOVERY_TIER_T recoveryTier;
+    uint32_t recoveryAttempts;
+    int64_t recoveryBackoff;
+    RESOURCE_RING_T ring;
+    CHANGE_DETECTOR_T detector;
+    FRAME_EXPORT_T frameExport;
+    WORKER_POOL_T workerPool;
+    WORKER_POOL_T *pool;
+    WORKER_POOL_T outputWorkerPool;
+    WORKER_POOL_T *outputPool;
+    bool governed;
+    FRAME_SCHEDULER_T scheduler;
+    FRAME_RATE_GOVERNOR_T governor;
+    VSYNC_T vsync;
+    PIPELINE_STATS_T stats;
+    PIPELINE_BENCHMARK_T benchmark;
+    uint32_t statsRequest;
+    STATS_SEGMENT_PIPELINE_T *published;
+    int64_t nextPublish;
+    int64_t rateStart;
+    uint64_t rateFrames;
+    double captureFps;
+    pthread_t thread;
+    bool failed;
+} PIPELINE_T;
+
+//-------------------------------------------------------------------------
+
+void
+requestPipelineStats(void);
+
+void
+pipelineStats(
+    const PIPELINE_T *pipeline,
+    PIPELINE_STATS_T *stats);
+
+void
+initPipeline(
+    PIPELINE_T *pipeline,
+    const PIPELINE_CONFIG_T *config,
+    const char *name,
+    bool isDaemon,
+    const char *program,
+    volatile bool *run);
+
+bool
+openPipeline(
+    PIPELINE_T *pipeline);
+
+bool
+runPipeline(
+    PIPELINE_T *pipeline);
+
+bool
+startPipeline(
+    PIPELINE_T *pipeline);
+
+void
+joinPipeline(
+    PIPELINE_T *pipeline);
+
+void
+closePipeline(
+    PIPELINE_T *pipeline);
+
+//-------------------------------------------------------------------------
+
+#endif
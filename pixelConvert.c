@@ -0,0 +1,376 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <strings.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXEL_CONVERT_X86
+#elif defined(__arm__) || defined(__aarch64__)
+#define PIXEL_CONVERT_NEON
+#endif
+
+#include "cpuFeatures.h"
+#include "pixelConvert.h"
+#include "pixelConvertKernels.h"
+
+//-------------------------------------------------------------------------
+
+static const char *pixelConvertNames[] =
+{
+    "none",
+    "truncate",
+    "dither"
+};
+
+#define PIXEL_CONVERT_COUNT \
+    (sizeof(pixelConvertNames) / sizeof(pixelConvertNames[0]))
+
+static const uint8_t bayer[4][4] =
+{
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+};
+
+// Red and blue lose three bits and green two, so the 0 to 15 threshold
+// is scaled to 0 to 7 and 0 to 3 respectively.
+
+static uint8_t ditherRows[4][32];
+static const uint8_t noDither[32];
+
+static pthread_once_t converterOnce = PTHREAD_ONCE_INIT;
+static CONVERT_ROW_T convertRow = NULL;
+static const char *converterName = NULL;
+
+//-------------------------------------------------------------------------
+
+void
+convertPixelsScalar(
+    uint16_t *dst,
+    const uint8_t *src,
+    uint32_t start,
+    uint32_t end,
+    const uint8_t *dither)
+{
+    uint32_t x = 0;
+    for (x = start ; x < end ; ++x)
+    {
+        const uint8_t *pixel = src + (x * 4);
+        const uint8_t *add = dither + ((x & 3) * 4);
+
+        uint32_t r = pixel[0] + add[0];
+        uint32_t g = pixel[1] + add[1];
+        uint32_t b = pixel[2] + add[2];
+
+        r = (r > 255) ? 255 : r;
+        g = (g > 255) ? 255 : g;
+        b = (b > 255) ? 255 : b;
+
+        dst[x] = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+convertRowScalar(
+    uint16_t *dst,
+    const uint8_t *src,
+    uint32_t width,
+    const uint8_t *dither)
+{
+    convertPixelsScalar(dst, src, 0, width, dither);
+}
+
+//-------------------------------------------------------------------------
+
+#ifdef PIXEL_CONVERT_X86
+
+// Pack the four pixels of each 32 bit lane into RGB565 in the low half
+// of the lane, sign extended so that _mm_packs_epi32 does not saturate.
+
+__attribute__((target("sse2")))
+static __m128i
+packRgb565Sse2(
+    __m128i pixels)
+{
+    __m128i r = _mm_slli_epi32(_mm_and_si128(pixels,
+                                             _mm_set1_epi32(0xF8)),
+                               8);
+    __m128i g = _mm_srli_epi32(_mm_and_si128(pixels,
+                                             _mm_set1_epi32(0xFC00)),
+                               5);
+    __m128i b = _mm_srli_epi32(_mm_and_si128(pixels,
+                                             _mm_set1_epi32(0xF80000)),
+                               19);
+
+    __m128i rgb = _mm_or_si128(_mm_or_si128(r, g), b);
+
+    return _mm_srai_epi32(_mm_slli_epi32(rgb, 16), 16);
+}
+
+//-------------------------------------------------------------------------
+
+__attribute__((target("sse2")))
+static void
+convertRowSse2(
+    uint16_t *dst,
+    const uint8_t *src,
+    uint32_t width,
+    const uint8_t *dither)
+{
+    __m128i add = _mm_loadu_si128((const __m128i *)dither);
+
+    uint32_t x = 0;
+    for (x = 0 ; (x + 8) <= width ; x += 8)
+    {
+        const __m128i *pixels = (const __m128i *)(src + (x * 4));
+
+        __m128i a = _mm_adds_epu8(_mm_loadu_si128(pixels), add);
+        __m128i b = _mm_adds_epu8(_mm_loadu_si128(pixels + 1), add);
+
+        _mm_storeu_si128((__m128i *)(dst + x),
+                         _mm_packs_epi32(packRgb565Sse2(a),
+                                         packRgb565Sse2(b)));
+    }
+
+    convertPixelsScalar(dst, src, x, width, dither);
+}
+
+//-------------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static __m256i
+packRgb565Avx2(
+    __m256i pixels)
+{
+    __m256i r = _mm256_slli_epi32(_mm256_and_si256(pixels,
+                                                   _mm256_set1_epi32(0xF8)),
+                                  8);
+    __m256i g = _mm256_srli_epi32(
+                    _mm256_and_si256(pixels, _mm256_set1_epi32(0xFC00)),
+                    5);
+    __m256i b = _mm256_srli_epi32(
+                    _mm256_and_si256(pixels, _mm256_set1_epi32(0xF80000)),
+                    19);
+
+    __m256i rgb = _mm256_or_si256(_mm256_or_si256(r, g), b);
+
+    return _mm256_srai_epi32(_mm256_slli_epi32(rgb, 16), 16);
+}
+
+//-------------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static void
+convertRowAvx2(
+    uint16_t *dst,
+    const uint8_t *src,
+    uint32_t width,
+    const uint8_t *dither)
+{
+    __m256i add = _mm256_loadu_si256((const __m256i *)dither);
+
+    uint32_t x = 0;
+    for (x = 0 ; (x + 16) <= width ; x += 16)
+    {
+        const __m256i *pixels = (const __m256i *)(src + (x * 4));
+
+        __m256i a = _mm256_adds_epu8(_mm256_loadu_si256(pixels), add);
+        __m256i b = _mm256_adds_epu8(_mm256_loadu_si256(pixels + 1), add);
+
+        // packing works within each 128 bit lane, which leaves the
+        // middle two groups of four pixels swapped
+
+        __m256i packed = _mm256_packs_epi32(packRgb565Avx2(a),
+                                            packRgb565Avx2(b));
+
+        _mm256_storeu_si256((__m256i *)(dst + x),
+                            _mm256_permute4x64_epi64(packed,
+                                                     _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+
+    convertPixelsScalar(dst, src, x, width, dither);
+}
+
+#endif
+
+//-------------------------------------------------------------------------
+
+static const PIXEL_CONVERT_KERNEL_T kernels[] =
+{
+#ifdef PIXEL_CONVERT_X86
+    { "avx2", convertRowAvx2, cpuHasAvx2 },
+    { "sse2", convertRowSse2, cpuHasSse2 },
+#endif
+#ifdef PIXEL_CONVERT_NEON
+    { "neon", convertRowNeon, cpuHasNeon },
+#endif
+    { "scalar", convertRowScalar, NULL }
+};
+
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+//-------------------------------------------------------------------------
+
+static void
+selectConverter(void)
+{
+    uint32_t y = 0;
+    for (y = 0 ; y < 4 ; ++y)
+    {
+        uint32_t x = 0;
+        for (x = 0 ; x < 8 ; ++x)
+        {
+            uint8_t threshold = bayer[y][x & 3];
+
+            ditherRows[y][(x * 4) + 0] = threshold >> 1;
+            ditherRows[y][(x * 4) + 1] = threshold >> 2;
+            ditherRows[y][(x * 4) + 2] = threshold >> 1;
+            ditherRows[y][(x * 4) + 3] = 0;
+        }
+    }
+
+    // the kernels are in order of preference, ending with the scalar
+    // code that is always available
+
+    uint32_t i = 0;
+    while ((kernels[i].available != NULL)
+           && (kernels[i].available() == false))
+    {
+        ++i;
+    }
+
+    convertRow = kernels[i].convertRow;
+    converterName = kernels[i].name;
+}
+
+//-------------------------------------------------------------------------
+// Every kernel built into the program, whether or not the processor can
+// run it (available is NULL for the scalar kernel, which always can).
+
+const PIXEL_CONVERT_KERNEL_T *
+pixelConvertKernels(
+    uint32_t *count)
+{
+    pthread_once(&converterOnce, selectConverter);
+
+    *count = KERNEL_COUNT;
+
+    return kernels;
+}
+
+//-------------------------------------------------------------------------
+// The dither added to row y of a frame.
+
+const uint8_t *
+pixelConvertDither(
+    PIXEL_CONVERT_T convert,
+    uint32_t y)
+{
+    pthread_once(&converterOnce, selectConverter);
+
+    return (convert == PIXEL_CONVERT_DITHER) ? ditherRows[y & 3] : noDither;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+pixelConvertFromName(
+    const char *name,
+    PIXEL_CONVERT_T *convert)
+{
+    size_t i = 0;
+    for (i = 0 ; i < PIXEL_CONVERT_COUNT ; ++i)
+    {
+        if (strcasecmp(pixelConvertNames[i], name) == 0)
+        {
+            *convert = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//-------------------------------------------------------------------------
+
+const char *
+pixelConvertName(
+    PIXEL_CONVERT_T convert)
+{
+    return (convert < PIXEL_CONVERT_COUNT)
+         ? pixelConvertNames[convert]
+         : "unknown";
+}
+
+//-------------------------------------------------------------------------
+// The name of the instruction set used for the conversion.
+
+const char *
+pixelConvertImplementation(void)
+{
+    pthread_once(&converterOnce, selectConverter);
+
+    return converterName;
+}
+
+//-------------------------------------------------------------------------
+// The dither pattern is fixed to the position in the frame, so an
+// unchanged region converts to the same pixels every frame.
+
+void
+convertRgba32ToRgb565(
+    uint8_t *dst,
+    uint32_t dstPitch,
+    const uint8_t *src,
+    uint32_t srcPitch,
+    uint32_t width,
+    uint32_t height,
+    PIXEL_CONVERT_T convert)
+{
+    pthread_once(&converterOnce, selectConverter);
+
+    uint32_t y = 0;
+    for (y = 0 ; y < height ; ++y)
+    {
+        const uint8_t *dither = (convert == PIXEL_CONVERT_DITHER)
+                              ? ditherRows[y & 3]
+                              : noDither;
+
+        convertRow((uint16_t *)(dst + (y * dstPitch)),
+                   src + (y * srcPitch),
+                   width,
+                   dither);
+    }
+}
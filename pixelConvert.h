@@ -0,0 +1,77 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------------------
+// Conversion of RGBA32 (or RGBX32) snapshots to RGB565, for 16 bit
+// framebuffers. The GPU can take RGB565 snapshots itself, but only by
+// truncating each channel, which shows banding in gradients; a 4x4
+// ordered dither hides it. The conversion uses NEON, AVX2 or SSE2 when the
+// processor has them, chosen at run time, and gives exactly the same
+// result as the scalar code whichever is used.
+
+typedef enum
+{
+    PIXEL_CONVERT_NONE,
+    PIXEL_CONVERT_TRUNCATE,
+    PIXEL_CONVERT_DITHER
+} PIXEL_CONVERT_T;
+
+//-------------------------------------------------------------------------
+
+bool
+pixelConvertFromName(
+    const char *name,
+    PIXEL_CONVERT_T *convert);
+
+const char *
+pixelConvertName(
+    PIXEL_CONVERT_T convert);
+
+const char *
+pixelConvertImplementation(void);
+
+void
+convertRgba32ToRgb565(
+    uint8_t *dst,
+    uint32_t dstPitch,
+    const uint8_t *src,
+    uint32_t srcPitch,
+    uint32_t width,
+    uint32_t height,
+    PIXEL_CONVERT_T convert);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,91 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef PIXEL_CONVERT_KERNELS_H
+#define PIXEL_CONVERT_KERNELS_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pixelConvert.h"
+
+//-------------------------------------------------------------------------
+// The row kernels behind convertRgba32ToRgb565(), for the kernels built
+// in separate files and for testing them against each other.
+
+// Converts width pixels of a row. dither holds the amounts added to the
+// R, G, B and A bytes of eight pixels, starting at a multiple of four
+// pixels along the row; it is all zero when truncating.
+
+typedef void (*CONVERT_ROW_T)(
+    uint16_t *dst,
+    const uint8_t *src,
+    uint32_t width,
+    const uint8_t *dither);
+
+typedef struct
+{
+    const char *name;
+    CONVERT_ROW_T convertRow;
+    bool (*available)(void);
+} PIXEL_CONVERT_KERNEL_T;
+
+//-------------------------------------------------------------------------
+
+const PIXEL_CONVERT_KERNEL_T *
+pixelConvertKernels(
+    uint32_t *count);
+
+const uint8_t *
+pixelConvertDither(
+    PIXEL_CONVERT_T convert,
+    uint32_t y);
+
+void
+convertPixelsScalar(
+    uint16_t *dst,
+    const uint8_t *src,
+    uint32_t start,
+    uint32_t end,
+    const uint8_t *dither);
+
+#if defined(__arm__) || defined(__aarch64__)
+
+void
+convertRowNeon(
+    uint16_t *dst,
+    const uint8_t *src,
+    uint32_t width,
+    const uint8_t *dither);
+
+#endif
+
+//-------------------------------------------------------------------------
+
+#endif
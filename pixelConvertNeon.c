@@ -0,0 +1,74 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+// The NEON kernel is in a file of its own so that it can be built for
+// NEON (with -mfpu=neon on 32 bit ARM) while the rest of the program
+// still runs on processors without it; it is only called once
+// cpuHasNeon() says it can be.
+
+#if defined(__arm__) || defined(__aarch64__)
+
+#if !defined(__ARM_NEON)
+#error "pixelConvertNeon.c must be compiled with NEON enabled (-mfpu=neon)"
+#endif
+
+#include <arm_neon.h>
+#include <stdint.h>
+
+#include "pixelConvertKernels.h"
+
+//-------------------------------------------------------------------------
+
+void
+convertRowNeon(
+    uint16_t *dst,
+    const uint8_t *src,
+    uint32_t width,
+    const uint8_t *dither)
+{
+    uint8x8x4_t add = vld4_u8(dither);
+
+    uint32_t x = 0;
+    for (x = 0 ; (x + 8) <= width ; x += 8)
+    {
+        uint8x8x4_t pixels = vld4_u8(src + (x * 4));
+
+        uint8x8_t r = vqadd_u8(pixels.val[0], add.val[0]);
+        uint8x8_t g = vqadd_u8(pixels.val[1], add.val[1]);
+        uint8x8_t b = vqadd_u8(pixels.val[2], add.val[2]);
+
+        uint16x8_t rgb = vshll_n_u8(r, 8);
+        rgb = vsriq_n_u16(rgb, vshll_n_u8(g, 8), 5);
+        rgb = vsriq_n_u16(rgb, vshll_n_u8(b, 8), 11);
+
+        vst1q_u16(dst + x, rgb);
+    }
+
+    convertPixelsScalar(dst, src, x, width, dither);
+}
+
+#endif
@@ -0,0 +1,454 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frameScheduler.h"
+#include "pixelConvert.h"
+#include "pixelConvertKernels.h"
+
+//-------------------------------------------------------------------------
+// Checks that every conversion kernel the processor can run gives exactly
+// the same pixels as convertPixelsScalar(), for widths either side of the
+// kernels' block sizes, rows padded at the end on both sides, unaligned
+// rows and all four rows of the dither pattern, and that nothing is
+// written past the end of a row. With --benchmark, times each kernel
+// converting whole frames instead.
+
+#define DEFAULT_WIDTH 1920
+#define DEFAULT_HEIGHT 1080
+
+#define TEST_HEIGHT 9
+#define TEST_MAX_WIDTH 80
+#define TEST_MAX_PADDING 64
+#define TEST_GUARD 0xA5
+#define TEST_FRAME_WIDTH 37
+
+static const uint32_t testWidths[] =
+{
+    1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 23, 24, 25, 31, 32, 33, 47, 63, 64,
+    65, 79, 80
+};
+
+static const uint32_t testPaddings[] = { 0, 4, 12, 60 };
+
+#define COUNT_OF(array) (sizeof(array) / sizeof(array[0]))
+
+//-------------------------------------------------------------------------
+
+void
+printUsage(
+    FILE *fp,
+    const char *name)
+{
+    fprintf(fp, "\n");
+    fprintf(fp, "Usage: %s <options>\n", name);
+    fprintf(fp, "\n");
+    fprintf(fp, "    --benchmark <frames> - time converting this many");
+    fprintf(fp, " frames with each kernel instead of testing\n");
+    fprintf(fp, "    --width <pixels> - width of benchmark frames");
+    fprintf(fp, " (default %d)\n", DEFAULT_WIDTH);
+    fprintf(fp, "    --height <pixels> - height of benchmark frames");
+    fprintf(fp, " (default %d)\n", DEFAULT_HEIGHT);
+    fprintf(fp, "    --help - print usage and exit\n");
+    fprintf(fp, "\n");
+}
+
+//-------------------------------------------------------------------------
+// Pseudo random bytes, the same on every run. Every fourth byte is pushed
+// towards the top of the range so that the saturating add of the dither
+// is tested often.
+
+static void
+fillPixels(
+    uint8_t *pixels,
+    size_t size)
+{
+    uint32_t state = 0x12345678;
+
+    size_t i = 0;
+    for (i = 0 ; i < size ; ++i)
+    {
+        state = (state * 1103515245) + 12345;
+
+        uint8_t value = state >> 16;
+
+        pixels[i] = ((i % 4) == 1) ? (value | 0xF0) : value;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+testKernel(
+    const PIXEL_CONVERT_KERNEL_T *kernel,
+    const uint8_t *pixels)
+{
+    static const PIXEL_CONVERT_T converts[] =
+    {
+        PIXEL_CONVERT_TRUNCATE,
+        PIXEL_CONVERT_DITHER
+    };
+
+    uint16_t expected[TEST_MAX_WIDTH];
+    uint16_t actual[TEST_MAX_WIDTH + TEST_MAX_PADDING];
+    uint32_t failures = 0;
+    uint32_t cases = 0;
+
+    size_t c = 0;
+    for (c = 0 ; c < COUNT_OF(converts) ; ++c)
+    {
+        size_t w = 0;
+        for (w = 0 ; w < COUNT_OF(testWidths) ; ++w)
+        {
+            uint32_t width = testWidths[w];
+
+            size_t p = 0;
+            for (p = 0 ; p < COUNT_OF(testPaddings) ; ++p)
+            {
+                uint32_t srcPitch = (width * 4) + testPaddings[p];
+
+                uint32_t y = 0;
+                for (y = 0 ; y < TEST_HEIGHT ; ++y)
+                {
+                    // every other row starts a pixel further on, so that
+                    // rows are not all aligned for the vector loads
+
+                    const uint8_t *src = pixels
+                                       + (y * srcPitch)
+                                       + ((y & 1) * 4);
+                    const uint8_t *dither = pixelConvertDither(converts[c],
+                                                               y);
+
+                    convertPixelsScalar(expected, src, 0, width, dither);
+
+                    memset(actual, TEST_GUARD, sizeof(actual));
+                    kernel->convertRow(actual, src, width, dither);
+
+                    ++cases;
+
+                    bool same = memcmp(expected,
+                                       actual,
+                                       width * sizeof(uint16_t)) == 0;
+
+                    const uint8_t *guard = (const uint8_t *)(actual + width);
+                    size_t g = 0;
+                    for (g = 0 ; g < TEST_MAX_PADDING * 2 ; ++g)
+                    {
+                        if (guard[g] != TEST_GUARD)
+                        {
+                            same = false;
+                        }
+                    }
+
+                    if ((same == false) && (failures++ < 10))
+                    {
+                        printf("%s: FAILED, %s width %"PRIu32" pitch %"
+                               PRIu32" row %"PRIu32"\n",
+                               kernel->name,
+                               pixelConvertName(converts[c]),
+                               width,
+                               srcPitch,
+                               y);
+                    }
+                }
+            }
+        }
+    }
+
+    printf("%s: %"PRIu32" of %"PRIu32" rows match the scalar code\n",
+           kernel->name,
+           cases - failures,
+           cases);
+
+    return failures == 0;
+}
+
+//-------------------------------------------------------------------------
+// The frame conversion, with whichever kernel was chosen, against the
+// scalar code row by row, with padding at the end of the rows on both
+// sides.
+
+static bool
+testFrame(
+    const uint8_t *pixels)
+{
+    uint32_t width = TEST_FRAME_WIDTH;
+    uint32_t height = TEST_HEIGHT;
+    uint32_t srcPitch = (width * 4) + 20;
+    uint32_t dstPitch = (width * 2) + 10;
+
+    uint8_t frame[TEST_HEIGHT * ((TEST_FRAME_WIDTH * 2) + 10)];
+    memset(frame, TEST_GUARD, sizeof(frame));
+
+    convertRgba32ToRgb565(frame,
+                          dstPitch,
+                          pixels,
+                          srcPitch,
+                          width,
+                          height,
+                          PIXEL_CONVERT_DITHER);
+
+    bool passed = true;
+
+    uint32_t y = 0;
+    for (y = 0 ; y < height ; ++y)
+    {
+        uint16_t expected[TEST_FRAME_WIDTH];
+        uint16_t actual[TEST_FRAME_WIDTH];
+
+        convertPixelsScalar(expected,
+                            pixels + (y * srcPitch),
+                            0,
+                            width,
+                            pixelConvertDither(PIXEL_CONVERT_DITHER, y));
+
+        memcpy(actual, frame + (y * dstPitch), sizeof(actual));
+
+        const uint8_t *padding = frame + (y * dstPitch) + (width * 2);
+
+        if ((memcmp(expected, actual, sizeof(actual)) != 0)
+            || (padding[0] != TEST_GUARD)
+            || (padding[dstPitch - (width * 2) - 1] != TEST_GUARD))
+        {
+            printf("frame (%s): FAILED, row %"PRIu32"\n",
+                   pixelConvertImplementation(),
+                   y);
+            passed = false;
+        }
+    }
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+runTests(void)
+{
+    size_t size = TEST_HEIGHT * ((TEST_MAX_WIDTH * 4) + TEST_MAX_PADDING + 4);
+    uint8_t *pixels = malloc(size);
+
+    if (pixels == NULL)
+    {
+        printf("out of memory\n");
+        return false;
+    }
+
+    fillPixels(pixels, size);
+
+    uint32_t count = 0;
+    const PIXEL_CONVERT_KERNEL_T *kernels = pixelConvertKernels(&count);
+    bool passed = true;
+
+    uint32_t i = 0;
+    for (i = 0 ; i < count ; ++i)
+    {
+        if ((kernels[i].available != NULL)
+            && (kernels[i].available() == false))
+        {
+            printf("%s: skipped, not supported by this processor\n",
+                   kernels[i].name);
+            continue;
+        }
+
+        if (testKernel(&(kernels[i]), pixels) == false)
+        {
+            passed = false;
+        }
+    }
+
+    if (testFrame(pixels) == false)
+    {
+        passed = false;
+    }
+
+    free(pixels);
+
+    return passed;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+runBenchmark(
+    int frames,
+    uint32_t width,
+    uint32_t height)
+{
+    uint32_t srcPitch = width * 4;
+    uint32_t dstPitch = width * 2;
+
+    uint8_t *src = malloc((size_t)srcPitch * height);
+    uint16_t *dst = malloc((size_t)dstPitch * height);
+
+    if ((src == NULL) || (dst == NULL))
+    {
+        printf("out of memory\n");
+        free(src);
+        free(dst);
+        return false;
+    }
+
+    fillPixels(src, (size_t)srcPitch * height);
+
+    uint32_t count = 0;
+    const PIXEL_CONVERT_KERNEL_T *kernels = pixelConvertKernels(&count);
+
+    uint32_t i = 0;
+    for (i = 0 ; i < count ; ++i)
+    {
+        const PIXEL_CONVERT_KERNEL_T *kernel = &(kernels[i]);
+
+        if ((kernel->available != NULL) && (kernel->available() == false))
+        {
+            continue;
+        }
+
+        int64_t start = monotonicNanoseconds();
+
+        int frame = 0;
+        for (frame = 0 ; frame < frames ; ++frame)
+        {
+            uint32_t y = 0;
+            for (y = 0 ; y < height ; ++y)
+            {
+                kernel->convertRow(dst + (y * width),
+                                   src + (y * srcPitch),
+                                   width,
+                                   pixelConvertDither(PIXEL_CONVERT_DITHER,
+                                                      y));
+            }
+        }
+
+        int64_t elapsed = monotonicNanoseconds() - start;
+        double seconds = (elapsed > 0) ? elapsed / 1e9 : 1e-9;
+        double pixels = (double)width * height * frames;
+
+        printf("%-8s %"PRIu32"x%"PRIu32" %d frames: %.3f ms/frame,"
+               " %.1f Mpixels/s\n",
+               kernel->name,
+               width,
+               height,
+               frames,
+               (seconds * 1e3) / frames,
+               pixels / seconds / 1e6);
+    }
+
+    free(src);
+    free(dst);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+int
+main(
+    int argc,
+    char *argv[])
+{
+    const char *program = basename(argv[0]);
+
+    int frames = 0;
+    int width = DEFAULT_WIDTH;
+    int height = DEFAULT_HEIGHT;
+
+    //---------------------------------------------------------------------
+
+    static const char *sopts = "b:hH:W:";
+    static struct option lopts[] =
+    {
+        { "benchmark", required_argument, NULL, 'b' },
+        { "height", required_argument, NULL, 'H' },
+        { "help", no_argument, NULL, 'h' },
+        { "width", required_argument, NULL, 'W' },
+        { NULL, no_argument, NULL, 0 }
+    };
+
+    int opt = 0;
+
+    while ((opt = getopt_long(argc, argv, sopts, lopts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+
+            frames = atoi(optarg);
+            break;
+
+        case 'h':
+
+            printUsage(stdout, program);
+            exit(EXIT_SUCCESS);
+
+            break;
+
+        case 'H':
+
+            height = atoi(optarg);
+            break;
+
+        case 'W':
+
+            width = atoi(optarg);
+            break;
+
+        default:
+
+            printUsage(stderr, program);
+            exit(EXIT_FAILURE);
+
+            break;
+        }
+    }
+
+    if ((frames < 0) || (width <= 0) || (height <= 0))
+    {
+        fprintf(stderr, "%s: invalid options\n", program);
+        printUsage(stderr, program);
+        exit(EXIT_FAILURE);
+    }
+
+    //---------------------------------------------------------------------
+
+    printf("converter: %s\n", pixelConvertImplementation());
+
+    bool passed = (frames > 0)
+                ? runBenchmark(frames, width, height)
+                : runTests();
+
+    return (passed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -30,6 +30,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <inttypes.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -40,16 +41,17 @@
 #include <syslog.h>
 #include <unistd.h>
 
-#include <bsd/libutil.h>
-
 #include <sys/mman.h>
-#include <sys/time.h>
-
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-but-set-variable"
-#include "bcm_host.h"
-#pragma GCC diagnostic pop
 
+#include "benchmarkReport.h"
+#include "displayBackend.h"
+#include "displayMonitor.h"
+#include "imageFormat.h"
+#include "pidFile.h"
+#include "pipeline.h"
+#include "pixelConvert.h"
+#include "softwareBackend.h"
+#include "statsSegment.h"
 #include "syslogUtilities.h"
 
 //-------------------------------------------------------------------------
@@ -62,6 +64,67 @@
 #define DEFAULT_DESTINATION_DISPLAY_NUMBER 5
 #define DEFAULT_LAYER_NUMBER 1
 #define DEFAULT_FPS 10
+#define DEFAULT_SPIN_MICROSECONDS 0
+#define DEFAULT_MISSED FRAME_SCHEDULER_SKIP
+#define DEFAULT_VSYNC_DIVISOR 1
+#define DEFAULT_VSYNC_OFFSET_MICROSECONDS 0
+#define DEFAULT_SYNTHETIC_RATE 60.0
+#define DEFAULT_BUFFERS 3
+#define DEFAULT_FORMAT VC_IMAGE_RGBA32
+#define DEFAULT_SAMPLE_STRIDE 1
+#define DEFAULT_WORKERS 1
+#define DEFAULT_OUTPUT_QUEUE 2
+#define DEFAULT_OUTPUT_POLICY FRAME_RING_DROP_OLDEST
+#define DEFAULT_EXPORT_SLOTS FRAME_EXPORT_DEFAULT_SLOTS
+#define DEFAULT_OUTPUT_PIPE_FORMAT PIPE_FORMAT_RAW
+#define DEFAULT_STATS_INTERVAL 0
+#define DEFAULT_DISPLAY_POLL_MILLISECONDS 1000
+#define MAX_PIPELINES 8
+#define PIPELINE_DEFINITION_SIZE 256
+
+//-------------------------------------------------------------------------
+// Options that only have a long form.
+
+enum
+{
+    OPTION_SPIN = 256,
+    OPTION_MISSED,
+    OPTION_SYNC,
+    OPTION_VSYNC_DIVISOR,
+    OPTION_VSYNC_OFFSET,
+    OPTION_SYNTHETIC_RATE,
+    OPTION_BUFFERS,
+    OPTION_SKIP_UNCHANGED,
+    OPTION_SAMPLE_STRIDE,
+    OPTION_STATS,
+    OPTION_MIN_FPS,
+    OPTION_MAX_FPS,
+    OPTION_PIPELINE,
+    OPTION_FORMAT,
+    OPTION_CAPTURE_SCALE,
+    OPTION_CAPTURE_SIZE,
+    OPTION_CROP,
+    OPTION_ROTATE,
+    OPTION_FLIP,
+    OPTION_DISPLAY_POLL,
+    OPTION_STATS_FILE,
+    OPTION_BENCHMARK,
+    OPTION_JSON,
+    OPTION_BACKEND,
+    OPTION_SOFTWARE,
+    OPTION_DEST_FB,
+    OPTION_FB_GEOMETRY,
+    OPTION_FB_CONVERT,
+    OPTION_WORKERS,
+    OPTION_STRIPES,
+    OPTION_OUTPUT_QUEUE,
+    OPTION_OUTPUT_POLICY,
+    OPTION_EXPORT,
+    OPTION_EXPORT_SLOTS,
+    OPTION_OUTPUT_PIPE,
+    OPTION_OUTPUT_PIPE_FORMAT,
+    OPTION_BENCHMARK_WORKERS
+};
 
 //-------------------------------------------------------------------------
 
@@ -80,14 +143,118 @@ printUsage(
     fprintf(fp, "    --daemon - start in the background as a daemon\n");
     fprintf(fp, "    --source <number> - Raspberry Pi display number");
     fprintf(fp, " (default %d)\n", DEFAULT_SOURCE_DISPLAY_NUMBER);
-    fprintf(fp, "    --destination <number> - Raspberry Pi display number");
+    fprintf(fp, "    --destination <number>[,<number>...] - Raspberry Pi");
+    fprintf(fp, " display number(s), up to %d", MAX_DESTINATIONS);
     fprintf(fp, " (default %d)\n", DEFAULT_DESTINATION_DISPLAY_NUMBER);
+    fprintf(fp, "    --dest-fb <device> - copy to this framebuffer");
+    fprintf(fp, " (e.g. /dev/fb1) instead of the destination display(s)\n");
+    fprintf(fp, "    --fb-geometry <width>x<height>x<bits> - geometry");
+    fprintf(fp, " of --dest-fb when it is a regular file\n");
+    fprintf(fp, "    --fb-convert <none|truncate|dither> - convert");
+    fprintf(fp, " rgbx32 snapshots to a 16 bit --dest-fb on the CPU");
+    fprintf(fp, " (default none)\n");
+    fprintf(fp, "    --output-pipe <file|-> - also stream every captured");
+    fprintf(fp, " frame to this FIFO, file or standard output\n");
+    fprintf(fp, "    --output-pipe-format <raw|y4m> - format of the");
+    fprintf(fp, " --output-pipe stream (default %s)\n",
+            pipeFormatName(DEFAULT_OUTPUT_PIPE_FORMAT));
+    fprintf(fp, "    --output-queue <0-%d> - frames queued for the",
+            FRAME_RING_MAX_CAPACITY);
+    fprintf(fp, " output threads writing to --dest-fb and --output-pipe,");
+    fprintf(fp, " 0 writes to --dest-fb on the capture thread");
+    fprintf(fp, " (default %d)\n", DEFAULT_OUTPUT_QUEUE);
+    fprintf(fp, "    --output-policy <drop-oldest|block> - what to do");
+    fprintf(fp, " when the output queue is full (default %s)\n",
+            frameRingPolicyName(DEFAULT_OUTPUT_POLICY));
+    fprintf(fp, "    --export - publish each captured frame in shared");
+    fprintf(fp, " memory (/dev/shm/raspi2raspi-<pipeline>), for");
+    fprintf(fp, " raspi2raspi-grab\n");
+    fprintf(fp, "    --export-slots <2-%d> - frames kept in shared",
+            FRAME_EXPORT_MAX_SLOTS);
+    fprintf(fp, " memory (default %d)\n", DEFAULT_EXPORT_SLOTS);
     fprintf(fp, "    --fps <fps> - set desired frames per second");
     fprintf(fp, " (default %d frames per second)\n", DEFAULT_FPS);
+    fprintf(fp, "    --min-fps <fps> - lowest frame rate when the");
+    fprintf(fp, " source is static (implies --skip-unchanged)\n");
+    fprintf(fp, "    --max-fps <fps> - frame rate when the source is");
+    fprintf(fp, " changing (default --fps)\n");
+    fprintf(fp, "    --spin <microseconds> - sleep until this long before");
+    fprintf(fp, " each frame, then busy wait (default %d)\n",
+            DEFAULT_SPIN_MICROSECONDS);
+    fprintf(fp, "    --missed <catchup|skip|rephase> - what to do when");
+    fprintf(fp, " a frame misses its deadline (default %s)\n",
+            frameSchedulerMissedName(DEFAULT_MISSED));
+    fprintf(fp, "    --sync <timer|vsync|synthetic> - what triggers each");
+    fprintf(fp, " capture (default timer)\n");
+    fprintf(fp, "    --vsync-divisor <number> - capture every Nth vsync");
+    fprintf(fp, " (default %d)\n", DEFAULT_VSYNC_DIVISOR);
+    fprintf(fp, "    --vsync-offset <microseconds> - delay capture this");
+    fprintf(fp, " long after vsync (default %d)\n",
+            DEFAULT_VSYNC_OFFSET_MICROSECONDS);
+    fprintf(fp, "    --synthetic-rate <hz> - rate of the synthetic vsync");
+    fprintf(fp, " (default %.0f)\n", DEFAULT_SYNTHETIC_RATE);
+    fprintf(fp, "    --buffers <1-%d> - number of snapshot buffers",
+            RESOURCE_RING_MAX_BUFFERS);
+    fprintf(fp, " (default %d)\n", DEFAULT_BUFFERS);
+    fprintf(fp, "    --format <rgb565|rgb888|rgba32|rgbx32> - pixel format");
+    fprintf(fp, " of the snapshot (default %s)\n",
+            imageFormatName(DEFAULT_FORMAT));
+    fprintf(fp, "    --capture-scale <scale> - capture at this fraction");
+    fprintf(fp, " of the destination size and upscale (default 1.0)\n");
+    fprintf(fp, "    --capture-size <width>x<height> - capture at this");
+    fprintf(fp, " size and scale to the destination\n");
+    fprintf(fp, "    --crop <x>,<y>,<width>,<height> - only copy this");
+    fprintf(fp, " region of the source display\n");
+    fprintf(fp, "    --rotate <0|90|180|270> - rotate the copy clockwise");
+    fprintf(fp, " by this many degrees (default 0)\n");
+    fprintf(fp, "    --flip <h|v|hv> - flip the copy horizontally");
+    fprintf(fp, " and/or vertically\n");
+    fprintf(fp, "    --skip-unchanged - do not update the destination");
+    fprintf(fp, " if the snapshot has not changed\n");
+    fprintf(fp, "    --sample-stride <number> - compare every Nth pixel");
+    fprintf(fp, " of every Nth band of rows (default %d)\n",
+            DEFAULT_SAMPLE_STRIDE);
+    fprintf(fp, "    --workers <1-%d> - threads used for pixel work",
+            WORKER_POOL_MAX_THREADS);
+    fprintf(fp, " on the CPU (default %d)\n", DEFAULT_WORKERS);
+    fprintf(fp, "    --stripes <1-%d> - stripes each frame's pixel work",
+            WORKER_POOL_MAX_STRIPES);
+    fprintf(fp, " is split into (default --workers)\n");
+    fprintf(fp, "    --stats <seconds> - log frame statistics at this");
+    fprintf(fp, " interval (default %d, never)\n", DEFAULT_STATS_INTERVAL);
+    fprintf(fp, "    --stats-file <file> - publish live statistics in");
+    fprintf(fp, " this file, for raspi2raspi-stat (e.g. %s)\n",
+            STATS_SEGMENT_DEFAULT_PATH);
+    fprintf(fp, "    --display-poll <milliseconds> - how often to check");
+    fprintf(fp, " for display changes (default %d, 0 never)\n",
+            DEFAULT_DISPLAY_POLL_MILLISECONDS);
     fprintf(fp, "    --layer <number> - layer number");
     fprintf(fp, " (default %d)\n", DEFAULT_LAYER_NUMBER);
     fprintf(fp, "    --center - center the source in the destination");
     fprintf(fp, " without upscaling\n");
+    fprintf(fp, "    --pipeline <definition> - add a pipeline, may be");
+    fprintf(fp, " given up to %d times, where <definition> is\n",
+            MAX_PIPELINES);
+    fprintf(fp, "        source=<number>,destination=<number>[:<number>...]");
+    fprintf(fp, ",fps=<fps>,\n");
+    fprintf(fp, "        layer=<number>,format=<format>,center,");
+    fprintf(fp, "fb=<device>,pipe=<file>,export\n");
+    fprintf(fp, "        (options not given default to the values of the");
+    fprintf(fp, " command line options)\n");
+    fprintf(fp, "    --backend <%s> - how to access", displayBackendNames());
+    fprintf(fp, " the displays (default %s)\n", defaultDisplayBackendName());
+    fprintf(fp, "    --software <definition> - configure the software");
+    fprintf(fp, " backend, where <definition> is\n");
+    fprintf(fp, "        size=<width>x<height>,display=<number>:<width>x");
+    fprintf(fp, "<height>,\n");
+    fprintf(fp, "        snapshot=<microseconds>,update=<microseconds>,");
+    fprintf(fp, "vsync=<hz>,change=<snapshots>\n");
+    fprintf(fp, "    --benchmark <frames> - capture this many frames");
+    fprintf(fp, " as fast as possible, then print a report and exit\n");
+    fprintf(fp, "    --benchmark-workers <1-%d> - repeat the benchmark",
+            WORKER_POOL_MAX_THREADS);
+    fprintf(fp, " with 1 to this many workers and report the speed-up\n");
+    fprintf(fp, "    --json - print the benchmark report as JSON\n");
     fprintf(fp, "    --pidfile <pidfile> - create and lock PID file");
     fprintf(fp, " (if being run as a daemon)\n");
     fprintf(fp, "    --help - print usage and exit\n");
@@ -96,6 +263,193 @@ printUsage(
 
 //-------------------------------------------------------------------------
 
+static uint32_t
+parseDisplayList(
+    const char *list,
+    char separator,
+    uint32_t *numbers)
+{
+    uint32_t count = 0;
+    const char *s = list;
+
+    while (*s != '\0')
+    {
+        char *end = NULL;
+        long number = strtol(s, &end, 10);
+
+        if ((end == s) || (number < 0) || (count == MAX_DESTINATIONS))
+        {
+            return 0;
+        }
+
+        numbers[count++] = number;
+
+        if (*end == separator)
+        {
+            ++end;
+        }
+        else if (*end != '\0')
+        {
+            return 0;
+        }
+
+        s = end;
+    }
+
+    return count;
+}
+
+//-------------------------------------------------------------------------
+// Parse a pipeline definition of comma separated key=value pairs. Keys
+// that are not given keep the values already in config. The definition is
+// split up in buffer, which the fb and pipe values then point into, so it
+// must last as long as config.
+
+static bool
+parsePipeline(
+    const char *definition,
+    char *buffer,
+    size_t size,
+    PIPELINE_CONFIG_T *config)
+{
+    if (strlen(definition) >= size)
+    {
+        return false;
+    }
+
+    strcpy(buffer, definition);
+
+    char *saveptr = NULL;
+    char *token = strtok_r(buffer, ",", &saveptr);
+
+    while (token != NULL)
+    {
+        char *value = strchr(token, '=');
+
+        if (value != NULL)
+        {
+            *value++ = '\0';
+        }
+
+        if (strcmp(token, "center") == 0)
+        {
+            config->center = true;
+        }
+        else if (strcmp(token, "export") == 0)
+        {
+            config->exportFrames = true;
+        }
+        else if (value == NULL)
+        {
+            return false;
+        }
+        else if (strcmp(token, "source") == 0)
+        {
+            config->sourceDisplayNumber = atoi(value);
+        }
+        else if (strcmp(token, "destination") == 0)
+        {
+            config->destinationCount
+                = parseDisplayList(value, ':', config->destinationNumbers);
+
+            if (config->destinationCount == 0)
+            {
+                return false;
+            }
+        }
+        else if (strcmp(token, "fps") == 0)
+        {
+            if (atoi(value) <= 0)
+            {
+                return false;
+            }
+
+            config->fps = atoi(value);
+            config->frameDuration = NANOSECONDS_PER_SECOND / config->fps;
+        }
+        else if (strcmp(token, "layer") == 0)
+        {
+            config->layerNumber = atoi(value);
+        }
+        else if (strcmp(token, "format") == 0)
+        {
+            if (imageFormatFromName(value, &(config->format)) == false)
+            {
+                return false;
+            }
+        }
+        else if (strcmp(token, "fb") == 0)
+        {
+            config->framebuffer = value;
+        }
+        else if (strcmp(token, "pipe") == 0)
+        {
+            config->outputPipe = value;
+        }
+        else
+        {
+            return false;
+        }
+
+        token = strtok_r(NULL, ",", &saveptr);
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// The frame rate governor only runs with the timer, between --min-fps and
+// --max-fps (or --fps). Combinations it would silently ignore are errors.
+
+static bool
+checkFrameRates(
+    const PIPELINE_CONFIG_T *config,
+    const char *program)
+{
+    if ((config->minFps < 0.0) || (config->maxFps < 0.0))
+    {
+        fprintf(stderr, "%s: --min-fps and --max-fps must be positive\n",
+                program);
+        return false;
+    }
+
+    if ((config->maxFps > 0.0) && (config->minFps == 0.0))
+    {
+        fprintf(stderr, "%s: --max-fps needs --min-fps\n", program);
+        return false;
+    }
+
+    if (config->minFps == 0.0)
+    {
+        return true;
+    }
+
+    if (config->sync != SYNC_TIMER)
+    {
+        fprintf(stderr,
+                "%s: --min-fps can not be used with --sync %s\n",
+                program,
+                (config->sync == SYNC_VSYNC) ? "vsync" : "synthetic");
+        return false;
+    }
+
+    double maxFps = (config->maxFps > 0.0) ? config->maxFps : config->fps;
+
+    if (config->minFps > maxFps)
+    {
+        fprintf(stderr,
+                "%s: --min-fps %g is above the highest frame rate %g\n",
+                program,
+                config->minFps,
+                maxFps);
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
 static void
 signalHandler(
     int signalNumber)
@@ -107,6 +461,11 @@ signalHandler(
 
         run = false;
         break;
+
+    case SIGUSR1:
+
+        requestPipelineStats();
+        break;
     };
 }
 
@@ -119,14 +478,56 @@ main(
 {
     const char *program = basename(argv[0]);
 
-    int fps = DEFAULT_FPS;
-    suseconds_t frameDuration =  1000000 / fps;
-    bool center = false;
+    PIPELINE_CONFIG_T config =
+    {
+        .sourceDisplayNumber = DEFAULT_SOURCE_DISPLAY_NUMBER,
+        .destinationNumbers = { DEFAULT_DESTINATION_DISPLAY_NUMBER },
+        .destinationCount = 1,
+        .layerNumber = DEFAULT_LAYER_NUMBER,
+        .center = false,
+        .fps = DEFAULT_FPS,
+        .frameDuration = NANOSECONDS_PER_SECOND / DEFAULT_FPS,
+        .spin = DEFAULT_SPIN_MICROSECONDS * NANOSECONDS_PER_MICROSECOND,
+        .missed = DEFAULT_MISSED,
+        .sync = SYNC_TIMER,
+        .vsyncDivisor = DEFAULT_VSYNC_DIVISOR,
+        .vsyncOffset = DEFAULT_VSYNC_OFFSET_MICROSECONDS
+                     * NANOSECONDS_PER_MICROSECOND,
+        .syntheticRate = DEFAULT_SYNTHETIC_RATE,
+        .buffers = DEFAULT_BUFFERS,
+        .format = DEFAULT_FORMAT,
+        .captureScale = 1.0,
+        .captureWidth = 0,
+        .captureHeight = 0,
+        .crop = { 0, 0, 0, 0 },
+        .transform = DISPMANX_NO_ROTATE,
+        .displayPoll = DEFAULT_DISPLAY_POLL_MILLISECONDS
+                     * NANOSECONDS_PER_MILLISECOND,
+        .skipUnchanged = false,
+        .sampleStride = DEFAULT_SAMPLE_STRIDE,
+        .workers = DEFAULT_WORKERS,
+        .stripes = 0,
+        .firstCore = 1,
+        .outputQueue = DEFAULT_OUTPUT_QUEUE,
+        .outputPolicy = DEFAULT_OUTPUT_POLICY,
+        .outputPipe = NULL,
+        .outputPipeFormat = DEFAULT_OUTPUT_PIPE_FORMAT,
+        .exportFrames = false,
+        .exportIndex = 0,
+        .exportSlots = DEFAULT_EXPORT_SLOTS,
+        .statsInterval = DEFAULT_STATS_INTERVAL * NANOSECONDS_PER_SECOND,
+        .minFps = 0.0,
+        .maxFps = 0.0
+    };
+
     bool isDaemon =  false;
-    uint32_t sourceDisplayNumber = DEFAULT_SOURCE_DISPLAY_NUMBER;
-    uint32_t destDisplayNumber = DEFAULT_DESTINATION_DISPLAY_NUMBER;
-    int32_t layerNumber = DEFAULT_LAYER_NUMBER;
+    const char *pipelineDefinitions[MAX_PIPELINES];
+    uint32_t pipelineCount = 0;
     const char *pidfile = NULL;
+    const char *statsFile = NULL;
+    bool json = false;
+    uint32_t benchmarkWorkers = 0;
+    const char *backendName = NULL;
 
     //---------------------------------------------------------------------
 
@@ -141,6 +542,49 @@ main(
         { "source", required_argument, NULL, 's' },
         { "center", no_argument, NULL, 'c' },
         { "daemon", no_argument, NULL, 'D' },
+        { "spin", required_argument, NULL, OPTION_SPIN },
+        { "missed", required_argument, NULL, OPTION_MISSED },
+        { "sync", required_argument, NULL, OPTION_SYNC },
+        { "vsync-divisor", required_argument, NULL, OPTION_VSYNC_DIVISOR },
+        { "vsync-offset", required_argument, NULL, OPTION_VSYNC_OFFSET },
+        { "synthetic-rate", required_argument, NULL, OPTION_SYNTHETIC_RATE },
+        { "buffers", required_argument, NULL, OPTION_BUFFERS },
+        { "skip-unchanged", no_argument, NULL, OPTION_SKIP_UNCHANGED },
+        { "sample-stride", required_argument, NULL, OPTION_SAMPLE_STRIDE },
+        { "workers", required_argument, NULL, OPTION_WORKERS },
+        { "stripes", required_argument, NULL, OPTION_STRIPES },
+        { "stats", required_argument, NULL, OPTION_STATS },
+        { "stats-file", required_argument, NULL, OPTION_STATS_FILE },
+        { "benchmark", required_argument, NULL, OPTION_BENCHMARK },
+        { "benchmark-workers",
+          required_argument,
+          NULL,
+          OPTION_BENCHMARK_WORKERS },
+        { "json", no_argument, NULL, OPTION_JSON },
+        { "backend", required_argument, NULL, OPTION_BACKEND },
+        { "software", required_argument, NULL, OPTION_SOFTWARE },
+        { "min-fps", required_argument, NULL, OPTION_MIN_FPS },
+        { "max-fps", required_argument, NULL, OPTION_MAX_FPS },
+        { "pipeline", required_argument, NULL, OPTION_PIPELINE },
+        { "format", required_argument, NULL, OPTION_FORMAT },
+        { "capture-scale", required_argument, NULL, OPTION_CAPTURE_SCALE },
+        { "capture-size", required_argument, NULL, OPTION_CAPTURE_SIZE },
+        { "crop", required_argument, NULL, OPTION_CROP },
+        { "rotate", required_argument, NULL, OPTION_ROTATE },
+        { "flip", required_argument, NULL, OPTION_FLIP },
+        { "display-poll", required_argument, NULL, OPTION_DISPLAY_POLL },
+        { "dest-fb", required_argument, NULL, OPTION_DEST_FB },
+        { "fb-geometry", required_argument, NULL, OPTION_FB_GEOMETRY },
+        { "fb-convert", required_argument, NULL, OPTION_FB_CONVERT },
+        { "output-queue", required_argument, NULL, OPTION_OUTPUT_QUEUE },
+        { "output-policy", required_argument, NULL, OPTION_OUTPUT_POLICY },
+        { "export", no_argument, NULL, OPTION_EXPORT },
+        { "output-pipe", required_argument, NULL, OPTION_OUTPUT_PIPE },
+        { "output-pipe-format",
+          required_argument,
+          NULL,
+          OPTION_OUTPUT_PIPE_FORMAT },
+        { "export-slots", required_argument, NULL, OPTION_EXPORT_SLOTS },
         { NULL, no_argument, NULL, 0 }
     };
 
@@ -152,22 +596,443 @@ main(
         {
         case 'd':
 
-            destDisplayNumber = atoi(optarg);
+            config.destinationCount
+                = parseDisplayList(optarg, ',', config.destinationNumbers);
+
+            if (config.destinationCount == 0)
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
             break;
 
         case 'f':
 
-            fps = atoi(optarg);
+            config.fps = atoi(optarg);
+
+            if (config.fps > 0)
+            {
+                config.frameDuration = NANOSECONDS_PER_SECOND / config.fps;
+            }
+            else
+            {
+                config.fps = NANOSECONDS_PER_SECOND / config.frameDuration;
+            }
+
+            break;
+
+        case OPTION_SPIN:
+
+            config.spin = atoi(optarg) * NANOSECONDS_PER_MICROSECOND;
+
+            if (config.spin < 0)
+            {
+                config.spin = 0;
+            }
+
+            break;
+
+        case OPTION_MISSED:
+
+            if (strcmp(optarg, "catchup") == 0)
+            {
+                config.missed = FRAME_SCHEDULER_CATCH_UP;
+            }
+            else if (strcmp(optarg, "skip") == 0)
+            {
+                config.missed = FRAME_SCHEDULER_SKIP;
+            }
+            else if (strcmp(optarg, "rephase") == 0)
+            {
+                config.missed = FRAME_SCHEDULER_REPHASE;
+            }
+            else
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_SYNC:
 
-            if (fps > 0)
+            if (strcmp(optarg, "timer") == 0)
+            {
+                config.sync = SYNC_TIMER;
+            }
+            else if (strcmp(optarg, "vsync") == 0)
             {
-                frameDuration = 1000000 / fps;
+                config.sync = SYNC_VSYNC;
+            }
+            else if (strcmp(optarg, "synthetic") == 0)
+            {
+                config.sync = SYNC_SYNTHETIC;
             }
             else
             {
-                fps = 1000000 / frameDuration;
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_VSYNC_DIVISOR:
+
+            if (atoi(optarg) > 0)
+            {
+                config.vsyncDivisor = atoi(optarg);
+            }
+
+            break;
+
+        case OPTION_VSYNC_OFFSET:
+
+            config.vsyncOffset = atoi(optarg) * NANOSECONDS_PER_MICROSECOND;
+            break;
+
+        case OPTION_SYNTHETIC_RATE:
+
+            if (atof(optarg) > 0.0)
+            {
+                config.syntheticRate = atof(optarg);
+            }
+
+            break;
+
+        case OPTION_BUFFERS:
+
+            config.buffers = atoi(optarg);
+
+            if ((config.buffers < 1)
+                || (config.buffers > RESOURCE_RING_MAX_BUFFERS))
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_SKIP_UNCHANGED:
+
+            config.skipUnchanged = true;
+            break;
+
+        case OPTION_SAMPLE_STRIDE:
+
+            if (atoi(optarg) > 0)
+            {
+                config.sampleStride = atoi(optarg);
+            }
+
+            break;
+
+        case OPTION_WORKERS:
+
+            config.workers = atoi(optarg);
+
+            if ((config.workers < 1)
+                || (config.workers > WORKER_POOL_MAX_THREADS))
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_STRIPES:
+
+            config.stripes = atoi(optarg);
+
+            if ((config.stripes < 1)
+                || (config.stripes > WORKER_POOL_MAX_STRIPES))
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_STATS:
+
+            config.statsInterval = atoi(optarg) * NANOSECONDS_PER_SECOND;
+            break;
+
+        case OPTION_MIN_FPS:
+
+            config.minFps = atof(optarg);
+            break;
+
+        case OPTION_MAX_FPS:
+
+            config.maxFps = atof(optarg);
+            break;
+
+        case OPTION_FORMAT:
+
+            if (imageFormatFromName(optarg, &(config.format)) == false)
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_CAPTURE_SCALE:
+
+            config.captureScale = atof(optarg);
+
+            if ((config.captureScale <= 0.0) || (config.captureScale > 1.0))
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_CAPTURE_SIZE:
+
+            if ((sscanf(optarg,
+                        "%ux%u",
+                        &(config.captureWidth),
+                        &(config.captureHeight)) != 2)
+                || (config.captureWidth == 0)
+                || (config.captureHeight == 0))
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_CROP:
+
+            if ((sscanf(optarg,
+                        "%d,%d,%d,%d",
+                        &(config.crop.x),
+                        &(config.crop.y),
+                        &(config.crop.width),
+                        &(config.crop.height)) != 4)
+                || (config.crop.x < 0)
+                || (config.crop.y < 0)
+                || (config.crop.width <= 0)
+                || (config.crop.height <= 0))
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_ROTATE:
+
+            config.transform &= ~DISPMANX_ROTATE_270;
+
+            switch (atoi(optarg))
+            {
+            case 0:
+
+                config.transform |= DISPMANX_NO_ROTATE;
+                break;
+
+            case 90:
+
+                config.transform |= DISPMANX_ROTATE_90;
+                break;
+
+            case 180:
+
+                config.transform |= DISPMANX_ROTATE_180;
+                break;
+
+            case 270:
+
+                config.transform |= DISPMANX_ROTATE_270;
+                break;
+
+            default:
+
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+
+                break;
+            }
+
+            break;
+
+        case OPTION_FLIP:
+
+            if (strspn(optarg, "hv") != strlen(optarg))
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            if (strchr(optarg, 'h') != NULL)
+            {
+                config.transform |= DISPMANX_FLIP_HRIZ;
+            }
+
+            if (strchr(optarg, 'v') != NULL)
+            {
+                config.transform |= DISPMANX_FLIP_VERT;
+            }
+
+            break;
+
+        case OPTION_BENCHMARK:
+
+            config.benchmarkFrames = strtoull(optarg, NULL, 10);
+            break;
+
+        case OPTION_BENCHMARK_WORKERS:
+
+            benchmarkWorkers = atoi(optarg);
+
+            if ((benchmarkWorkers < 1)
+                || (benchmarkWorkers > WORKER_POOL_MAX_THREADS))
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_BACKEND:
+
+            backendName = optarg;
+            break;
+
+        case OPTION_SOFTWARE:
+
+            if (configureSoftwareBackend(optarg) == false)
+            {
+                fprintf(stderr,
+                        "%s: invalid software backend definition \"%s\"\n",
+                        program,
+                        optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_JSON:
+
+            json = true;
+            break;
+
+        case OPTION_STATS_FILE:
+
+            statsFile = optarg;
+            break;
+
+        case OPTION_DEST_FB:
+
+            config.framebuffer = optarg;
+            break;
+
+        case OPTION_FB_GEOMETRY:
+
+            if ((sscanf(optarg,
+                        "%ux%ux%u",
+                        &(config.framebufferWidth),
+                        &(config.framebufferHeight),
+                        &(config.framebufferBits)) != 3)
+                || (config.framebufferWidth == 0)
+                || (config.framebufferHeight == 0)
+                || ((config.framebufferBits != 16)
+                    && (config.framebufferBits != 24)
+                    && (config.framebufferBits != 32)))
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_FB_CONVERT:
+
+            if (pixelConvertFromName(optarg,
+                                     &(config.framebufferConvert)) == false)
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_OUTPUT_QUEUE:
+
+            config.outputQueue = atoi(optarg);
+
+            if ((atoi(optarg) < 0)
+                || (config.outputQueue > FRAME_RING_MAX_CAPACITY))
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_OUTPUT_PIPE:
+
+            config.outputPipe = optarg;
+            break;
+
+        case OPTION_OUTPUT_PIPE_FORMAT:
+
+            if (pipeFormatFromName(optarg,
+                                   &(config.outputPipeFormat)) == false)
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_EXPORT:
+
+            config.exportFrames = true;
+            break;
+
+        case OPTION_EXPORT_SLOTS:
+
+            config.exportSlots = atoi(optarg);
+
+            if ((config.exportSlots < 2)
+                || (config.exportSlots > FRAME_EXPORT_MAX_SLOTS))
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_OUTPUT_POLICY:
+
+            if (frameRingPolicyFromName(optarg,
+                                        &(config.outputPolicy)) == false)
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPTION_DISPLAY_POLL:
+
+            config.displayPoll = atoi(optarg) * NANOSECONDS_PER_MILLISECOND;
+            break;
+
+        case OPTION_PIPELINE:
+
+            if (pipelineCount == MAX_PIPELINES)
+            {
+                printUsage(stderr, program);
+                exit(EXIT_FAILURE);
             }
 
+            pipelineDefinitions[pipelineCount++] = optarg;
             break;
 
         case 'h':
@@ -179,12 +1044,12 @@ main(
 
         case 'l':
 
-            layerNumber = atoi(optarg);
+            config.layerNumber = atoi(optarg);
             break;
 
         case 'c':
 
-            center = true;
+            config.center = true;
             break;
 
         case 'p':
@@ -195,7 +1060,7 @@ main(
 
         case 's':
 
-            sourceDisplayNumber = atoi(optarg);
+            config.sourceDisplayNumber = atoi(optarg);
             break;
 
         case 'D':
@@ -212,6 +1077,114 @@ main(
         }
     }
 
+    // The benchmark report is printed on stdout, which a daemon does not
+    // have.
+
+    if (isDaemon && (config.benchmarkFrames > 0))
+    {
+        fprintf(stderr,
+                "%s: --benchmark can not be used with --daemon\n",
+                program);
+        exit(EXIT_FAILURE);
+    }
+
+    if ((benchmarkWorkers > 0) && (config.benchmarkFrames == 0))
+    {
+        fprintf(stderr,
+                "%s: --benchmark-workers needs --benchmark\n",
+                program);
+        exit(EXIT_FAILURE);
+    }
+
+    //---------------------------------------------------------------------
+    // Without any --pipeline options, the command line options define a
+    // single pipeline.
+
+    PIPELINE_CONFIG_T configs[MAX_PIPELINES];
+    char definitions[MAX_PIPELINES][PIPELINE_DEFINITION_SIZE];
+
+    if (pipelineCount == 0)
+    {
+        configs[0] = config;
+        pipelineCount = 1;
+    }
+    else
+    {
+        uint32_t vsyncPipelines = 0;
+        uint32_t outputPipes = 0;
+
+        uint32_t i = 0;
+        for (i = 0 ; i < pipelineCount ; ++i)
+        {
+            configs[i] = config;
+
+            if (parsePipeline(pipelineDefinitions[i],
+                              definitions[i],
+                              sizeof(definitions[i]),
+                              &(configs[i])) == false)
+            {
+                fprintf(stderr,
+                        "%s: invalid pipeline \"%s\"\n",
+                        program,
+                        pipelineDefinitions[i]);
+                exit(EXIT_FAILURE);
+            }
+
+            if (configs[i].sync == SYNC_VSYNC)
+            {
+                ++vsyncPipelines;
+            }
+
+            if (configs[i].outputPipe != NULL)
+            {
+                ++outputPipes;
+            }
+        }
+
+        // DispmanX only supports one vsync callback per process.
+
+        if (vsyncPipelines > 1)
+        {
+            fprintf(stderr,
+                    "%s: only one pipeline can use --sync vsync\n",
+                    program);
+            exit(EXIT_FAILURE);
+        }
+
+        // Frames from several pipelines would be interleaved.
+
+        if (outputPipes > 1)
+        {
+            fprintf(stderr,
+                    "%s: only one pipeline can use --output-pipe\n",
+                    program);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uint32_t index = 0;
+    for (index = 0 ; index < pipelineCount ; ++index)
+    {
+        if (checkFrameRates(&(configs[index]), program) == false)
+        {
+            exit(EXIT_FAILURE);
+        }
+
+        // Standard output can only carry the stream if nothing else is
+        // printed on it, and a daemon does not have it.
+
+        if ((configs[index].outputPipe != NULL)
+            && (strcmp(configs[index].outputPipe, "-") == 0)
+            && (isDaemon || (config.benchmarkFrames > 0)))
+        {
+            fprintf(stderr,
+                    "%s: --output-pipe - can not be used with --daemon"
+                    " or --benchmark\n",
+                    program);
+            exit(EXIT_FAILURE);
+        }
+    }
+
     //---------------------------------------------------------------------
 
     struct pidfh *pfh = NULL;
@@ -268,234 +1241,169 @@ main(
 
     //---------------------------------------------------------------------
 
-    bcm_host_init();
-
-    //---------------------------------------------------------------------
-
-    int result = 0;
-
-    //---------------------------------------------------------------------
-    // Make sure the VC_DISPLAY variable isn't set. 
-
-    unsetenv("VC_DISPLAY");
-
-    //---------------------------------------------------------------------
-
-    DISPMANX_DISPLAY_HANDLE_T sourceDisplay
-        = vc_dispmanx_display_open(sourceDisplayNumber);
-
-    if (sourceDisplay == 0)
+    if (signal(SIGUSR1, signalHandler) == SIG_ERR)
     {
-        messageLog(isDaemon,
-                   program,
-                   LOG_ERR,
-                   "open source display failed");
+        perrorLog(isDaemon, program, "installing SIGUSR1 signal handler");
+
         exitAndRemovePidFile(EXIT_FAILURE, pfh);
     }
 
-    DISPMANX_MODEINFO_T sourceInfo;
-
-    result = vc_dispmanx_display_get_info(sourceDisplay, &sourceInfo);
+    //---------------------------------------------------------------------
+    // A reader of --output-pipe going away is reported by EPIPE instead.
 
-    if (result != 0)
+    if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
     {
-        messageLog(isDaemon,
-                   program,
-                   LOG_ERR,
-                   "getting source display dimensions failed");
+        perrorLog(isDaemon, program, "ignoring SIGPIPE");
 
         exitAndRemovePidFile(EXIT_FAILURE, pfh);
     }
 
     //---------------------------------------------------------------------
 
-    DISPMANX_DISPLAY_HANDLE_T destDisplay
-        = vc_dispmanx_display_open(destDisplayNumber);
-
-    if (destDisplay == 0)
+    if (initDisplayBackend(backendName) == false)
     {
         messageLog(isDaemon,
                    program,
                    LOG_ERR,
-                   "open destination display failed");
-        exitAndRemovePidFile(EXIT_FAILURE, pfh);
-    }
-
-    DISPMANX_MODEINFO_T destInfo;
+                   "initialising display backend \"%s\" failed",
+                   (backendName != NULL) ? backendName : "default");
 
-    result = vc_dispmanx_display_get_info(destDisplay, &destInfo);
-
-    if (result != 0)
-    {
-        messageLog(isDaemon,
-                   program,
-                   LOG_ERR,
-                   "getting destination display dimensions failed");
         exitAndRemovePidFile(EXIT_FAILURE, pfh);
     }
 
-    //---------------------------------------------------------------------
-
-    messageLog(isDaemon,
-               program,
-               LOG_INFO,
-               "copying from [%d] %dx%d to [%d] %dx%d",
-               sourceDisplayNumber,
-               sourceInfo.width,
-               sourceInfo.height,
-               destDisplayNumber,
-               destInfo.width,
-               destInfo.height);
+    initDisplayMonitor();
 
     //---------------------------------------------------------------------
+    // Make sure the VC_DISPLAY variable isn't set. 
 
-    uint32_t image_ptr;
-
-    DISPMANX_RESOURCE_HANDLE_T resource = 
-        vc_dispmanx_resource_create(VC_IMAGE_RGBA32,
-                                    destInfo.width,
-                                    destInfo.height,
-                                    &image_ptr);
+    unsetenv("VC_DISPLAY");
 
     //---------------------------------------------------------------------
 
-    VC_RECT_T sourceRect;
-    vc_dispmanx_rect_set(&sourceRect,
-                         0,
-                         0,
-                         destInfo.width << 16,
-                         destInfo.height << 16);
-    
-    VC_RECT_T destRect;
-    if (center
-         && (sourceInfo.width <= destInfo.width)
-         && (sourceInfo.height <= destInfo.height))
-    {
-        vc_dispmanx_rect_set(&destRect,
-                             (destInfo.width - sourceInfo.width) / 2,
-                             (destInfo.height - sourceInfo.height) / 2,
-                             sourceInfo.width,
-                             sourceInfo.height);
+    static PIPELINE_T pipelines[MAX_PIPELINES];
 
-        messageLog(isDaemon,
-                   program,
-                   LOG_INFO,
-                   "centering source display within destination display");
-    }
-    else
-    {
-        vc_dispmanx_rect_set(&destRect, 0, 0, 0, 0);
-    }
+    // With --benchmark-workers, the pipelines are opened, run and closed
+    // again for each number of workers.
 
-    //---------------------------------------------------------------------
+    uint32_t runs = (benchmarkWorkers > 0) ? benchmarkWorkers : 1;
+    BENCHMARK_BASELINE_T baseline = { 0 };
 
-    VC_DISPMANX_ALPHA_T alpha =
+    uint32_t runIndex = 0;
+    for (runIndex = 0 ; (runIndex < runs) && run ; ++runIndex)
     {
-        DISPMANX_FLAGS_ALPHA_FIXED_ALL_PIXELS,
-        255,
-        0
-    };
+        // Each pipeline's worker pools (one for the capture, one for the
+        // output threads) are given cores of their own, after core 0.
 
-    DISPMANX_UPDATE_HANDLE_T update = vc_dispmanx_update_start(0);
+        uint32_t firstCore = 1;
 
-    if (update == 0)
-    {
-        messageLog(isDaemon,
-                   program,
-                   LOG_ERR,
-                   "display update failed");
-        exitAndRemovePidFile(EXIT_FAILURE, pfh);
-    }
-
-    DISPMANX_ELEMENT_HANDLE_T element;
-    element = vc_dispmanx_element_add(update,
-                                      destDisplay,
-                                      layerNumber,
-                                      &destRect,
-                                      resource,
-                                      &sourceRect,
-                                      DISPMANX_PROTECTION_NONE,
-                                      &alpha,
-                                      NULL,
-                                      DISPMANX_NO_ROTATE);
-    if (element == 0)
-    {
-        messageLog(isDaemon,
-                   program,
-                   LOG_ERR,
-                   "failed to create DispmanX element");
-        exitAndRemovePidFile(EXIT_FAILURE, pfh);
-    }
+        uint32_t i = 0;
+        for (i = 0 ; i < pipelineCount ; ++i)
+        {
+            char name[16];
+            snprintf(name, sizeof(name), "pipeline %d", i);
 
-    vc_dispmanx_update_submit_sync(update);
+            configs[i].exportIndex = i;
 
-    //---------------------------------------------------------------------
+            if (benchmarkWorkers > 0)
+            {
+                configs[i].workers = runIndex + 1;
+            }
 
-    struct timeval start_time;
-    struct timeval end_time;
-    struct timeval elapsed_time;
+            configs[i].firstCore = firstCore;
+            firstCore += 2 * (configs[i].workers - 1);
 
-    //---------------------------------------------------------------------
+            initPipeline(&(pipelines[i]),
+                         &(configs[i]),
+                         (pipelineCount > 1) ? name : NULL,
+                         isDaemon,
+                         program,
+                         &run);
 
-    while (run)
-    {
-        gettimeofday(&start_time, NULL);
+            if (openPipeline(&(pipelines[i])) == false)
+            {
+                exitAndRemovePidFile(EXIT_FAILURE, pfh);
+            }
+        }
 
         //-----------------------------------------------------------------
 
-        result = vc_dispmanx_snapshot(sourceDisplay,
-                                      resource,
-                                      DISPMANX_NO_ROTATE);
+        STATS_SEGMENT_T *statsSegment = NULL;
 
-        if (result != 0)
+        if (statsFile != NULL)
         {
-            messageLog(isDaemon,
-                       program,
-                       LOG_ERR,
-                       "DispmanX snapshot failed");
-            exitAndRemovePidFile(EXIT_FAILURE, pfh);
-        }
+            statsSegment = createStatsSegment(statsFile, pipelineCount);
 
-        //-----------------------------------------------------------------
+            if (statsSegment == NULL)
+            {
+                perrorLog(isDaemon, program, "creating statistics file");
 
-        update = vc_dispmanx_update_start(0);
+                exitAndRemovePidFile(EXIT_FAILURE, pfh);
+            }
 
-        if (update == 0)
-        {
-            messageLog(isDaemon,
-                       program,
-                       LOG_ERR,
-                       "display update failed");
-            exitAndRemovePidFile(EXIT_FAILURE, pfh);
+            for (i = 0 ; i < pipelineCount ; ++i)
+            {
+                pipelines[i].published = &(statsSegment->pipelines[i]);
+            }
         }
 
-        vc_dispmanx_element_change_source(update, element, resource);
-        vc_dispmanx_update_submit_sync(update);
-
         //-----------------------------------------------------------------
 
-        gettimeofday(&end_time, NULL);
-        timersub(&end_time, &start_time, &elapsed_time);
+        for (i = 0 ; i < pipelineCount ; ++i)
+        {
+            if (startPipeline(&(pipelines[i])) == false)
+            {
+                messageLog(isDaemon,
+                           program,
+                           LOG_ERR,
+                           "starting pipeline %d failed",
+                           i);
+                exitAndRemovePidFile(EXIT_FAILURE, pfh);
+            }
+        }
+
+        bool failed = false;
 
-        if (elapsed_time.tv_sec == 0)
+        for (i = 0 ; i < pipelineCount ; ++i)
         {
-            if (elapsed_time.tv_usec < frameDuration)
+            joinPipeline(&(pipelines[i]));
+
+            if (pipelines[i].failed)
             {
-                usleep(frameDuration -  elapsed_time.tv_usec);
+                failed = true;
             }
         }
-    }
 
-    //---------------------------------------------------------------------
+        if (statsSegment != NULL)
+        {
+            destroyStatsSegment(statsSegment, statsFile);
+        }
 
-    update = vc_dispmanx_update_start(0);
-    vc_dispmanx_element_remove(update, element);
-    vc_dispmanx_update_submit_sync(update);
+        if (failed)
+        {
+            exitAndRemovePidFile(EXIT_FAILURE, pfh);
+        }
 
-    vc_dispmanx_resource_delete(resource);
+        if (benchmarkWorkers > 0)
+        {
+            printBenchmarkScaling(stdout,
+                                  pipelines,
+                                  pipelineCount,
+                                  &baseline,
+                                  json);
+        }
+        else if (config.benchmarkFrames > 0)
+        {
+            printBenchmarkReport(stdout, pipelines, pipelineCount, json);
+        }
 
-    vc_dispmanx_display_close(sourceDisplay);
-    vc_dispmanx_display_close(destDisplay);
+        for (i = 0 ; i < pipelineCount ; ++i)
+        {
+            closePipeline(&(pipelines[i]));
+        }
+    }
+
+    destroyDisplayMonitor();
+    destroyDisplayBackend();
 
     //---------------------------------------------------------------------
 
@@ -515,4 +1423,3 @@ main(
 
     return 0 ;
 }
-
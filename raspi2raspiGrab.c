@@ -0,0 +1,301 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "frameExportReader.h"
+#include "frameScheduler.h"
+
+//-------------------------------------------------------------------------
+// An example of reading the frames exported by raspi2raspi --export. It
+// follows a pipeline's frames, reports how long after capture each one was
+// read, and can save the last one.
+
+#define DEFAULT_COUNT 1
+#define DEFAULT_TIMEOUT 5
+
+//-------------------------------------------------------------------------
+
+void
+printUsage(
+    FILE *fp,
+    const char *name)
+{
+    fprintf(fp, "\n");
+    fprintf(fp, "Usage: %s <options>\n", name);
+    fprintf(fp, "\n");
+    fprintf(fp, "    --pipeline <number> - pipeline to read frames from");
+    fprintf(fp, " (default 0)\n");
+    fprintf(fp, "    --count <number> - exit after this many frames");
+    fprintf(fp, " (default %d, 0 never)\n", DEFAULT_COUNT);
+    fprintf(fp, "    --output <file> - write the pixels of the last");
+    fprintf(fp, " frame to this file\n");
+    fprintf(fp, "    --timeout <seconds> - give up if no frame arrives");
+    fprintf(fp, " for this long (default %d)\n", DEFAULT_TIMEOUT);
+    fprintf(fp, "    --help - print usage and exit\n");
+    fprintf(fp, "\n");
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+openReader(
+    FRAME_EXPORT_READER_T *reader,
+    uint32_t index,
+    const char *program)
+{
+    if (openFrameExportReader(reader, index) == false)
+    {
+        fprintf(stderr,
+                "%s: cannot read frames of pipeline %d: %s\n",
+                program,
+                index,
+                (errno == ENOENT)
+                    ? "not exporting frames (see raspi2raspi --export)"
+                    : (errno == EINVAL)
+                        ? "not a raspi2raspi frame export of this version"
+                        : strerror(errno));
+        return false;
+    }
+
+    const FRAME_EXPORT_HEADER_T *header = reader->header;
+
+    printf("pipeline %d: %dx%d %s, pitch %d, %d slots, raspi2raspi pid %d\n",
+           index,
+           header->width,
+           header->height,
+           header->formatName,
+           header->pitch,
+           header->slotCount,
+           header->pid);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+writeFrame(
+    const char *path,
+    const FRAME_EXPORT_READER_T *reader,
+    const FRAME_EXPORT_FRAME_T *frame)
+{
+    FILE *fp = fopen(path, "wb");
+
+    if (fp == NULL)
+    {
+        return false;
+    }
+
+    size_t size = reader->header->frameSize;
+    bool written = (fwrite(frame->pixels, 1, size, fp) == size);
+
+    return (fclose(fp) == 0) && written;
+}
+
+//-------------------------------------------------------------------------
+
+int
+main(
+    int argc,
+    char *argv[])
+{
+    const char *program = basename(argv[0]);
+
+    uint32_t index = 0;
+    int count = DEFAULT_COUNT;
+    const char *output = NULL;
+    int timeout = DEFAULT_TIMEOUT;
+
+    //---------------------------------------------------------------------
+
+    static const char *sopts = "c:ho:p:t:";
+    static struct option lopts[] =
+    {
+        { "count", required_argument, NULL, 'c' },
+        { "help", no_argument, NULL, 'h' },
+        { "output", required_argument, NULL, 'o' },
+        { "pipeline", required_argument, NULL, 'p' },
+        { "timeout", required_argument, NULL, 't' },
+        { NULL, no_argument, NULL, 0 }
+    };
+
+    int opt = 0;
+
+    while ((opt = getopt_long(argc, argv, sopts, lopts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+
+            count = atoi(optarg);
+            break;
+
+        case 'h':
+
+            printUsage(stdout, program);
+            exit(EXIT_SUCCESS);
+
+            break;
+
+        case 'o':
+
+            output = optarg;
+            break;
+
+        case 'p':
+
+            index = atoi(optarg);
+            break;
+
+        case 't':
+
+            timeout = atoi(optarg);
+            break;
+
+        default:
+
+            printUsage(stderr, program);
+            exit(EXIT_FAILURE);
+
+            break;
+        }
+    }
+
+    //---------------------------------------------------------------------
+
+    FRAME_EXPORT_READER_T reader;
+
+    if (openReader(&reader, index, program) == false)
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    FRAME_EXPORT_FRAME_T frame;
+    uint64_t last = 0;
+    int frames = 0;
+    int overwritten = 0;
+    int64_t totalAge = 0;
+
+    while ((count == 0) || (frames < count))
+    {
+        if (frameExportReaderWait(&reader,
+                                  last,
+                                  timeout * NANOSECONDS_PER_SECOND) == false)
+        {
+            if (frameExportReaderClosed(&reader) == false)
+            {
+                fprintf(stderr,
+                        "%s: timed out waiting for a frame\n",
+                        program);
+                break;
+            }
+
+            // the pipeline was reconfigured (or raspi2raspi restarted), so
+            // follow it to its new segment
+
+            closeFrameExportReader(&reader);
+            sleep(1);
+
+            if (openReader(&reader, index, program) == false)
+            {
+                break;
+            }
+
+            last = 0;
+            continue;
+        }
+
+        if (frameExportReaderLatest(&reader, &frame) == false)
+        {
+            continue;
+        }
+
+        // The pixels are used where they are, in the shared memory, and
+        // must be checked afterwards in case raspi2raspi overwrote them.
+
+        int64_t age = (monotonicNanoseconds() - frame.timestamp)
+                    / NANOSECONDS_PER_MICROSECOND;
+        bool saved = (output == NULL)
+                  || ((count > 0) && (frames + 1 < count))
+                  || writeFrame(output, &reader, &frame);
+
+        if (frameExportReaderValid(&reader, &frame) == false)
+        {
+            ++overwritten;
+            continue;
+        }
+
+        if (saved == false)
+        {
+            fprintf(stderr,
+                    "%s: writing %s failed: %s\n",
+                    program,
+                    output,
+                    strerror(errno));
+            break;
+        }
+
+        printf("frame %"PRIu64", read %"PRId64" us after capture",
+               frame.frame,
+               age);
+
+        if (last > 0)
+        {
+            printf(", %"PRIu64" missed", frame.frame - last - 1);
+        }
+
+        printf("\n");
+
+        last = frame.frame;
+        totalAge += age;
+        ++frames;
+    }
+
+    if (frames > 0)
+    {
+        printf("%d frames, %d overwritten while in use,"
+               " mean %"PRId64" us after capture\n",
+               frames,
+               overwritten,
+               totalAge / frames);
+    }
+
+    closeFrameExportReader(&reader);
+
+    return (frames > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
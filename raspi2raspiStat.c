@@ -0,0 +1,423 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "frameScheduler.h"
+#include "statsSegment.h"
+
+//-------------------------------------------------------------------------
+
+#define DEFAULT_INTERVAL 1
+
+//-------------------------------------------------------------------------
+
+void
+printUsage(
+    FILE *fp,
+    const char *name)
+{
+    fprintf(fp, "\n");
+    fprintf(fp, "Usage: %s <options>\n", name);
+    fprintf(fp, "\n");
+    fprintf(fp, "    --file <file> - statistics file to read");
+    fprintf(fp, " (default %s)\n", STATS_SEGMENT_DEFAULT_PATH);
+    fprintf(fp, "    --interval <seconds> - time between updates");
+    fprintf(fp, " (default %d)\n", DEFAULT_INTERVAL);
+    fprintf(fp, "    --count <number> - exit after this many updates");
+    fprintf(fp, " (default never, or 1 with --json)\n");
+    fprintf(fp, "    --json - print the statistics as JSON\n");
+    fprintf(fp, "    --help - print usage and exit\n");
+    fprintf(fp, "\n");
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+isRunning(
+    const STATS_SEGMENT_T *segment)
+{
+    return (kill(segment->pid, 0) == 0) || (errno == EPERM);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+printLatency(
+    const char *name,
+    const STATS_SEGMENT_LATENCY_T *latency)
+{
+    printf("    %-10s %10lld %10lld %10lld %10lld\n",
+           name,
+           latency->p50 / NANOSECONDS_PER_MICROSECOND,
+           latency->p90 / NANOSECONDS_PER_MICROSECOND,
+           latency->p99 / NANOSECONDS_PER_MICROSECOND,
+           latency->max / NANOSECONDS_PER_MICROSECOND);
+}
+
+//-------------------------------------------------------------------------
+// Print the statistics for a terminal, refreshed in place like top.
+// previous holds the pipelines from the last update, so that the rate at
+// which frames are presented can be shown.
+
+static void
+printTop(
+    const STATS_SEGMENT_T *segment,
+    STATS_SEGMENT_PIPELINE_T *previous,
+    int64_t elapsed)
+{
+    int64_t now = monotonicNanoseconds();
+    long long uptime = (now - segment->started) / NANOSECONDS_PER_SECOND;
+
+    printf("\033[H\033[2J");
+    printf("raspi2raspi pid %d, %s, up %lld:%02lld:%02lld\n",
+           segment->pid,
+           isRunning(segment) ? "running" : "not running",
+           uptime / 3600,
+           (uptime / 60) % 60,
+           uptime % 60);
+
+    uint32_t i = 0;
+    for (i = 0 ; i < segment->pipelineCount ; ++i)
+    {
+        STATS_SEGMENT_PIPELINE_T pipeline;
+
+        if (statsSegmentReadPipeline(segment, i, &pipeline) == false)
+        {
+            continue;
+        }
+
+        double rate = 0.0;
+
+        if ((elapsed > 0)
+            && (pipeline.framesPresented >= previous[i].framesPresented))
+        {
+            rate = (double)(pipeline.framesPresented
+                            - previous[i].framesPresented)
+                 * NANOSECONDS_PER_SECOND / elapsed;
+        }
+
+        printf("\n");
+        printf("pipeline %d: source [%d] %dx%d, snapshot %dx%d"
+               " to %d display(s), %s\n",
+               i,
+               pipeline.sourceDisplay,
+               pipeline.sourceWidth,
+               pipeline.sourceHeight,
+               pipeline.snapshotWidth,
+               pipeline.snapshotHeight,
+               pipeline.destinationCount,
+               pipeline.active ? "active" : "inactive");
+
+        uint32_t j = 0;
+        for (j = 0 ; j < pipeline.destinationCount ; ++j)
+        {
+            const STATS_SEGMENT_DESTINATION_T *destination
+                = &(pipeline.destinations[j]);
+
+            printf("  display   [%d] %dx%d, copy %dx%d at %d,%d\n",
+                   destination->display,
+                   destination->width,
+                   destination->height,
+                   destination->copyWidth,
+                   destination->copyHeight,
+                   destination->x,
+                   destination->y);
+        }
+
+        printf("  frames    %"PRIu64" captured, %"PRIu64" presented,"
+               " %"PRIu64" skipped, %.1f fps captured, %.1f presented\n",
+               pipeline.framesCaptured,
+               pipeline.framesPresented,
+               pipeline.framesSkipped,
+               pipeline.captureFps,
+               rate);
+        printf("  recovery  %"PRIu64" failed frames, %"PRIu64" retries,"
+               " %"PRIu64" element recreations, %"PRIu64" display reopens\n",
+               pipeline.failures,
+               pipeline.frameRetries,
+               pipeline.elementRecreations,
+               pipeline.displayReopens);
+        printf("  displays  %"PRIu64" reconfiguration(s)\n",
+               pipeline.reconfigurations);
+        printf("  latency (us)      p50        p90        p99        max\n");
+        printLatency("snapshot", &(pipeline.snapshotLatency));
+        printLatency("update", &(pipeline.updateLatency));
+        printLatency("wakeup", &(pipeline.wakeupLatency));
+
+        previous[i] = pipeline;
+    }
+
+    fflush(stdout);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+printJsonLatency(
+    const char *name,
+    const STATS_SEGMENT_LATENCY_T *latency,
+    const char *separator)
+{
+    printf("\"%s\":{\"p50_ns\":%"PRId64",\"p90_ns\":%"PRId64","
+           "\"p99_ns\":%"PRId64",\"max_ns\":%"PRId64"}%s",
+           name,
+           latency->p50,
+           latency->p90,
+           latency->p99,
+           latency->max,
+           separator);
+}
+
+//-------------------------------------------------------------------------
+// Print the statistics as a single line of JSON.
+
+static void
+printJson(
+    const STATS_SEGMENT_T *segment)
+{
+    int64_t now = monotonicNanoseconds();
+
+    printf("{\"pid\":%d,\"running\":%s,\"uptime_s\":%lld,"
+           "\"pipelines\":[",
+           segment->pid,
+           isRunning(segment) ? "true" : "false",
+           (now - segment->started) / NANOSECONDS_PER_SECOND);
+
+    const char *separator = "";
+
+    uint32_t i = 0;
+    for (i = 0 ; i < segment->pipelineCount ; ++i)
+    {
+        STATS_SEGMENT_PIPELINE_T pipeline;
+
+        if (statsSegmentReadPipeline(segment, i, &pipeline) == false)
+        {
+            continue;
+        }
+
+        printf("%s{\"index\":%d,\"active\":%s,\"age_ms\":%lld,",
+               separator,
+               i,
+               pipeline.active ? "true" : "false",
+               (now - pipeline.updated) / NANOSECONDS_PER_MILLISECOND);
+        printf("\"source\":{\"display\":%d,\"width\":%d,\"height\":%d},",
+               pipeline.sourceDisplay,
+               pipeline.sourceWidth,
+               pipeline.sourceHeight);
+        printf("\"snapshot\":{\"width\":%d,\"height\":%d},"
+               "\"destinations\":[",
+               pipeline.snapshotWidth,
+               pipeline.snapshotHeight);
+
+        uint32_t j = 0;
+        for (j = 0 ; j < pipeline.destinationCount ; ++j)
+        {
+            const STATS_SEGMENT_DESTINATION_T *destination
+                = &(pipeline.destinations[j]);
+
+            printf("%s{\"display\":%d,\"width\":%d,\"height\":%d,"
+                   "\"copy\":{\"x\":%d,\"y\":%d,\"width\":%d,"
+                   "\"height\":%d}}",
+                   (j > 0) ? "," : "",
+                   destination->display,
+                   destination->width,
+                   destination->height,
+                   destination->x,
+                   destination->y,
+                   destination->copyWidth,
+                   destination->copyHeight);
+        }
+
+        printf("],\"fps\":%.2f,", pipeline.captureFps);
+        printf("\"frames\":{\"captured\":%"PRIu64",\"presented\":%"PRIu64","
+               "\"skipped\":%"PRIu64"},",
+               pipeline.framesCaptured,
+               pipeline.framesPresented,
+               pipeline.framesSkipped);
+        printf("\"recovery\":{\"failures\":%"PRIu64",\"retries\":%"PRIu64","
+               "\"element_recreations\":%"PRIu64","
+               "\"display_reopens\":%"PRIu64"},",
+               pipeline.failures,
+               pipeline.frameRetries,
+               pipeline.elementRecreations,
+               pipeline.displayReopens);
+        printf("\"reconfigurations\":%"PRIu64",\"latency\":{",
+               pipeline.reconfigurations);
+        printJsonLatency("snapshot", &(pipeline.snapshotLatency), ",");
+        printJsonLatency("update", &(pipeline.updateLatency), ",");
+        printJsonLatency("wakeup", &(pipeline.wakeupLatency), "}}");
+
+        separator = ",";
+    }
+
+    printf("]}\n");
+    fflush(stdout);
+}
+
+//-------------------------------------------------------------------------
+
+int
+main(
+    int argc,
+    char *argv[])
+{
+    const char *program = basename(argv[0]);
+
+    const char *file = STATS_SEGMENT_DEFAULT_PATH;
+    int interval = DEFAULT_INTERVAL;
+    int count = -1;
+    bool json = false;
+
+    //---------------------------------------------------------------------
+
+    static const char *sopts = "c:f:hi:j";
+    static struct option lopts[] =
+    {
+        { "count", required_argument, NULL, 'c' },
+        { "file", required_argument, NULL, 'f' },
+        { "help", no_argument, NULL, 'h' },
+        { "interval", required_argument, NULL, 'i' },
+        { "json", no_argument, NULL, 'j' },
+        { NULL, no_argument, NULL, 0 }
+    };
+
+    int opt = 0;
+
+    while ((opt = getopt_long(argc, argv, sopts, lopts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+
+            count = atoi(optarg);
+            break;
+
+        case 'f':
+
+            file = optarg;
+            break;
+
+        case 'h':
+
+            printUsage(stdout, program);
+            exit(EXIT_SUCCESS);
+
+            break;
+
+        case 'i':
+
+            interval = atoi(optarg);
+
+            if (interval < 1)
+            {
+                interval = 1;
+            }
+
+            break;
+
+        case 'j':
+
+            json = true;
+            break;
+
+        default:
+
+            printUsage(stderr, program);
+            exit(EXIT_FAILURE);
+
+            break;
+        }
+    }
+
+    if (count < 0)
+    {
+        count = json ? 1 : 0;
+    }
+
+    //---------------------------------------------------------------------
+
+    const STATS_SEGMENT_T *segment = openStatsSegment(file);
+
+    if (segment == NULL)
+    {
+        fprintf(stderr,
+                "%s: cannot read statistics from %s: %s\n",
+                program,
+                file,
+                (errno == EINVAL)
+                    ? "not a raspi2raspi statistics file of this version"
+                    : strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    //---------------------------------------------------------------------
+
+    STATS_SEGMENT_PIPELINE_T previous[STATS_SEGMENT_MAX_PIPELINES];
+    memset(previous, 0, sizeof(previous));
+
+    int64_t last = 0;
+    int updates = 0;
+
+    while (true)
+    {
+        int64_t now = monotonicNanoseconds();
+
+        if (json)
+        {
+            printJson(segment);
+        }
+        else
+        {
+            printTop(segment, previous, (last > 0) ? now - last : 0);
+        }
+
+        last = now;
+
+        if ((count > 0) && (++updates >= count))
+        {
+            break;
+        }
+
+        sleep(interval);
+    }
+
+    closeStatsSegment(segment);
+
+    return 0;
+}
@@ -0,0 +1,216 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "displayBackend.h"
+#include "resourceRing.h"
+
+//-------------------------------------------------------------------------
+
+static void
+updateComplete(
+    DISPMANX_UPDATE_HANDLE_T update,
+    void *arg)
+{
+    RESOURCE_RING_T *ring = arg;
+
+    pthread_mutex_lock(&(ring->mutex));
+
+    --(ring->inFlight);
+    ++(ring->completed);
+
+    pthread_cond_broadcast(&(ring->cond));
+    pthread_mutex_unlock(&(ring->mutex));
+}
+
+//-------------------------------------------------------------------------
+
+bool
+initResourceRing(
+    RESOURCE_RING_T *ring,
+    uint32_t count,
+    VC_IMAGE_TYPE_T type,
+    uint32_t width,
+    uint32_t height)
+{
+    if ((count < 1) || (count > RESOURCE_RING_MAX_BUFFERS))
+    {
+        return false;
+    }
+
+    ring->count = count;
+    ring->front = 0;
+    ring->back = (count > 1) ? 1 : 0;
+    ring->inFlight = 0;
+    ring->maxInFlight = 0;
+    ring->submitted = 0;
+    ring->completed = 0;
+
+    uint32_t i = 0;
+    for (i = 0 ; i < count ; ++i)
+    {
+        ring->resources[i]
+            = displayBackend()->resourceCreate(type, width, height);
+
+        if (ring->resources[i] == 0)
+        {
+            while (i > 0)
+            {
+                --i;
+                displayBackend()->resourceDelete(ring->resources[i]);
+            }
+
+            return false;
+        }
+    }
+
+    pthread_mutex_init(&(ring->mutex), NULL);
+    pthread_cond_init(&(ring->cond), NULL);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+DISPMANX_RESOURCE_HANDLE_T
+resourceRingFront(
+    RESOURCE_RING_T *ring)
+{
+    return ring->resources[ring->front];
+}
+
+//-------------------------------------------------------------------------
+// The back buffer is free once the update that replaced it on the
+// display has completed. Updates complete in order, so with N buffers
+// that is when no more than N - 2 updates are still in flight.
+
+DISPMANX_RESOURCE_HANDLE_T
+resourceRingBack(
+    RESOURCE_RING_T *ring)
+{
+    if (ring->count > 1)
+    {
+        pthread_mutex_lock(&(ring->mutex));
+
+        while (ring->inFlight > ring->count - 2)
+        {
+            pthread_cond_wait(&(ring->cond), &(ring->mutex));
+        }
+
+        pthread_mutex_unlock(&(ring->mutex));
+    }
+
+    return ring->resources[ring->back];
+}
+
+//-------------------------------------------------------------------------
+// Submit an update that has changed the element's source to the back
+// buffer, which then becomes the front buffer.
+
+void
+resourceRingSubmit(
+    RESOURCE_RING_T *ring,
+    DISPMANX_UPDATE_HANDLE_T update)
+{
+    if (ring->count == 1)
+    {
+        displayBackend()->updateSubmitSync(update);
+        ++(ring->submitted);
+        ++(ring->completed);
+        return;
+    }
+
+    pthread_mutex_lock(&(ring->mutex));
+
+    ++(ring->inFlight);
+    ++(ring->submitted);
+
+    if (ring->inFlight > ring->maxInFlight)
+    {
+        ring->maxInFlight = ring->inFlight;
+    }
+
+    pthread_mutex_unlock(&(ring->mutex));
+
+    if (displayBackend()->updateSubmit(update, updateComplete, ring) != 0)
+    {
+        updateComplete(update, ring);
+    }
+
+    ring->front = ring->back;
+    ring->back = (ring->back + 1) % ring->count;
+}
+
+//-------------------------------------------------------------------------
+
+uint32_t
+resourceRingInFlight(
+    RESOURCE_RING_T *ring)
+{
+    pthread_mutex_lock(&(ring->mutex));
+    uint32_t inFlight = ring->inFlight;
+    pthread_mutex_unlock(&(ring->mutex));
+
+    return inFlight;
+}
+
+//-------------------------------------------------------------------------
+
+void
+resourceRingDrain(
+    RESOURCE_RING_T *ring)
+{
+    pthread_mutex_lock(&(ring->mutex));
+
+    while (ring->inFlight > 0)
+    {
+        pthread_cond_wait(&(ring->cond), &(ring->mutex));
+    }
+
+    pthread_mutex_unlock(&(ring->mutex));
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyResourceRing(
+    RESOURCE_RING_T *ring)
+{
+    resourceRingDrain(ring);
+
+    uint32_t i = 0;
+    for (i = 0 ; i < ring->count ; ++i)
+    {
+        displayBackend()->resourceDelete(ring->resources[i]);
+    }
+
+    pthread_cond_destroy(&(ring->cond));
+    pthread_mutex_destroy(&(ring->mutex));
+}
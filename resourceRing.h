@@ -0,0 +1,101 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef RESOURCE_RING_H
+#define RESOURCE_RING_H
+
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "displayTypes.h"
+
+//-------------------------------------------------------------------------
+
+#define RESOURCE_RING_MAX_BUFFERS 3
+
+//-------------------------------------------------------------------------
+// A ring of snapshot resources. The front buffer is the one the element
+// is showing (or about to show), snapshots are taken into the back buffer
+// and the updates that flip it to the front are submitted asynchronously.
+// With a single buffer, updates are submitted synchronously, as snapshot
+// and display share the resource.
+
+typedef struct
+{
+    DISPMANX_RESOURCE_HANDLE_T resources[RESOURCE_RING_MAX_BUFFERS];
+    uint32_t count;
+    uint32_t front;
+    uint32_t back;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t inFlight;
+    uint32_t maxInFlight;
+    uint64_t submitted;
+    uint64_t completed;
+} RESOURCE_RING_T;
+
+//-------------------------------------------------------------------------
+
+bool
+initResourceRing(
+    RESOURCE_RING_T *ring,
+    uint32_t count,
+    VC_IMAGE_TYPE_T type,
+    uint32_t width,
+    uint32_t height);
+
+DISPMANX_RESOURCE_HANDLE_T
+resourceRingFront(
+    RESOURCE_RING_T *ring);
+
+DISPMANX_RESOURCE_HANDLE_T
+resourceRingBack(
+    RESOURCE_RING_T *ring);
+
+void
+resourceRingSubmit(
+    RESOURCE_RING_T *ring,
+    DISPMANX_UPDATE_HANDLE_T update);
+
+uint32_t
+resourceRingInFlight(
+    RESOURCE_RING_T *ring);
+
+void
+resourceRingDrain(
+    RESOURCE_RING_T *ring);
+
+void
+destroyResourceRing(
+    RESOURCE_RING_T *ring);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,773 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frameScheduler.h"
+#include "imageFormat.h"
+#include "softwareBackend.h"
+
+//-------------------------------------------------------------------------
+
+#define SOFTWARE_MAX_DISPLAYS 16
+#define SOFTWARE_MAX_RESOURCES 64
+#define SOFTWARE_MAX_ELEMENTS 64
+
+#define SOFTWARE_DEFAULT_WIDTH 1920
+#define SOFTWARE_DEFAULT_HEIGHT 1080
+#define SOFTWARE_DEFAULT_VSYNC_RATE 60
+
+//-------------------------------------------------------------------------
+// Handles are the index into the table plus one, so that zero is never a
+// valid handle, as with DispmanX.
+
+typedef struct
+{
+    bool used;
+    uint32_t device;
+    uint64_t snapshots;
+    DISPMANX_CALLBACK_FUNC_T vsyncCallback;
+    void *vsyncArg;
+} SOFTWARE_DISPLAY_T;
+
+typedef struct
+{
+    bool used;
+    VC_IMAGE_TYPE_T type;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint8_t *data;
+} SOFTWARE_RESOURCE_T;
+
+typedef struct
+{
+    bool used;
+    DISPMANX_DISPLAY_HANDLE_T display;
+    DISPMANX_RESOURCE_HANDLE_T resource;
+} SOFTWARE_ELEMENT_T;
+
+//-------------------------------------------------------------------------
+
+static struct
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t displayWidth[SOFTWARE_MAX_DISPLAYS];
+    uint32_t displayHeight[SOFTWARE_MAX_DISPLAYS];
+    int64_t snapshotCost;
+    int64_t updateCost;
+    int64_t vsyncPeriod;
+    uint32_t change;
+} config =
+{
+    .width = SOFTWARE_DEFAULT_WIDTH,
+    .height = SOFTWARE_DEFAULT_HEIGHT,
+    .vsyncPeriod = NANOSECONDS_PER_SECOND / SOFTWARE_DEFAULT_VSYNC_RATE,
+    .change = 1
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static SOFTWARE_DISPLAY_T displays[SOFTWARE_MAX_DISPLAYS];
+static SOFTWARE_RESOURCE_T resources[SOFTWARE_MAX_RESOURCES];
+static SOFTWARE_ELEMENT_T elements[SOFTWARE_MAX_ELEMENTS];
+static uint32_t updates = 0;
+
+static volatile bool vsyncRun = false;
+static pthread_t vsyncThread;
+
+//-------------------------------------------------------------------------
+
+static bool
+parseSize(
+    const char *value,
+    uint32_t *width,
+    uint32_t *height)
+{
+    int w = 0;
+    int h = 0;
+
+    if ((sscanf(value, "%dx%d", &w, &h) != 2) || (w <= 0) || (h <= 0))
+    {
+        return false;
+    }
+
+    *width = w;
+    *height = h;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+configureSoftwareBackend(
+    const char *definition)
+{
+    char buffer[256];
+
+    if (strlen(definition) >= sizeof(buffer))
+    {
+        return false;
+    }
+
+    strcpy(buffer, definition);
+
+    char *saveptr = NULL;
+    char *token = strtok_r(buffer, ",", &saveptr);
+
+    while (token != NULL)
+    {
+        char *value = strchr(token, '=');
+
+        if (value == NULL)
+        {
+            return false;
+        }
+
+        *value++ = '\0';
+
+        if (strcmp(token, "size") == 0)
+        {
+            if (parseSize(value, &(config.width), &(config.height)) == false)
+            {
+                return false;
+            }
+        }
+        else if (strcmp(token, "display") == 0)
+        {
+            char *size = strchr(value, ':');
+            int device = atoi(value);
+
+            if ((size == NULL)
+                || (device < 0)
+                || (device >= SOFTWARE_MAX_DISPLAYS)
+                || (parseSize(size + 1,
+                              &(config.displayWidth[device]),
+                              &(config.displayHeight[device])) == false))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(token, "snapshot") == 0)
+        {
+            config.snapshotCost = atoi(value) * NANOSECONDS_PER_MICROSECOND;
+        }
+        else if (strcmp(token, "update") == 0)
+        {
+            config.updateCost = atoi(value) * NANOSECONDS_PER_MICROSECOND;
+        }
+        else if (strcmp(token, "vsync") == 0)
+        {
+            if (atof(value) <= 0.0)
+            {
+                return false;
+            }
+
+            config.vsyncPeriod = NANOSECONDS_PER_SECOND / atof(value);
+        }
+        else if (strcmp(token, "change") == 0)
+        {
+            config.change = atoi(value);
+        }
+        else
+        {
+            return false;
+        }
+
+        token = strtok_r(NULL, ",", &saveptr);
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+static SOFTWARE_DISPLAY_T *
+lookupDisplay(
+    DISPMANX_DISPLAY_HANDLE_T handle)
+{
+    if ((handle == 0)
+        || (handle > SOFTWARE_MAX_DISPLAYS)
+        || (displays[handle - 1].used == false))
+    {
+        return NULL;
+    }
+
+    return &(displays[handle - 1]);
+}
+
+//-------------------------------------------------------------------------
+
+static SOFTWARE_RESOURCE_T *
+lookupResource(
+    DISPMANX_RESOURCE_HANDLE_T handle)
+{
+    if ((handle == 0)
+        || (handle > SOFTWARE_MAX_RESOURCES)
+        || (resources[handle - 1].used == false))
+    {
+        return NULL;
+    }
+
+    return &(resources[handle - 1]);
+}
+
+//-------------------------------------------------------------------------
+
+static SOFTWARE_ELEMENT_T *
+lookupElement(
+    DISPMANX_ELEMENT_HANDLE_T handle)
+{
+    if ((handle == 0)
+        || (handle > SOFTWARE_MAX_ELEMENTS)
+        || (elements[handle - 1].used == false))
+    {
+        return NULL;
+    }
+
+    return &(elements[handle - 1]);
+}
+
+//-------------------------------------------------------------------------
+
+static void *
+softwareVsyncThread(
+    void *arg)
+{
+    int64_t next = monotonicNanoseconds();
+
+    while (vsyncRun)
+    {
+        next += config.vsyncPeriod;
+        monotonicSleepUntil(next);
+
+        DISPMANX_CALLBACK_FUNC_T callbacks[SOFTWARE_MAX_DISPLAYS];
+        void *args[SOFTWARE_MAX_DISPLAYS];
+
+        pthread_mutex_lock(&mutex);
+
+        int i = 0;
+        for (i = 0 ; i < SOFTWARE_MAX_DISPLAYS ; ++i)
+        {
+            callbacks[i] = displays[i].used ? displays[i].vsyncCallback : NULL;
+            args[i] = displays[i].vsyncArg;
+        }
+
+        pthread_mutex_unlock(&mutex);
+
+        for (i = 0 ; i < SOFTWARE_MAX_DISPLAYS ; ++i)
+        {
+            if (callbacks[i] != NULL)
+            {
+                callbacks[i](0, args[i]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+softwareInit(void)
+{
+    vsyncRun = true;
+
+    if (pthread_create(&vsyncThread, NULL, softwareVsyncThread, NULL) != 0)
+    {
+        vsyncRun = false;
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+softwareDestroy(void)
+{
+    vsyncRun = false;
+    pthread_join(vsyncThread, NULL);
+}
+
+//-------------------------------------------------------------------------
+
+static DISPMANX_DISPLAY_HANDLE_T
+softwareDisplayOpen(
+    uint32_t device)
+{
+    if (device >= SOFTWARE_MAX_DISPLAYS)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&mutex);
+
+    DISPMANX_DISPLAY_HANDLE_T handle = 0;
+
+    int i = 0;
+    for (i = 0 ; i < SOFTWARE_MAX_DISPLAYS ; ++i)
+    {
+        if (displays[i].used == false)
+        {
+            memset(&(displays[i]), 0, sizeof(displays[i]));
+            displays[i].used = true;
+            displays[i].device = device;
+            handle = i + 1;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return handle;
+}
+
+//-------------------------------------------------------------------------
+
+static int
+softwareDisplayClose(
+    DISPMANX_DISPLAY_HANDLE_T handle)
+{
+    pthread_mutex_lock(&mutex);
+
+    SOFTWARE_DISPLAY_T *display = lookupDisplay(handle);
+
+    if (display != NULL)
+    {
+        display->used = false;
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return (display != NULL) ? 0 : -1;
+}
+
+//-------------------------------------------------------------------------
+
+static int
+softwareDisplayGetInfo(
+    DISPMANX_DISPLAY_HANDLE_T handle,
+    DISPMANX_MODEINFO_T *info)
+{
+    pthread_mutex_lock(&mutex);
+
+    SOFTWARE_DISPLAY_T *display = lookupDisplay(handle);
+
+    if (display != NULL)
+    {
+        memset(info, 0, sizeof(*info));
+
+        if (config.displayWidth[display->device] > 0)
+        {
+            info->width = config.displayWidth[display->device];
+            info->height = config.displayHeight[display->device];
+        }
+        else
+        {
+            info->width = config.width;
+            info->height = config.height;
+        }
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return (display != NULL) ? 0 : -1;
+}
+
+//-------------------------------------------------------------------------
+
+static DISPMANX_RESOURCE_HANDLE_T
+softwareResourceCreate(
+    VC_IMAGE_TYPE_T type,
+    uint32_t width,
+    uint32_t height)
+{
+    uint32_t pitch = imageFormatPitch(type, width);
+
+    if (pitch == 0)
+    {
+        return 0;
+    }
+
+    uint8_t *data = calloc(height, pitch);
+
+    if (data == NULL)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&mutex);
+
+    DISPMANX_RESOURCE_HANDLE_T handle = 0;
+
+    int i = 0;
+    for (i = 0 ; i < SOFTWARE_MAX_RESOURCES ; ++i)
+    {
+        SOFTWARE_RESOURCE_T *resource = &(resources[i]);
+
+        if (resource->used == false)
+        {
+            resource->used = true;
+            resource->type = type;
+            resource->width = width;
+            resource->height = height;
+            resource->pitch = pitch;
+            resource->data = data;
+            handle = i + 1;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    if (handle == 0)
+    {
+        free(data);
+    }
+
+    return handle;
+}
+
+//-------------------------------------------------------------------------
+
+static int
+softwareResourceDelete(
+    DISPMANX_RESOURCE_HANDLE_T handle)
+{
+    pthread_mutex_lock(&mutex);
+
+    SOFTWARE_RESOURCE_T *resource = lookupResource(handle);
+    uint8_t *data = NULL;
+
+    if (resource != NULL)
+    {
+        data = resource->data;
+        resource->used = false;
+        resource->data = NULL;
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    free(data);
+
+    return (resource != NULL) ? 0 : -1;
+}
+
+//-------------------------------------------------------------------------
+
+static int
+softwareResourceReadData(
+    DISPMANX_RESOURCE_HANDLE_T handle,
+    const VC_RECT_T *rect,
+    void *buffer,
+    uint32_t pitch)
+{
+    pthread_mutex_lock(&mutex);
+
+    SOFTWARE_RESOURCE_T *resource = lookupResource(handle);
+    int result = -1;
+
+    if ((resource != NULL)
+        && (rect->x >= 0)
+        && (rect->y >= 0)
+        && ((uint32_t)(rect->x + rect->width) <= resource->width)
+        && ((uint32_t)(rect->y + rect->height) <= resource->height))
+    {
+        uint32_t bytesPerPixel = imageFormatBytesPerPixel(resource->type);
+        uint32_t rowBytes = rect->width * bytesPerPixel;
+
+        int32_t y = 0;
+        for (y = 0 ; y < rect->height ; ++y)
+        {
+            memcpy((uint8_t *)buffer + (y * pitch),
+                   resource->data
+                   + ((rect->y + y) * resource->pitch)
+                   + (rect->x * bytesPerPixel),
+                   rowBytes);
+        }
+
+        result = 0;
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return result;
+}
+
+//-------------------------------------------------------------------------
+// Fill the resource with a pattern that depends on how many snapshots of
+// the display have been taken, so that it changes every config.change
+// snapshots.
+
+static int
+softwareSnapshot(
+    DISPMANX_DISPLAY_HANDLE_T displayHandle,
+    DISPMANX_RESOURCE_HANDLE_T resourceHandle,
+    DISPMANX_TRANSFORM_T transform)
+{
+    int64_t start = monotonicNanoseconds();
+
+    pthread_mutex_lock(&mutex);
+
+    SOFTWARE_DISPLAY_T *display = lookupDisplay(displayHandle);
+    SOFTWARE_RESOURCE_T *resource = lookupResource(resourceHandle);
+
+    if ((display == NULL) || (resource == NULL))
+    {
+        pthread_mutex_unlock(&mutex);
+        return -1;
+    }
+
+    uint64_t frame = display->snapshots++;
+
+    if (config.change > 1)
+    {
+        frame /= config.change;
+    }
+    else if (config.change == 0)
+    {
+        frame = 0;
+    }
+
+    uint32_t y = 0;
+    for (y = 0 ; y < resource->height ; ++y)
+    {
+        memset(resource->data + (y * resource->pitch),
+               (int)((frame * 31) + y) & 0xFF,
+               resource->pitch);
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    if (config.snapshotCost > 0)
+    {
+        monotonicSleepUntil(start + config.snapshotCost);
+    }
+
+    return 0;
+}
+
+//-------------------------------------------------------------------------
+
+static DISPMANX_UPDATE_HANDLE_T
+softwareUpdateStart(void)
+{
+    pthread_mutex_lock(&mutex);
+
+    if (++updates == 0)
+    {
+        ++updates;
+    }
+
+    DISPMANX_UPDATE_HANDLE_T update = updates;
+
+    pthread_mutex_unlock(&mutex);
+
+    return update;
+}
+
+//-------------------------------------------------------------------------
+// Element changes are made as soon as they are requested, so submitting an
+// update only costs time. The completion callback is called before
+// returning.
+
+static int
+softwareUpdateSubmit(
+    DISPMANX_UPDATE_HANDLE_T update,
+    DISPMANX_CALLBACK_FUNC_T callback,
+    void *arg)
+{
+    if (config.updateCost > 0)
+    {
+        monotonicSleepUntil(monotonicNanoseconds() + config.updateCost);
+    }
+
+    if (callback != NULL)
+    {
+        callback(update, arg);
+    }
+
+    return 0;
+}
+
+//-------------------------------------------------------------------------
+
+static int
+softwareUpdateSubmitSync(
+    DISPMANX_UPDATE_HANDLE_T update)
+{
+    return softwareUpdateSubmit(update, NULL, NULL);
+}
+
+//-------------------------------------------------------------------------
+
+static DISPMANX_ELEMENT_HANDLE_T
+softwareElementAdd(
+    DISPMANX_UPDATE_HANDLE_T update,
+    DISPMANX_DISPLAY_HANDLE_T display,
+    int32_t layer,
+    const VC_RECT_T *destRect,
+    DISPMANX_RESOURCE_HANDLE_T src,
+    const VC_RECT_T *srcRect,
+    VC_DISPMANX_ALPHA_T *alpha,
+    DISPMANX_TRANSFORM_T transform)
+{
+    pthread_mutex_lock(&mutex);
+
+    DISPMANX_ELEMENT_HANDLE_T handle = 0;
+
+    if ((lookupDisplay(display) != NULL) && (lookupResource(src) != NULL))
+    {
+        int i = 0;
+        for (i = 0 ; i < SOFTWARE_MAX_ELEMENTS ; ++i)
+        {
+            if (elements[i].used == false)
+            {
+                elements[i].used = true;
+                elements[i].display = display;
+                elements[i].resource = src;
+                handle = i + 1;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return handle;
+}
+
+//-------------------------------------------------------------------------
+
+static int
+softwareElementChangeSource(
+    DISPMANX_UPDATE_HANDLE_T update,
+    DISPMANX_ELEMENT_HANDLE_T handle,
+    DISPMANX_RESOURCE_HANDLE_T resource)
+{
+    pthread_mutex_lock(&mutex);
+
+    SOFTWARE_ELEMENT_T *element = lookupElement(handle);
+    int result = -1;
+
+    if ((element != NULL) && (lookupResource(resource) != NULL))
+    {
+        element->resource = resource;
+        result = 0;
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return result;
+}
+
+//-------------------------------------------------------------------------
+
+static int
+softwareElementRemove(
+    DISPMANX_UPDATE_HANDLE_T update,
+    DISPMANX_ELEMENT_HANDLE_T handle)
+{
+    pthread_mutex_lock(&mutex);
+
+    SOFTWARE_ELEMENT_T *element = lookupElement(handle);
+
+    if (element != NULL)
+    {
+        element->used = false;
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return (element != NULL) ? 0 : -1;
+}
+
+//-------------------------------------------------------------------------
+
+static int
+softwareVsyncCallback(
+    DISPMANX_DISPLAY_HANDLE_T handle,
+    DISPMANX_CALLBACK_FUNC_T callback,
+    void *arg)
+{
+    pthread_mutex_lock(&mutex);
+
+    SOFTWARE_DISPLAY_T *display = lookupDisplay(handle);
+
+    if (display != NULL)
+    {
+        display->vsyncCallback = callback;
+        display->vsyncArg = arg;
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return (display != NULL) ? 0 : -1;
+}
+
+//-------------------------------------------------------------------------
+// The software displays never change, so there is nothing to watch.
+
+static void
+softwareWatchDisplays(
+    DISPLAY_CHANGE_CALLBACK_T callback)
+{
+}
+
+//-------------------------------------------------------------------------
+
+const DISPLAY_BACKEND_T softwareBackend =
+{
+    .name = "software",
+    .init = softwareInit,
+    .destroy = softwareDestroy,
+    .displayOpen = softwareDisplayOpen,
+    .displayClose = softwareDisplayClose,
+    .displayGetInfo = softwareDisplayGetInfo,
+    .resourceCreate = softwareResourceCreate,
+    .resourceDelete = softwareResourceDelete,
+    .resourceReadData = softwareResourceReadData,
+    .snapshot = softwareSnapshot,
+    .updateStart = softwareUpdateStart,
+    .updateSubmit = softwareUpdateSubmit,
+    .updateSubmitSync = softwareUpdateSubmitSync,
+    .elementAdd = softwareElementAdd,
+    .elementChangeSource = softwareElementChangeSource,
+    .elementRemove = softwareElementRemove,
+    .vsyncCallback = softwareVsyncCallback,
+    .watchDisplays = softwareWatchDisplays,
+    .unwatchDisplays = softwareWatchDisplays
+};
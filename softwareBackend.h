@@ -0,0 +1,60 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef SOFTWARE_BACKEND_H
+#define SOFTWARE_BACKEND_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+
+#include "displayBackend.h"
+
+//-------------------------------------------------------------------------
+// Displays and resources kept in ordinary memory, with synthetic costs for
+// snapshots and updates, and a synthetic vsync. A snapshot fills the
+// resource with a pattern that changes every so many snapshots. Nothing is
+// actually drawn on the destination displays.
+//
+// configureSoftwareBackend() takes a comma separated list of
+//
+//     size=<width>x<height>         - size of every display (1920x1080)
+//     display=<number>:<w>x<h>      - size of one display
+//     snapshot=<microseconds>       - minimum time taken by a snapshot
+//     update=<microseconds>         - time taken to submit an update
+//     vsync=<hz>                    - vsync rate (60)
+//     change=<snapshots>            - content changes every N snapshots (1)
+
+extern const DISPLAY_BACKEND_T softwareBackend;
+
+bool
+configureSoftwareBackend(
+    const char *definition);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,256 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "statsSegment.h"
+
+//-------------------------------------------------------------------------
+
+#define STATS_SEGMENT_READ_ATTEMPTS 1000
+
+//-------------------------------------------------------------------------
+// Create (or replace) the statistics file and map it. Returns NULL, with
+// errno set, on failure.
+
+STATS_SEGMENT_T *
+createStatsSegment(
+    const char *path,
+    uint32_t pipelineCount)
+{
+    if (pipelineCount > STATS_SEGMENT_MAX_PIPELINES)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    if (ftruncate(fd, sizeof(STATS_SEGMENT_T)) == -1)
+    {
+        int error = errno;
+        close(fd);
+        unlink(path);
+        errno = error;
+        return NULL;
+    }
+
+    STATS_SEGMENT_T *segment = mmap(NULL,
+                                    sizeof(STATS_SEGMENT_T),
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_SHARED,
+                                    fd,
+                                    0);
+
+    int error = errno;
+    close(fd);
+
+    if (segment == MAP_FAILED)
+    {
+        unlink(path);
+        errno = error;
+        return NULL;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    segment->version = STATS_SEGMENT_VERSION;
+    segment->size = sizeof(STATS_SEGMENT_T);
+    segment->pipelineCount = pipelineCount;
+    segment->pid = getpid();
+    segment->started = (now.tv_sec * 1000000000LL) + now.tv_nsec;
+
+    // Readers ignore the file until the magic number appears, so it is
+    // written last.
+
+    __sync_synchronize();
+    segment->magic = STATS_SEGMENT_MAGIC;
+
+    return segment;
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyStatsSegment(
+    STATS_SEGMENT_T *segment,
+    const char *path)
+{
+    unlink(path);
+    munmap(segment, sizeof(STATS_SEGMENT_T));
+}
+
+//-------------------------------------------------------------------------
+
+void
+statsSegmentBeginWrite(
+    STATS_SEGMENT_PIPELINE_T *pipeline)
+{
+    volatile uint32_t *sequence = &(pipeline->sequence);
+
+    *sequence = *sequence + 1;
+    __sync_synchronize();
+}
+
+//-------------------------------------------------------------------------
+
+void
+statsSegmentEndWrite(
+    STATS_SEGMENT_PIPELINE_T *pipeline)
+{
+    volatile uint32_t *sequence = &(pipeline->sequence);
+
+    __sync_synchronize();
+    *sequence = *sequence + 1;
+}
+
+//-------------------------------------------------------------------------
+// Map an existing statistics file for reading. Returns NULL, with errno
+// set, if it cannot be opened or is not a statistics file of this
+// version.
+
+const STATS_SEGMENT_T *
+openStatsSegment(
+    const char *path)
+{
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    struct stat info;
+
+    if (fstat(fd, &info) == -1)
+    {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return NULL;
+    }
+
+    if (info.st_size < (off_t)sizeof(STATS_SEGMENT_T))
+    {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    const STATS_SEGMENT_T *segment = mmap(NULL,
+                                          sizeof(STATS_SEGMENT_T),
+                                          PROT_READ,
+                                          MAP_SHARED,
+                                          fd,
+                                          0);
+
+    int error = errno;
+    close(fd);
+
+    if (segment == MAP_FAILED)
+    {
+        errno = error;
+        return NULL;
+    }
+
+    if ((segment->magic != STATS_SEGMENT_MAGIC)
+        || (segment->version != STATS_SEGMENT_VERSION)
+        || (segment->size != sizeof(STATS_SEGMENT_T)))
+    {
+        closeStatsSegment(segment);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return segment;
+}
+
+//-------------------------------------------------------------------------
+
+void
+closeStatsSegment(
+    const STATS_SEGMENT_T *segment)
+{
+    munmap((void *)segment, sizeof(STATS_SEGMENT_T));
+}
+
+//-------------------------------------------------------------------------
+// Take a consistent copy of a pipeline's statistics. Returns false if the
+// pipeline does not exist, or if the writer kept it busy for every
+// attempt.
+
+bool
+statsSegmentReadPipeline(
+    const STATS_SEGMENT_T *segment,
+    uint32_t index,
+    STATS_SEGMENT_PIPELINE_T *pipeline)
+{
+    if (index >= segment->pipelineCount)
+    {
+        return false;
+    }
+
+    const STATS_SEGMENT_PIPELINE_T *slot = &(segment->pipelines[index]);
+    const volatile uint32_t *sequence = &(slot->sequence);
+
+    int attempt = 0;
+    for (attempt = 0 ; attempt < STATS_SEGMENT_READ_ATTEMPTS ; ++attempt)
+    {
+        uint32_t before = *sequence;
+        __sync_synchronize();
+
+        if ((before & 1) == 0)
+        {
+            memcpy(pipeline, slot, sizeof(*pipeline));
+            __sync_synchronize();
+
+            if (*sequence == before)
+            {
+                return true;
+            }
+        }
+
+        sched_yield();
+    }
+
+    return false;
+}
@@ -0,0 +1,152 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef STATS_SEGMENT_H
+#define STATS_SEGMENT_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+//-------------------------------------------------------------------------
+// Live statistics published by raspi2raspi in a memory mapped file, and
+// read by raspi2raspi-stat. Each pipeline thread is the only writer of its
+// own slot, which is protected by a sequence lock: the sequence is odd
+// while the slot is being written, so a reader retries if it sees an odd
+// sequence or the sequence changes while it copies the slot. Readers never
+// block the writer. The version must be changed if the layout changes.
+
+#define STATS_SEGMENT_MAGIC 0x53523252
+#define STATS_SEGMENT_VERSION 2
+#define STATS_SEGMENT_MAX_PIPELINES 8
+#define STATS_SEGMENT_MAX_DESTINATIONS 8
+#define STATS_SEGMENT_DEFAULT_PATH "/run/raspi2raspi.stats"
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    int64_t p50;
+    int64_t p90;
+    int64_t p99;
+    int64_t max;
+} STATS_SEGMENT_LATENCY_T;
+
+//-------------------------------------------------------------------------
+// A destination display, and the rectangle of it the copy is shown in.
+
+typedef struct
+{
+    uint32_t display;
+    uint32_t width;
+    uint32_t height;
+    int32_t x;
+    int32_t y;
+    uint32_t copyWidth;
+    uint32_t copyHeight;
+} STATS_SEGMENT_DESTINATION_T;
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    uint32_t sequence;
+    uint32_t active;
+    int64_t updated;
+    uint32_t sourceDisplay;
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+    uint32_t snapshotWidth;
+    uint32_t snapshotHeight;
+    uint32_t destinationCount;
+    STATS_SEGMENT_DESTINATION_T destinations[STATS_SEGMENT_MAX_DESTINATIONS];
+    uint64_t framesCaptured;
+    uint64_t framesPresented;
+    uint64_t framesSkipped;
+    uint64_t reconfigurations;
+    uint64_t failures;
+    uint64_t frameRetries;
+    uint64_t elementRecreations;
+    uint64_t displayReopens;
+    double captureFps;
+    STATS_SEGMENT_LATENCY_T snapshotLatency;
+    STATS_SEGMENT_LATENCY_T updateLatency;
+    STATS_SEGMENT_LATENCY_T wakeupLatency;
+} STATS_SEGMENT_PIPELINE_T;
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t pipelineCount;
+    int32_t pid;
+    int64_t started;
+    STATS_SEGMENT_PIPELINE_T pipelines[STATS_SEGMENT_MAX_PIPELINES];
+} STATS_SEGMENT_T;
+
+//-------------------------------------------------------------------------
+
+STATS_SEGMENT_T *
+createStatsSegment(
+    const char *path,
+    uint32_t pipelineCount);
+
+void
+destroyStatsSegment(
+    STATS_SEGMENT_T *segment,
+    const char *path);
+
+void
+statsSegmentBeginWrite(
+    STATS_SEGMENT_PIPELINE_T *pipeline);
+
+void
+statsSegmentEndWrite(
+    STATS_SEGMENT_PIPELINE_T *pipeline);
+
+const STATS_SEGMENT_T *
+openStatsSegment(
+    const char *path);
+
+void
+closeStatsSegment(
+    const STATS_SEGMENT_T *segment);
+
+bool
+statsSegmentReadPipeline(
+    const STATS_SEGMENT_T *segment,
+    uint32_t index,
+    STATS_SEGMENT_PIPELINE_T *pipeline);
+
+//-------------------------------------------------------------------------
+
+#endif
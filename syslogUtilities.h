@@ -32,7 +32,7 @@
 
 #include <stdbool.h>
 
-#include <bsd/libutil.h>
+#include "pidFile.h"
 
 //-------------------------------------------------------------------------
 
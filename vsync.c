@@ -0,0 +1,307 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "displayBackend.h"
+#include "frameScheduler.h"
+#include "vsync.h"
+
+//-------------------------------------------------------------------------
+
+// How long vsyncWait() will wait for a vsync before giving up, so that
+// the capture loop can still notice a request to stop if the display
+// stops generating vsyncs.
+
+#define VSYNC_TIMEOUT_NANOSECONDS NANOSECONDS_PER_SECOND
+
+//-------------------------------------------------------------------------
+
+static void
+vsyncSignal(
+    VSYNC_T *vsync)
+{
+    int64_t now = monotonicNanoseconds();
+
+    pthread_mutex_lock(&(vsync->mutex));
+
+    ++(vsync->count);
+    vsync->timestamp = now;
+
+    pthread_cond_signal(&(vsync->cond));
+    pthread_mutex_unlock(&(vsync->mutex));
+}
+
+//-------------------------------------------------------------------------
+
+static void
+vsyncCallback(
+    DISPMANX_UPDATE_HANDLE_T update,
+    void *arg)
+{
+    vsyncSignal((VSYNC_T *)arg);
+}
+
+//-------------------------------------------------------------------------
+
+static void *
+syntheticVsyncThread(
+    void *arg)
+{
+    VSYNC_T *vsync = arg;
+    int64_t phase = monotonicNanoseconds();
+    int64_t frame = 0;
+
+    while (vsync->syntheticRun)
+    {
+        ++frame;
+        monotonicSleepUntil(phase + (frame * vsync->syntheticPeriod));
+        vsyncSignal(vsync);
+    }
+
+    return NULL;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+initVsyncCommon(
+    VSYNC_T *vsync,
+    uint32_t divisor,
+    int64_t offset)
+{
+    pthread_condattr_t attr;
+
+    if (pthread_condattr_init(&attr) != 0)
+    {
+        return false;
+    }
+
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+    if (pthread_cond_init(&(vsync->cond), &attr) != 0)
+    {
+        pthread_condattr_destroy(&attr);
+        return false;
+    }
+
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&(vsync->mutex), NULL);
+
+    vsync->count = 0;
+    vsync->timestamp = 0;
+    vsync->divisor = (divisor > 0) ? divisor : 1;
+    vsync->nextCount = vsync->divisor;
+    vsync->offset = (offset > 0) ? offset : 0;
+    vsync->triggered = 0;
+    vsync->missed = 0;
+    vsync->display = 0;
+    vsync->synthetic = false;
+    vsync->syntheticPeriod = 0;
+    vsync->syntheticRun = false;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+initVsync(
+    VSYNC_T *vsync,
+    DISPMANX_DISPLAY_HANDLE_T display,
+    uint32_t divisor,
+    int64_t offset)
+{
+    if (initVsyncCommon(vsync, divisor, offset) == false)
+    {
+        return false;
+    }
+
+    vsync->display = display;
+
+    if (displayBackend()->vsyncCallback(display, vsyncCallback, vsync) != 0)
+    {
+        pthread_cond_destroy(&(vsync->cond));
+        pthread_mutex_destroy(&(vsync->mutex));
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+initSyntheticVsync(
+    VSYNC_T *vsync,
+    double rate,
+    uint32_t divisor,
+    int64_t offset)
+{
+    if ((rate <= 0.0) || (initVsyncCommon(vsync, divisor, offset) == false))
+    {
+        return false;
+    }
+
+    vsync->synthetic = true;
+    vsync->syntheticPeriod = (int64_t)(NANOSECONDS_PER_SECOND / rate);
+    vsync->syntheticRun = true;
+
+    if (pthread_create(&(vsync->syntheticThread),
+                       NULL,
+                       syntheticVsyncThread,
+                       vsync) != 0)
+    {
+        pthread_cond_destroy(&(vsync->cond));
+        pthread_mutex_destroy(&(vsync->mutex));
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Remove the vsync callback from the display, which must still be open,
+// e.g. before the display is closed to be reopened. vsyncWait() times out
+// until vsyncSetDisplay() is called.
+
+void
+vsyncDetachDisplay(
+    VSYNC_T *vsync)
+{
+    if (vsync->synthetic || (vsync->display == 0))
+    {
+        return;
+    }
+
+    displayBackend()->vsyncCallback(vsync->display, NULL, NULL);
+    vsync->display = 0;
+}
+
+//-------------------------------------------------------------------------
+// Register the vsync callback on a display handle, e.g. after the display
+// has been reopened. It is registered even if the handle is the same as
+// before, as a reopened display is likely to get the same handle back.
+
+bool
+vsyncSetDisplay(
+    VSYNC_T *vsync,
+    DISPMANX_DISPLAY_HANDLE_T display)
+{
+    if (vsync->synthetic)
+    {
+        return true;
+    }
+
+    vsyncDetachDisplay(vsync);
+    vsync->display = display;
+
+    return (displayBackend()->vsyncCallback(display,
+                                            vsyncCallback,
+                                            vsync) == 0);
+}
+
+//-------------------------------------------------------------------------
+// Wait for the next vsync that is a multiple of the divisor, then sleep
+// until the phase offset after it. If the previous frame took longer than
+// the divisor allows, the missed vsyncs are counted and the frame is
+// triggered by the next vsync instead. Returns false if no vsync arrived
+// within the timeout.
+
+bool
+vsyncWait(
+    VSYNC_T *vsync)
+{
+    struct timespec timeout;
+    clock_gettime(CLOCK_MONOTONIC, &timeout);
+    timeout.tv_sec += VSYNC_TIMEOUT_NANOSECONDS / NANOSECONDS_PER_SECOND;
+
+    pthread_mutex_lock(&(vsync->mutex));
+
+    if (vsync->count >= vsync->nextCount)
+    {
+        vsync->missed += vsync->count - vsync->nextCount + 1;
+        vsync->nextCount = vsync->count + 1;
+    }
+
+    int result = 0;
+
+    while ((vsync->count < vsync->nextCount) && (result != ETIMEDOUT))
+    {
+        result = pthread_cond_timedwait(&(vsync->cond),
+                                        &(vsync->mutex),
+                                        &timeout);
+    }
+
+    bool triggered = (vsync->count >= vsync->nextCount);
+    int64_t timestamp = vsync->timestamp;
+
+    if (triggered)
+    {
+        vsync->nextCount = vsync->count + vsync->divisor;
+        ++(vsync->triggered);
+    }
+
+    pthread_mutex_unlock(&(vsync->mutex));
+
+    if (triggered)
+    {
+        if (vsync->offset > 0)
+        {
+            monotonicSleepUntil(timestamp + vsync->offset);
+        }
+
+        vsync->lastLateness = monotonicNanoseconds()
+                            - (timestamp + vsync->offset);
+    }
+
+    return triggered;
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyVsync(
+    VSYNC_T *vsync)
+{
+    if (vsync->synthetic)
+    {
+        vsync->syntheticRun = false;
+        pthread_join(vsync->syntheticThread, NULL);
+    }
+    else
+    {
+        vsyncDetachDisplay(vsync);
+    }
+
+    pthread_cond_destroy(&(vsync->cond));
+    pthread_mutex_destroy(&(vsync->mutex));
+}
@@ -0,0 +1,98 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef VSYNC_H
+#define VSYNC_H
+
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "displayTypes.h"
+
+//-------------------------------------------------------------------------
+// Counts vertical syncs from either a DispmanX display or a synthetic
+// source (a thread that fires at a fixed rate, for use without a real
+// display), and lets the capture loop wait for every Nth one.
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint64_t count;
+    int64_t timestamp;
+    uint64_t nextCount;
+    uint32_t divisor;
+    int64_t offset;
+    uint64_t triggered;
+    uint64_t missed;
+    int64_t lastLateness;
+    DISPMANX_DISPLAY_HANDLE_T display;
+    bool synthetic;
+    int64_t syntheticPeriod;
+    volatile bool syntheticRun;
+    pthread_t syntheticThread;
+} VSYNC_T;
+
+//-------------------------------------------------------------------------
+
+bool
+initVsync(
+    VSYNC_T *vsync,
+    DISPMANX_DISPLAY_HANDLE_T display,
+    uint32_t divisor,
+    int64_t offset);
+
+bool
+initSyntheticVsync(
+    VSYNC_T *vsync,
+    double rate,
+    uint32_t divisor,
+    int64_t offset);
+
+void
+vsyncDetachDisplay(
+    VSYNC_T *vsync);
+
+bool
+vsyncSetDisplay(
+    VSYNC_T *vsync,
+    DISPMANX_DISPLAY_HANDLE_T display);
+
+bool
+vsyncWait(
+    VSYNC_T *vsync);
+
+void
+destroyVsync(
+    VSYNC_T *vsync);
+
+//-------------------------------------------------------------------------
+
+#endif
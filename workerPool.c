@@ -0,0 +1,293 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "workerPool.h"
+
+//-------------------------------------------------------------------------
+// Take stripes of the current job until there are none left. Called by
+// the workers and by the thread running the job.
+
+static void
+runWorkerPoolStripes(
+    WORKER_POOL_T *pool)
+{
+    uint32_t stripe = 0;
+
+    while ((stripe = __sync_fetch_and_add(&(pool->nextStripe), 1))
+           < pool->jobStripes)
+    {
+        pool->job(pool->arg, stripe, pool->jobStripes);
+
+        if (__sync_sub_and_fetch(&(pool->remaining), 1) == 0)
+        {
+            pthread_mutex_lock(&(pool->mutex));
+            pthread_cond_broadcast(&(pool->done));
+            pthread_mutex_unlock(&(pool->mutex));
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+// A worker counts itself as busy from when it picks up a job until it has
+// stopped taking stripes, so that the next job is not set up under it.
+
+static void *
+workerPoolThread(
+    void *arg)
+{
+    WORKER_POOL_T *pool = arg;
+
+    pthread_mutex_lock(&(pool->mutex));
+
+    uint32_t generation = pool->generation;
+
+    while (true)
+    {
+        while ((pool->stop == false) && (pool->generation == generation))
+        {
+            pthread_cond_wait(&(pool->start), &(pool->mutex));
+        }
+
+        if (pool->stop)
+        {
+            break;
+        }
+
+        generation = pool->generation;
+        ++(pool->busy);
+
+        pthread_mutex_unlock(&(pool->mutex));
+
+        runWorkerPoolStripes(pool);
+
+        pthread_mutex_lock(&(pool->mutex));
+
+        --(pool->busy);
+        pthread_cond_broadcast(&(pool->done));
+    }
+
+    pthread_mutex_unlock(&(pool->mutex));
+
+    return NULL;
+}
+
+//-------------------------------------------------------------------------
+// Start threads - 1 workers, pinning worker i to core firstCore + i.
+// Each pool is given its own range of cores, so that the workers of
+// different pools do not compete for one core while others are idle; if
+// the range goes past the last core, the workers are not pinned at all.
+// The thread that runs the jobs (a pipeline's own thread) is not pinned,
+// and runs wherever the kernel schedules it. If stripes is zero, each job
+// is split into one stripe per thread.
+
+bool
+initWorkerPool(
+    WORKER_POOL_T *pool,
+    uint32_t threads,
+    uint32_t stripes,
+    uint32_t firstCore)
+{
+    memset(pool, 0, sizeof(*pool));
+
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+    else if (threads > WORKER_POOL_MAX_THREADS)
+    {
+        threads = WORKER_POOL_MAX_THREADS;
+    }
+
+    if (stripes == 0)
+    {
+        stripes = threads;
+    }
+    else if (stripes > WORKER_POOL_MAX_STRIPES)
+    {
+        stripes = WORKER_POOL_MAX_STRIPES;
+    }
+
+    pool->stripes = stripes;
+
+    pthread_mutex_init(&(pool->run), NULL);
+    pthread_mutex_init(&(pool->mutex), NULL);
+    pthread_cond_init(&(pool->start), NULL);
+    pthread_cond_init(&(pool->done), NULL);
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (cores < 1)
+    {
+        cores = 1;
+    }
+
+    pool->firstCore = firstCore;
+    pool->pinned = ((long)(firstCore + threads - 1) <= cores);
+
+    uint32_t i = 0;
+    for (i = 0 ; i < threads - 1 ; ++i)
+    {
+        if (pthread_create(&(pool->workers[i]),
+                           NULL,
+                           workerPoolThread,
+                           pool) != 0)
+        {
+            pool->threads = i + 1;
+            destroyWorkerPool(pool);
+            return false;
+        }
+
+        // pinning is only an optimisation, so failure is not an error
+
+        if (pool->pinned)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(firstCore + i, &cpus);
+
+            pthread_setaffinity_np(pool->workers[i], sizeof(cpus), &cpus);
+        }
+    }
+
+    pool->threads = threads;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Run a job on the pool, returning once all of its stripes are done.
+
+void
+workerPoolRun(
+    WORKER_POOL_T *pool,
+    WORKER_JOB_T job,
+    void *arg)
+{
+    if (pool == NULL)
+    {
+        job(arg, 0, 1);
+        return;
+    }
+
+    pthread_mutex_lock(&(pool->run));
+    pthread_mutex_lock(&(pool->mutex));
+
+    while (pool->busy > 0)
+    {
+        pthread_cond_wait(&(pool->done), &(pool->mutex));
+    }
+
+    pool->job = job;
+    pool->arg = arg;
+    pool->jobStripes = pool->stripes;
+    pool->remaining = pool->stripes;
+    pool->nextStripe = 0;
+    ++(pool->generation);
+
+    pthread_cond_broadcast(&(pool->start));
+    pthread_mutex_unlock(&(pool->mutex));
+
+    runWorkerPoolStripes(pool);
+
+    pthread_mutex_lock(&(pool->mutex));
+
+    while (pool->remaining > 0)
+    {
+        pthread_cond_wait(&(pool->done), &(pool->mutex));
+    }
+
+    pthread_mutex_unlock(&(pool->mutex));
+    pthread_mutex_unlock(&(pool->run));
+}
+
+//-------------------------------------------------------------------------
+// The range [first, end) of count items (e.g. rows) in a stripe. Stripes
+// start on a multiple of alignment items, so that they line up with
+// tiles or dither patterns; trailing stripes may be empty.
+
+void
+workerPoolStripe(
+    uint32_t stripe,
+    uint32_t stripes,
+    uint32_t count,
+    uint32_t alignment,
+    uint32_t *first,
+    uint32_t *end)
+{
+    if (alignment < 1)
+    {
+        alignment = 1;
+    }
+
+    uint32_t units = (count + alignment - 1) / alignment;
+    uint32_t perStripe = (units + stripes - 1) / stripes;
+
+    *first = stripe * perStripe * alignment;
+    *end = *first + (perStripe * alignment);
+
+    if (*first > count)
+    {
+        *first = count;
+    }
+
+    if (*end > count)
+    {
+        *end = count;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyWorkerPool(
+    WORKER_POOL_T *pool)
+{
+    pthread_mutex_lock(&(pool->mutex));
+    pool->stop = true;
+    pthread_cond_broadcast(&(pool->start));
+    pthread_mutex_unlock(&(pool->mutex));
+
+    uint32_t i = 0;
+    for (i = 0 ; i + 1 < pool->threads ; ++i)
+    {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&(pool->run));
+    pthread_mutex_destroy(&(pool->mutex));
+    pthread_cond_destroy(&(pool->start));
+    pthread_cond_destroy(&(pool->done));
+}
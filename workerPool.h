@@ -0,0 +1,107 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------------------
+
+#define WORKER_POOL_MAX_THREADS 8
+#define WORKER_POOL_MAX_STRIPES 64
+
+//-------------------------------------------------------------------------
+// Runs a job, split into stripes, on a set of threads that persist for
+// the life of the pool and are each pinned to a core of their own, if
+// there are enough of them. The thread that runs
+// the job takes stripes too, and returns once every stripe is done, so a
+// pool with threads threads has threads - 1 workers. Nothing is allocated
+// per job. A NULL pool runs the whole job as a single stripe on the
+// calling thread. Jobs from different threads are run one at a time.
+
+typedef void (*WORKER_JOB_T)(
+    void *arg,
+    uint32_t stripe,
+    uint32_t stripes);
+
+typedef struct
+{
+    uint32_t threads;
+    uint32_t stripes;
+    uint32_t firstCore;
+    bool pinned;
+    pthread_t workers[WORKER_POOL_MAX_THREADS];
+    pthread_mutex_t run;
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint32_t generation;
+    uint32_t busy;
+    bool stop;
+    WORKER_JOB_T job;
+    void *arg;
+    uint32_t jobStripes;
+    volatile uint32_t nextStripe;
+    volatile uint32_t remaining;
+} WORKER_POOL_T;
+
+//-------------------------------------------------------------------------
+
+bool
+initWorkerPool(
+    WORKER_POOL_T *pool,
+    uint32_t threads,
+    uint32_t stripes,
+    uint32_t firstCore);
+
+void
+workerPoolRun(
+    WORKER_POOL_T *pool,
+    WORKER_JOB_T job,
+    void *arg);
+
+void
+workerPoolStripe(
+    uint32_t stripe,
+    uint32_t stripes,
+    uint32_t count,
+    uint32_t alignment,
+    uint32_t *first,
+    uint32_t *end);
+
+void
+destroyWorkerPool(
+    WORKER_POOL_T *pool);
+
+//-------------------------------------------------------------------------
+
+#endif